@@ -19,7 +19,17 @@ SOURCES += \
     manifeststore.cpp \
     downloadscheduler.cpp \
     mapmanagerdialog.cpp \
-    maptools.cpp
+    maptools.cpp \
+    tilelayer.cpp \
+    tilepyramid.cpp \
+    tilerange.cpp \
+    geopolygon.cpp \
+    webmercator.cpp \
+    tilebitmap.cpp \
+    tilefetcher.cpp \
+    pyramidbuilder.cpp \
+    settingsstore.cpp \
+    asynclogger.cpp
 
 HEADERS += \
     basewindow.h \
@@ -31,7 +41,19 @@ HEADERS += \
     manifeststore.h \
     downloadscheduler.h \
     mapmanagerdialog.h \
-    maptools.h
+    maptools.h \
+    tilelayer.h \
+    tileid.h \
+    flathashmap.h \
+    tilepyramid.h \
+    tilerange.h \
+    geopolygon.h \
+    webmercator.h \
+    tilebitmap.h \
+    tilefetcher.h \
+    pyramidbuilder.h \
+    settingsstore.h \
+    asynclogger.h
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
@@ -0,0 +1,122 @@
+#include "asynclogger.h"
+#include <QFile>
+#include <QHash>
+#include <QDateTime>
+#include <QTextStream>
+#include <chrono>
+
+Q_LOGGING_CATEGORY(lcTile, "tilemap.tile", QtInfoMsg)
+
+struct AsyncLogger::Files {
+    QHash<QString, QFile *> open;
+    ~Files() { qDeleteAll(open); }
+    QFile *get(const QString &name)
+    {
+        auto it = open.find(name);
+        if (it != open.end()) return it.value();
+        QFile *f = new QFile(name);
+        if (!f->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+            delete f;
+            f = nullptr;
+        }
+        open.insert(name, f); // 打开失败也记下，不再重试
+        return f;
+    }
+};
+
+AsyncLogger &AsyncLogger::instance()
+{
+    static AsyncLogger logger;
+    return logger;
+}
+
+AsyncLogger::AsyncLogger()
+    : m_slots(new Slot[kCapacity])
+    , m_files(new Files)
+{
+    for (quint64 i = 0; i < kCapacity; ++i) m_slots[i].seq.store(i, std::memory_order_relaxed);
+    m_thread = std::thread([this]() { run(); });
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    stop();
+    drain(); // shutdown 之后仍可能有行写入（静态对象析构等），写线程已退出，这里补写
+}
+
+bool AsyncLogger::push(const QString &fileName, const QString &message)
+{
+    quint64 pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot = nullptr;
+    for (;;) {
+        slot = &m_slots[pos & (kCapacity - 1)];
+        const quint64 seq = slot->seq.load(std::memory_order_acquire);
+        const qint64 diff = qint64(seq) - qint64(pos);
+        if (diff == 0) {
+            // 槽空闲：抢占该位置
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // 写线程落后一整圈：缓冲已满
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->entry.fileName = fileName;
+    slot->entry.message = message;
+    slot->entry.msecs = QDateTime::currentMSecsSinceEpoch();
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool AsyncLogger::pop(Entry &out)
+{
+    Slot &slot = m_slots[m_dequeuePos & (kCapacity - 1)];
+    if (slot.seq.load(std::memory_order_acquire) != m_dequeuePos + 1) return false;
+    out = std::move(slot.entry);
+    slot.entry = Entry();
+    slot.seq.store(m_dequeuePos + kCapacity, std::memory_order_release);
+    ++m_dequeuePos;
+    return true;
+}
+
+int AsyncLogger::drain()
+{
+    QHash<QFile *, bool> touched;
+    Entry e;
+    int n = 0;
+    while (pop(e)) {
+        if (QFile *f = m_files->get(e.fileName)) {
+            QTextStream out(f);
+            out << QDateTime::fromMSecsSinceEpoch(e.msecs).toString("yyyy-MM-dd hh:mm:ss.zzz")
+                << " - " << e.message << "\n";
+            touched.insert(f, true);
+        }
+        ++n;
+    }
+    const quint64 dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0 && touched.isEmpty()) {
+        m_dropped.fetch_add(dropped, std::memory_order_relaxed); // 留到下一批有输出的文件再补记
+    } else if (dropped > 0) {
+        for (auto it = touched.cbegin(); it != touched.cend(); ++it)
+            QTextStream(it.key()) << "... " << dropped << " log lines dropped (buffer full)\n";
+    }
+    for (auto it = touched.cbegin(); it != touched.cend(); ++it) it.key()->flush();
+    return n;
+}
+
+void AsyncLogger::run()
+{
+    // 生产者不做通知：空闲时短暂休眠后再取
+    while (!m_stop.load(std::memory_order_acquire)) {
+        if (drain() == 0) std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    drain();
+}
+
+void AsyncLogger::stop()
+{
+    if (m_stop.exchange(true)) return;
+    if (m_thread.joinable()) m_thread.join();
+}
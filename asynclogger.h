@@ -0,0 +1,66 @@
+#ifndef ASYNCLOGGER_H
+#define ASYNCLOGGER_H
+
+#include <QString>
+#include <QLoggingCategory>
+#include <atomic>
+#include <thread>
+#include <memory>
+
+// 瓦片流水线的日志分类：默认只输出 info 及以上，调试级由 setVerboseLogging 或 QT_LOGGING_RULES 打开
+Q_DECLARE_LOGGING_CATEGORY(lcTile)
+
+// 逐瓦片的调试输出：Release（QT_NO_DEBUG）下整条语句编译期剔除，参数不求值
+#if defined(QT_NO_DEBUG) && !defined(TILE_DEBUG_IN_RELEASE)
+#define TILE_DEBUG() while (false) QMessageLogger().noDebug()
+#else
+#define TILE_DEBUG() qCDebug(lcTile)
+#endif
+
+// 异步文件日志：多生产者无锁环形缓冲（每槽一个序号，CAS 占位），后台线程批量写盘、每批 flush 一次。
+// 生产者不加锁、不做 I/O；缓冲满时丢弃并计数，由写线程补记一行丢弃数。
+class AsyncLogger
+{
+public:
+    static AsyncLogger &instance();
+
+    // 追加一行到 fileName（相对当前目录），时间戳取调用时刻
+    static void log(const QString &fileName, const QString &message) { instance().push(fileName, message); }
+    // 停止写线程并写完缓冲中剩余的行（程序退出前调用）；之后的行在析构时写出
+    static void shutdown() { instance().stop(); }
+
+    bool push(const QString &fileName, const QString &message);
+    void stop();
+
+private:
+    AsyncLogger();
+    ~AsyncLogger();
+    AsyncLogger(const AsyncLogger &) = delete;
+    AsyncLogger &operator=(const AsyncLogger &) = delete;
+
+    struct Entry {
+        QString fileName;
+        QString message;
+        qint64 msecs = 0;
+    };
+    struct Slot {
+        std::atomic<quint64> seq{0};
+        Entry entry;
+    };
+    static const quint64 kCapacity = 8192; // 2 的幂
+
+    bool pop(Entry &out); // 仅写线程调用
+    void run();
+    int drain(); // 写出当前缓冲中的全部条目，返回条数
+
+    std::unique_ptr<Slot[]> m_slots;
+    alignas(64) std::atomic<quint64> m_enqueuePos{0};
+    alignas(64) quint64 m_dequeuePos = 0;
+    std::atomic<quint64> m_dropped{0};
+    std::atomic<bool> m_stop{false};
+    std::thread m_thread;
+    struct Files;
+    std::unique_ptr<Files> m_files; // 写线程持有的打开文件
+};
+
+#endif // ASYNCLOGGER_H
@@ -91,6 +91,18 @@ bool BaseWindow::event(QEvent *event) {
     return QMainWindow::event(event);
 }
 
+void BaseWindow::changeEvent(QEvent *event)
+{
+    if (event->type() == QEvent::WindowStateChange) {
+        const bool minimized = isMinimized();
+        if (minimized != m_minimized) {
+            m_minimized = minimized;
+            emit minimizedChanged(minimized);
+        }
+    }
+    QMainWindow::changeEvent(event);
+}
+
 bool BaseWindow::eventFilter(QObject *watched, QEvent *event)
 {
     if (event->type() == QEvent::MouseMove) {
@@ -15,8 +15,13 @@ public:
     explicit BaseWindow(QWidget *parent = nullptr);
     void setContentWidget(QWidget *content);
 
+signals:
+    // 最小化/还原：内容页据此进入或退出后台模式
+    void minimizedChanged(bool minimized);
+
 protected:
     bool event(QEvent *event) override;
+    void changeEvent(QEvent *event) override;
     bool eventFilter(QObject *watched, QEvent *event) override;
 
     // 边框缩放
@@ -37,6 +42,7 @@ private:
     ResizeDirection getResizeDirection(const QPoint &pos) const;
     ResizeDirection m_resizeDir = None;
     bool m_resizing = false;
+    bool m_minimized = false;
     QRect m_startGeometry;
     QPoint m_startMousePos;
     static const int BORDER_WIDTH;
@@ -0,0 +1,22 @@
+# 性能对比（控制台）：瓦片键哈希表 FlatHashMap 与 QHash；逐瓦片图元场景与 TileLayerItem 的帧耗时；
+# Web 墨卡托批量投影精度检查（超出误差上限时非零退出）
+# gui/widgets 仅用于离屏渲染场景（默认 offscreen 平台，无需显示器）
+QT       = core gui widgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = bench
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../tilelayer.cpp \
+    ../webmercator.cpp
+
+HEADERS += \
+    ../tileid.h \
+    ../flathashmap.h \
+    ../tilelayer.h \
+    ../webmercator.h
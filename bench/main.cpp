@@ -0,0 +1,462 @@
+// bench/main.cpp：性能对比（控制台）
+// --hash：瓦片键哈希表 FlatHashMap<TileId, ...>、QHash<TileId, ...> 与改造前在途表形态 QHash<quint64, QString>
+// 的插入、命中/未命中查找、删除、遍历耗时。
+// 键用固定种子生成（连续视口块 + 全层级随机两种分布），每项跑多轮取中位数，结果可复现；
+// --render：同一批瓦片分别以“每张瓦片一个 QGraphicsPixmapItem”的场景与单个 TileLayerItem 离屏渲染，
+// 沿固定路径往返平移并每帧替换若干瓦片，统计每帧耗时（平均/P95/最大），并输出图层自身的 paintStats。
+// --mercator：批量正投影（AVX2 可用时走向量路径）与反投影对照标量实现的精度检查，
+// 样本为随机点加 ±85.0511°、±180° 与被裁剪的两极；误差超过 kMercatorBound 时以非零状态退出。
+// 用 Release 构建运行，输出表格附在对应提交说明中。
+#include <QApplication>
+#include <QGraphicsScene>
+#include <QGraphicsPixmapItem>
+#include <QPainter>
+#include <QImage>
+#include <QPixmap>
+#include <QColor>
+#include <QVector>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QHash>
+#include <QStringList>
+#include <QTextStream>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "tileid.h"
+#include "flathashmap.h"
+#include "tilelayer.h"
+#include "webmercator.h"
+
+static QTextStream &out()
+{
+    static QTextStream s(stdout);
+    return s;
+}
+
+static volatile quint64 g_sink = 0; // 防止结果被优化掉
+
+// 多轮取中位数，返回每次操作的纳秒数
+static double medianNsPerOp(int rounds, qint64 ops, const std::function<void()> &setup, const std::function<void()> &run)
+{
+    std::vector<double> samples;
+    for (int r = 0; r < rounds; ++r) {
+        setup();
+        QElapsedTimer t;
+        t.start();
+        run();
+        samples.push_back(double(t.nsecsElapsed()) / double(qMax<qint64>(1, ops)));
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+// 视口分布：z=14 上以某点为起点的连续方块，与视图可见瓦片、在途请求的键形态一致
+static std::vector<TileId> viewportKeys(int n, quint32 seed)
+{
+    QRandomGenerator rng(seed);
+    const int side = qMax(1, int(std::ceil(std::sqrt(double(n)))));
+    const int x0 = rng.bounded(1 << 13);
+    const int y0 = rng.bounded(1 << 13);
+    std::vector<TileId> keys;
+    keys.reserve(n);
+    for (int i = 0; i < n; ++i) keys.push_back(TileId(x0 + i % side, y0 + i / side, 14));
+    return keys;
+}
+
+// 随机分布：z=3..18 各层随机坐标，与覆盖索引、清单的键形态一致（低层级有重复键，遍历按表内条目数计）
+static std::vector<TileId> randomKeys(int n, quint32 seed)
+{
+    QRandomGenerator rng(seed);
+    std::vector<TileId> keys;
+    keys.reserve(n);
+    while (int(keys.size()) < n) {
+        const int z = 3 + rng.bounded(16);
+        keys.push_back(TileId(rng.bounded(1 << z), rng.bounded(1 << z), z));
+    }
+    return keys;
+}
+
+// 未命中键：同一坐标换到 z=20..27（键集只含 z<=18），分布与命中键相同且保证不在表中
+static std::vector<TileId> missKeys(const std::vector<TileId> &keys)
+{
+    std::vector<TileId> misses;
+    misses.reserve(keys.size());
+    for (const TileId &k : keys) misses.push_back(TileId(k.x(), k.y(), 20 + k.z() % 8));
+    return misses;
+}
+
+struct HashResult {
+    double insert = 0, hit = 0, miss = 0, remove = 0, iterate = 0;
+};
+
+static HashResult benchFlat(const std::vector<TileId> &keys, const std::vector<TileId> &misses, int rounds)
+{
+    HashResult r;
+    const qint64 n = qint64(keys.size());
+    FlatHashMap<TileId, quint64, TileIdHash> map;
+    auto fill = [&]() {
+        map.clear();
+        for (size_t i = 0; i < keys.size(); ++i) map.insert(keys[i], quint64(i));
+    };
+    r.insert = medianNsPerOp(rounds, n, [&]() { map.clear(); }, fill);
+    fill();
+    r.hit = medianNsPerOp(rounds, n, []() {}, [&]() {
+        quint64 s = 0;
+        for (const TileId &k : keys) if (const quint64 *v = map.find(k)) s += *v;
+        g_sink = g_sink + s;
+    });
+    r.miss = medianNsPerOp(rounds, qint64(misses.size()), []() {}, [&]() {
+        quint64 s = 0;
+        for (const TileId &k : misses) s += map.contains(k);
+        g_sink = g_sink + s;
+    });
+    r.iterate = medianNsPerOp(rounds, qint64(map.size()), []() {}, [&]() {
+        quint64 s = 0;
+        map.forEach([&s](const TileId &, quint64 v) { s += v; });
+        g_sink = g_sink + s;
+    });
+    r.remove = medianNsPerOp(rounds, n, fill, [&]() {
+        for (const TileId &k : keys) map.remove(k);
+    });
+    return r;
+}
+
+static HashResult benchQHash(const std::vector<TileId> &keys, const std::vector<TileId> &misses, int rounds)
+{
+    HashResult r;
+    const qint64 n = qint64(keys.size());
+    QHash<TileId, quint64> map;
+    auto fill = [&]() {
+        map.clear();
+        for (size_t i = 0; i < keys.size(); ++i) map.insert(keys[i], quint64(i));
+    };
+    r.insert = medianNsPerOp(rounds, n, [&]() { map.clear(); }, fill);
+    fill();
+    r.hit = medianNsPerOp(rounds, n, []() {}, [&]() {
+        quint64 s = 0;
+        for (const TileId &k : keys) {
+            auto it = map.constFind(k);
+            if (it != map.constEnd()) s += it.value();
+        }
+        g_sink = g_sink + s;
+    });
+    r.miss = medianNsPerOp(rounds, qint64(misses.size()), []() {}, [&]() {
+        quint64 s = 0;
+        for (const TileId &k : misses) s += map.contains(k);
+        g_sink = g_sink + s;
+    });
+    r.iterate = medianNsPerOp(rounds, qint64(map.size()), []() {}, [&]() {
+        quint64 s = 0;
+        for (auto it = map.cbegin(); it != map.cend(); ++it) s += it.value();
+        g_sink = g_sink + s;
+    });
+    r.remove = medianNsPerOp(rounds, n, fill, [&]() {
+        for (const TileId &k : keys) map.remove(k);
+    });
+    return r;
+}
+
+// 改造前调度器在途表的形态：x/y/z 打包成 quint64 键，值为任务 id 字符串（少量任务共享）
+static quint64 packKey(const TileId &id)
+{
+    return (quint64(id.z()) & 0x3F) << 58 | (quint64(id.x()) & 0x3FFFFFF) << 32 | (quint64(id.y()) & 0xFFFFFFFF);
+}
+
+static HashResult benchOutstanding(const std::vector<TileId> &keys, const std::vector<TileId> &misses, int rounds)
+{
+    HashResult r;
+    const qint64 n = qint64(keys.size());
+    const QStringList tasks = {"task-0", "task-1", "task-2", "task-3"};
+    std::vector<quint64> packed, packedMiss;
+    packed.reserve(keys.size());
+    packedMiss.reserve(misses.size());
+    for (const TileId &k : keys) packed.push_back(packKey(k));
+    for (const TileId &k : misses) packedMiss.push_back(packKey(k));
+    QHash<quint64, QString> map;
+    auto fill = [&]() {
+        map.clear();
+        for (size_t i = 0; i < packed.size(); ++i) map.insert(packed[i], tasks[int(i % 4)]);
+    };
+    r.insert = medianNsPerOp(rounds, n, [&]() { map.clear(); }, fill);
+    fill();
+    r.hit = medianNsPerOp(rounds, n, []() {}, [&]() {
+        quint64 s = 0;
+        for (quint64 k : packed) {
+            auto it = map.constFind(k);
+            if (it != map.constEnd()) s += quint64(it.value().size());
+        }
+        g_sink = g_sink + s;
+    });
+    r.miss = medianNsPerOp(rounds, qint64(packedMiss.size()), []() {}, [&]() {
+        quint64 s = 0;
+        for (quint64 k : packedMiss) s += map.contains(k);
+        g_sink = g_sink + s;
+    });
+    r.iterate = medianNsPerOp(rounds, qint64(map.size()), []() {}, [&]() {
+        quint64 s = 0;
+        for (auto it = map.cbegin(); it != map.cend(); ++it) s += quint64(it.value().size());
+        g_sink = g_sink + s;
+    });
+    // 旧代码完成回调用 take 取出任务 id
+    r.remove = medianNsPerOp(rounds, n, fill, [&]() {
+        quint64 s = 0;
+        for (quint64 k : packed) s += quint64(map.take(k).size());
+        g_sink = g_sink + s;
+    });
+    return r;
+}
+
+static void printHashTable(const QString &title, int n, const HashResult &flat, const HashResult &qhash, const HashResult &old)
+{
+    auto row = [](const char *name, double a, double b, double c) {
+        out() << QString("  %1 %2 %3 %4 %5x %6x")
+                     .arg(QLatin1String(name), -8)
+                     .arg(QString::number(a, 'f', 1), 12)
+                     .arg(QString::number(b, 'f', 1), 12)
+                     .arg(QString::number(c, 'f', 1), 18)
+                     .arg(QString::number(a > 0 ? b / a : 0.0, 'f', 2), 10)
+                     .arg(QString::number(a > 0 ? c / a : 0.0, 'f', 2), 10)
+              << Qt::endl;
+    };
+    out() << title << " (n=" << n << ", ns/op)" << Qt::endl;
+    out() << QString("  %1 %2 %3 %4 %5 %6").arg("op", -8).arg("FlatHashMap", 12).arg("QHash", 12)
+                 .arg("QHash<u64,QString>", 18).arg("QHash/Flat", 11).arg("old/Flat", 11) << Qt::endl;
+    row("insert", flat.insert, qhash.insert, old.insert);
+    row("hit", flat.hit, qhash.hit, old.hit);
+    row("miss", flat.miss, qhash.miss, old.miss);
+    row("remove", flat.remove, qhash.remove, old.remove);
+    row("iterate", flat.iterate, qhash.iterate, old.iterate);
+}
+
+static void runHashBench(const QList<int> &sizes, int rounds)
+{
+    for (int n : sizes) {
+        const std::vector<TileId> view = viewportKeys(n, 42);
+        const std::vector<TileId> viewMiss = missKeys(view);
+        printHashTable("viewport keys", n, benchFlat(view, viewMiss, rounds), benchQHash(view, viewMiss, rounds),
+                       benchOutstanding(view, viewMiss, rounds));
+        const std::vector<TileId> rnd = randomKeys(n, 42);
+        const std::vector<TileId> rndMiss = missKeys(rnd);
+        printHashTable("random keys", n, benchFlat(rnd, rndMiss, rounds), benchQHash(rnd, rndMiss, rounds),
+                       benchOutstanding(rnd, rndMiss, rounds));
+    }
+}
+
+struct FrameStats {
+    double avgMs = 0, p95Ms = 0, maxMs = 0;
+};
+
+static FrameStats summarize(std::vector<qint64> ns)
+{
+    FrameStats s;
+    if (ns.empty()) return s;
+    std::sort(ns.begin(), ns.end());
+    qint64 total = 0;
+    for (qint64 v : ns) total += v;
+    s.avgMs = double(total) / ns.size() / 1e6;
+    s.p95Ms = double(ns[qMin(ns.size() - 1, ns.size() * 95 / 100)]) / 1e6;
+    s.maxMs = double(ns.back()) / 1e6;
+    return s;
+}
+
+static void runRenderBench(int cols, int rows, int frames, int churn, const QSize &view)
+{
+    const int tileSize = 256;
+    const int zoom = 10;
+    const int x0 = 300, y0 = 200; // 瓦片块左上角（瓦片坐标）
+    const int count = cols * rows;
+    const qreal side = qreal(1 << zoom) * tileSize;
+
+    // 瓦片内容：不同底色加边框；两种方案绘制同一批 pixmap
+    QVector<QPixmap> pixmaps;
+    for (int i = 0; i < count; ++i) {
+        QPixmap pm(tileSize, tileSize);
+        pm.fill(QColor::fromHsv((i * 37) % 360, 160, 220));
+        QPainter p(&pm);
+        p.drawRect(0, 0, tileSize - 1, tileSize - 1);
+        pixmaps.append(pm);
+    }
+    auto tilePos = [&](int i) { return QPointF(qreal(x0 + i % cols) * tileSize, qreal(y0 + i / cols) * tileSize); };
+
+    // 方案一：每张瓦片一个图元（TileLayerItem 之前的做法）
+    QGraphicsScene itemScene(0, 0, side, side);
+    QVector<QGraphicsPixmapItem *> items(count);
+    for (int i = 0; i < count; ++i) {
+        items[i] = itemScene.addPixmap(pixmaps[i]);
+        items[i]->setPos(tilePos(i));
+    }
+    // 方案二：单个图层项
+    QGraphicsScene layerScene(0, 0, side, side);
+    TileLayerItem *layer = new TileLayerItem(tileSize);
+    layer->setZoom(zoom);
+    layer->setFadeDuration(0);
+    layerScene.addItem(layer);
+    for (int i = 0; i < count; ++i) layer->setTile(x0 + i % cols, y0 + i / cols, pixmaps[i], false);
+
+    // 沿对角线往返平移，每帧 7 像素
+    const int spanX = qMax(1, cols * tileSize - view.width());
+    const int spanY = qMax(1, rows * tileSize - view.height());
+    auto frameRect = [&](int f) {
+        const int px = (7 * f) % (2 * spanX);
+        const int py = (7 * f / 2) % (2 * spanY);
+        const int ox = px < spanX ? px : 2 * spanX - px;
+        const int oy = py < spanY ? py : 2 * spanY - py;
+        return QRectF(qreal(x0) * tileSize + ox, qreal(y0) * tileSize + oy, view.width(), view.height());
+    };
+    QImage target(view, QImage::Format_ARGB32_Premultiplied);
+    // 每帧耗时含替换瓦片（增删图元/覆盖图层瓦片）与离屏渲染
+    auto run = [&](QGraphicsScene &scene, const std::function<void(int)> &mutate) {
+        std::vector<qint64> ns;
+        ns.reserve(frames);
+        for (int f = 0; f < frames; ++f) {
+            QElapsedTimer t;
+            t.start();
+            mutate(f);
+            QPainter p(&target);
+            scene.render(&p, QRectF(QPointF(0, 0), QSizeF(view)), frameRect(f));
+            p.end();
+            ns.push_back(t.nsecsElapsed());
+        }
+        return summarize(ns);
+    };
+
+    const FrameStats itemStats = run(itemScene, [&](int f) {
+        for (int k = 0; k < churn; ++k) {
+            const int i = (f * churn + k) % count;
+            itemScene.removeItem(items[i]);
+            delete items[i];
+            items[i] = itemScene.addPixmap(pixmaps[(i + f) % count]);
+            items[i]->setPos(tilePos(i));
+        }
+    });
+    layer->resetPaintStats();
+    const FrameStats layerStats = run(layerScene, [&](int f) {
+        for (int k = 0; k < churn; ++k) {
+            const int i = (f * churn + k) % count;
+            layer->setTile(x0 + i % cols, y0 + i / cols, pixmaps[(i + f) % count]);
+        }
+    });
+    const TileLayerItem::PaintStats ps = layer->paintStats();
+
+    out() << "render " << cols << "x" << rows << " tiles, view " << view.width() << "x" << view.height()
+          << ", " << frames << " frames, " << churn << " tiles replaced/frame (ms/frame)" << Qt::endl;
+    out() << QString("  %1 %2 %3 %4").arg("scene", -14).arg("avg", 8).arg("p95", 8).arg("max", 8) << Qt::endl;
+    auto row = [](const char *name, const FrameStats &s) {
+        out() << QString("  %1 %2 %3 %4")
+                     .arg(QLatin1String(name), -14)
+                     .arg(QString::number(s.avgMs, 'f', 3), 8)
+                     .arg(QString::number(s.p95Ms, 'f', 3), 8)
+                     .arg(QString::number(s.maxMs, 'f', 3), 8)
+              << Qt::endl;
+    };
+    row("pixmap items", itemStats);
+    row("TileLayerItem", layerStats);
+    if (ps.frames > 0) {
+        out() << "  TileLayerItem paintStats: frames " << ps.frames
+              << ", paint avg " << QString::number(ps.totalNs / 1e6 / ps.frames, 'f', 3) << " ms"
+              << ", max " << QString::number(ps.maxNs / 1e6, 'f', 3) << " ms"
+              << ", tiles/frame " << QString::number(double(ps.tilesDrawn) / ps.frames, 'f', 1) << Qt::endl;
+    }
+}
+
+// 归一化坐标误差上限（1 个 z=20 瓦片像素约 3.7e-9）
+static constexpr double kMercatorBound = 1e-9;
+
+static bool runMercatorCheck(int points)
+{
+    // 边界样本：经度 ±180/0 与纬度 ±85.0511、±kMaxLatitude、±90（裁剪）、0 的组合
+    QVector<QPointF> in;
+    const double lons[] = {-180.0, -179.999999, 0.0, 179.999999, 180.0};
+    const double lats[] = {-90.0, -WebMercator::kMaxLatitude, -85.0511, -85.0, 0.0,
+                           85.0, 85.0511, WebMercator::kMaxLatitude, 90.0};
+    for (double lon : lons)
+        for (double lat : lats) in.append(QPointF(lon, lat));
+    QRandomGenerator rng(12345);
+    for (int i = 0; i < points; ++i)
+        in.append(QPointF(rng.generateDouble() * 360.0 - 180.0, rng.generateDouble() * 180.0 - 90.0));
+    const int n = int(in.size());
+
+    QVector<QPointF> ref(n), out(n), back(n);
+    QElapsedTimer t;
+    t.start();
+    for (int i = 0; i < n; ++i) ref[i] = WebMercator::project(in[i], 1.0);
+    const double scalarNs = double(t.nsecsElapsed()) / n;
+    t.restart();
+    WebMercator::projectBatch(in.constData(), out.data(), n, 1.0);
+    const double batchNs = double(t.nsecsElapsed()) / n;
+    WebMercator::unprojectBatch(ref.constData(), back.data(), n, 1.0);
+
+    // 正投影：批量与标量之差；反投影：回到经纬度后再用标量正投影，与参考值比较（均为归一化坐标）
+    double projErr = 0.0, unprojErr = 0.0;
+    int projWorst = 0, unprojWorst = 0;
+    for (int i = 0; i < n; ++i) {
+        const double e = qMax(qAbs(out[i].x() - ref[i].x()), qAbs(out[i].y() - ref[i].y()));
+        if (!(e <= projErr)) { projErr = e; projWorst = i; }
+        const QPointF again = WebMercator::project(back[i], 1.0);
+        const double u = qMax(qAbs(again.x() - ref[i].x()), qAbs(again.y() - ref[i].y()));
+        if (!(u <= unprojErr)) { unprojErr = u; unprojWorst = i; }
+    }
+
+    out() << "WebMercator accuracy, " << n << " points, simd " << (WebMercator::simdAvailable() ? "avx2" : "off")
+          << ", bound " << kMercatorBound << Qt::endl;
+    out() << "  project   max error " << projErr << " at (" << in[projWorst].x() << ", " << in[projWorst].y() << ")"
+          << ", scalar " << QString::number(scalarNs, 'f', 2) << " ns/pt, batch " << QString::number(batchNs, 'f', 2) << " ns/pt" << Qt::endl;
+    out() << "  unproject max error " << unprojErr << " at (" << in[unprojWorst].x() << ", " << in[unprojWorst].y() << ")" << Qt::endl;
+    // NaN 也视为失败
+    const bool ok = projErr <= kMercatorBound && unprojErr <= kMercatorBound;
+    if (!ok) out() << "  FAILED: error exceeds bound" << Qt::endl;
+    return ok;
+}
+
+static QSize parseSize(const QString &s, const QSize &def)
+{
+    const QStringList parts = s.split('x');
+    if (parts.size() != 2) return def;
+    const QSize size(parts[0].toInt(), parts[1].toInt());
+    return size.isValid() && !size.isEmpty() ? size : def;
+}
+
+int main(int argc, char *argv[])
+{
+    // 场景离屏渲染，无需显示器
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Tile data-structure benchmarks");
+    parser.addHelpOption();
+    QCommandLineOption optHash("hash", "FlatHashMap vs QHash keyed by TileId");
+    QCommandLineOption optSizes("sizes", "Comma-separated key counts", "list", "1000,100000,1000000");
+    QCommandLineOption optRounds("rounds", "Rounds per measurement (median reported)", "n", "7");
+    QCommandLineOption optRender("render", "Per-tile pixmap items vs TileLayerItem frame time");
+    QCommandLineOption optTiles("tiles", "Tile block loaded in the scene (COLSxROWS)", "size", "24x16");
+    QCommandLineOption optView("view", "Viewport size (WxH)", "size", "1280x720");
+    QCommandLineOption optFrames("frames", "Frames to render", "n", "600");
+    QCommandLineOption optChurn("churn", "Tiles replaced per frame", "n", "8");
+    QCommandLineOption optMercator("mercator", "WebMercator batch/unproject accuracy against scalar (non-zero exit on failure)");
+    QCommandLineOption optPoints("points", "Random points for --mercator", "n", "65536");
+    parser.addOptions({optHash, optSizes, optRounds, optRender, optTiles, optView, optFrames, optChurn, optMercator, optPoints});
+    parser.process(app);
+
+    QList<int> sizes;
+    for (const QString &s : parser.value(optSizes).split(',', Qt::SkipEmptyParts)) {
+        const int n = s.trimmed().toInt();
+        if (n > 0) sizes << n;
+    }
+    const int rounds = qMax(1, parser.value(optRounds).toInt());
+
+    if (!parser.isSet(optHash) && !parser.isSet(optRender) && !parser.isSet(optMercator)) parser.showHelp(1);
+    int status = 0;
+    if (parser.isSet(optMercator) && !runMercatorCheck(qMax(0, parser.value(optPoints).toInt()))) status = 1;
+    if (parser.isSet(optHash)) runHashBench(sizes, rounds);
+    if (parser.isSet(optRender)) {
+        const QSize tiles = parseSize(parser.value(optTiles), QSize(24, 16));
+        runRenderBench(tiles.width(), tiles.height(), qMax(1, parser.value(optFrames).toInt()),
+                       qMax(0, parser.value(optChurn).toInt()), parseSize(parser.value(optView), QSize(1280, 720)));
+    }
+    return status;
+}
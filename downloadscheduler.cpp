@@ -1,9 +1,13 @@
 #include "downloadscheduler.h"
 #include <QtGlobal>
 #include <QtMath>
-#include "tilemapmanager.h"
+#include "tilefetcher.h"
+#include "geopolygon.h"
+#include <QDebug>
 #include <QDir>
 #include <QFile>
+#include <QVector>
+#include <QStringList>
 
 DownloadScheduler::DownloadScheduler(QObject *parent)
     : QObject(parent)
@@ -16,6 +20,10 @@ void DownloadScheduler::configure(const MapManagerSettings &settings)
     m_settings = settings;
     int intervalMs = qMax(50, 1000 / qMax(1, settings.rateLimitPerSec));
     m_timer.setInterval(intervalMs);
+    if (m_fetcher) {
+        m_fetcher->setRetryPolicy(settings.retryMax, settings.backoffInitialMs);
+        m_fetcher->setUniformDetection(settings.skipUniformTiles, settings.uniformMinZoom);
+    }
 }
 
 void DownloadScheduler::setManifest(ManifestStore *store)
@@ -23,11 +31,13 @@ void DownloadScheduler::setManifest(ManifestStore *store)
     m_store = store;
 }
 
-void DownloadScheduler::setTileManager(TileMapManager *mgr)
+void DownloadScheduler::setFetcher(TileFetcher *fetcher)
 {
-    m_mgr = mgr;
-    if (m_mgr) {
-        QObject::connect(m_mgr, &TileMapManager::tileCached,
+    m_fetcher = fetcher;
+    if (m_fetcher) {
+        m_fetcher->setRetryPolicy(m_settings.retryMax, m_settings.backoffInitialMs);
+        m_fetcher->setUniformDetection(m_settings.skipUniformTiles, m_settings.uniformMinZoom);
+        QObject::connect(m_fetcher, &TileFetcher::tileCached,
                          this, &DownloadScheduler::onTileCached);
     }
 }
@@ -40,126 +50,338 @@ void DownloadScheduler::start()
 void DownloadScheduler::pause()
 {
     m_timer.stop();
+    if (m_store) m_store->sync();
 }
 
-void DownloadScheduler::enqueueTask(const DownloadTask &task)
+QString DownloadScheduler::enqueueTask(const DownloadTask &task)
 {
-    if (!m_store) return;
-    m_store->upsertTask(task);
+    if (!m_store) return QString();
+    const QString id = m_store->upsertTask(task);
+    // 游标已建立（调度运行中）时直接追加，新任务无需重建其他游标
+    if (m_cursorsBuilt) {
+        appendCursor(m_store->getTask(id));
+        m_store->setStatus(id, "downloading");
+    }
     m_store->save();
+    emit taskStatusChanged(id, m_store->getTask(id).status);
+    if (m_cursorsBuilt) start(); // 调度可能已因游标走完而停表
+    return id;
+}
+
+QString DownloadScheduler::findTask(const DownloadTask &like) const
+{
+    if (!m_store) return QString();
+    QString best;
+    qint64 bestDone = -1;
+    for (const auto &t : m_store->tasks()) {
+        if (t.status == "cancelled" || !t.route.isEmpty() || t.shardEnd >= 0) continue;
+        if (t.minZoom != like.minZoom || t.maxZoom != like.maxZoom || t.polygonPath != like.polygonPath) continue;
+        // 经纬度可能为 0，用绝对误差比较
+        auto same = [](double a, double b) { return qAbs(a - b) < 1e-9; };
+        if (!same(t.minLat, like.minLat) || !same(t.maxLat, like.maxLat)
+            || !same(t.minLon, like.minLon) || !same(t.maxLon, like.maxLon)) continue;
+        if (t.completedTiles > bestDone) {
+            best = t.id;
+            bestDone = t.completedTiles;
+        }
+    }
+    return best;
+}
+
+// 调度中的任务：未完成、未暂停、未取消（partial 在下次建游标时重试失败瓦片）
+static bool isActiveStatus(const QString &status)
+{
+    return status != "completed" && status != "paused" && status != "cancelled";
+}
+
+bool DownloadScheduler::takeCursor(const QString &taskId, TaskCursor &out)
+{
+    const int handle = m_taskHandles.value(taskId, -1);
+    for (int i = 0; i < m_cursors.size(); ++i) {
+        if (m_cursors[i].task != handle) continue;
+        flushSkipped(m_cursors[i]);
+        out = m_cursors[i];
+        m_cursors.remove(i);
+        if (m_rr > i) --m_rr; // 轮转位置保持指向原来的下一个任务
+        return true;
+    }
+    return false;
+}
+
+void DownloadScheduler::setTaskStatus(const QString &taskId, const QString &status)
+{
+    m_store->setStatus(taskId, status);
+    m_store->sync();
+    emit taskStatusChanged(taskId, status);
 }
 
 void DownloadScheduler::pauseTask(const QString &taskId)
 {
-    Q_UNUSED(taskId);
-    // 预留：后续从队列中过滤该任务的 job，并把状态置为 paused
+    if (!m_store || !isActiveStatus(m_store->getTask(taskId).status)) return;
+    // 游标移出轮转并原样保留，恢复时从原位置继续；在途瓦片照常回调记账
+    TaskCursor c;
+    if (takeCursor(taskId, c)) m_paused.insert(c.task, c);
+    setTaskStatus(taskId, "paused");
 }
 
 void DownloadScheduler::resumeTask(const QString &taskId)
 {
-    Q_UNUSED(taskId);
-    // 预留：把 paused 任务恢复为 pending，并在下次 buildQueueFromTasks() 重新入队
+    if (!m_store) return;
+    const QString status = m_store->getTask(taskId).status;
+    if (status != "paused" && status != "partial") return; // partial：重新走一遍，只重试失败瓦片
+    const int handle = m_taskHandles.value(taskId, -1);
+    if (m_paused.contains(handle)) {
+        TaskCursor c = m_paused.take(handle);
+        c.deficit = 0;
+        m_cursors.append(c);
+    } else if (m_cursorsBuilt) {
+        // 上次运行中暂停的任务：按完成位图重新定位游标
+        appendCursor(m_store->getTask(taskId));
+    }
+    setTaskStatus(taskId, m_cursorsBuilt ? "downloading" : "pending");
+    start(); // 游标走完后已停表，恢复的任务需要重新驱动
 }
 
 void DownloadScheduler::cancelTask(const QString &taskId)
 {
-    Q_UNUSED(taskId);
-    // 预留：从队列移除该任务未发出的 job，并置状态 cancelled
+    if (!m_store) return;
+    const QString status = m_store->getTask(taskId).status;
+    if (status == "completed" || status == "cancelled") return;
+    TaskCursor c;
+    takeCursor(taskId, c);
+    m_paused.remove(m_taskHandles.value(taskId, -1));
+    setTaskStatus(taskId, "cancelled");
+}
+
+TileRange DownloadScheduler::rangeForTask(const DownloadTask &task, qint64 *bboxTotal)
+{
+    const TileRange bbox = TileRange::fromBBox(task.minLat, task.maxLat, task.minLon, task.maxLon,
+                                               task.minZoom, task.maxZoom);
+    if (bboxTotal) *bboxTotal = bbox.total();
+    if (!task.route.isEmpty()) {
+        const TileRange range = TileRange::fromCorridor(task.route, task.bufferMeters, task.minZoom, task.maxZoom);
+        qDebug() << "Task" << task.id << "corridor tiles:" << range.total() << "bbox tiles:" << bbox.total();
+        return range;
+    }
+    if (task.polygonPath.isEmpty()) return bbox;
+    QString error;
+    const GeoPolygon poly = GeoPolygon::loadGeoJson(task.polygonPath, &error);
+    if (poly.isEmpty()) {
+        qDebug() << "Polygon load failed, fallback to bbox:" << task.polygonPath << error;
+        return bbox;
+    }
+    const TileRange range = TileRange::fromPolygon(poly, task.minZoom, task.maxZoom);
+    qDebug() << "Task" << task.id << "polygon tiles:" << range.total() << "bbox tiles:" << bbox.total();
+    return range;
 }
 
 void DownloadScheduler::onTick()
 {
-    if (!m_store || !m_mgr) return;
-    if (!m_queueBuilt) {
-        buildQueueFromTasks();
-        m_queueBuilt = true;
+    if (!m_store || !m_fetcher) return;
+    if (!m_cursorsBuilt) {
+        buildCursorsFromTasks();
+        m_cursorsBuilt = true;
         // 标记任务为 downloading
         for (const auto &t : m_store->tasks()) {
-            if (t.status != "downloading" && t.status != "completed") {
+            if (t.status != "downloading" && isActiveStatus(t.status)) {
                 const_cast<ManifestStore*>(m_store)->setStatus(t.id, "downloading");
             }
         }
         const_cast<ManifestStore*>(m_store)->save();
     }
     // 简易并发控制
-    if (m_inflight >= m_settings.maxConcurrent) return;
-    if (m_queue.isEmpty()) {
-        emit allTasksFinished();
-        return;
+    if (m_inflight >= m_settings.maxConcurrent * (m_background ? kBackgroundConcurrency : 1)) return;
+    Outstanding job;
+    TileId id;
+    for (;;) {
+        if (!nextJob(job, id)) {
+            // 游标全部走完、无暂停任务且在途瓦片都已回调才算结束；停表，新任务入队或恢复时由 start() 重新驱动
+            if (m_cursors.isEmpty() && m_paused.isEmpty() && m_inflight == 0) {
+                m_timer.stop();
+                m_store->sync();
+                emit allTasksFinished();
+            }
+            return; // 否则本次跳过预算用完或等待在途瓦片，下个周期继续
+        }
+        // 其他任务已在请求同一瓦片：挂到该请求上，不重复抓取，继续取下一个
+        m_taskInflight[job.task]++;
+        if (QVector<Outstanding> *waiters = m_outstanding.find(id)) {
+            waiters->append(job);
+            continue;
+        }
+        break;
     }
-    auto job = m_queue.dequeue();
     m_inflight++;
     // 先登记映射，避免本地命中时回调不会匹配的问题
-    m_outstanding.insert(packKey(job.x,job.y,job.z), job.taskId);
-    m_mgr->enqueueDownload(job.x, job.y, job.z);
+    m_outstanding.insert(id, QVector<Outstanding>{job});
+    m_fetcher->fetch(id);
+}
+
+bool DownloadScheduler::nextJob(Outstanding &job, TileId &id)
+{
+    // 单次最多跳过的已缓存瓦片数，避免大片已下载区域阻塞事件循环
+    const int kSkipBudget = 4096;
+    int budget = kSkipBudget;
+    // 差额轮询（DRR）：轮到的任务获得 weight 个瓦片的额度，用完再轮到下一个；
+    // 每个待下载瓦片代价为 1，本地命中不消耗额度
+    while (!m_cursors.isEmpty()) {
+        if (m_rr >= m_cursors.size()) m_rr = 0;
+        TaskCursor &c = m_cursors[m_rr];
+        if (c.deficit <= 0) c.deficit += c.weight;
+        if (scanCursor(c, job, id, budget)) {
+            if (--c.deficit <= 0) ++m_rr;
+            return true;
+        }
+        if (c.range.position() < c.end) return false; // 跳过预算用完，下个周期继续
+        const int task = c.task;
+        m_cursors.remove(m_rr); // 遍历结束，m_rr 已指向下一个任务
+        m_drained.insert(task);
+        settleDrained(task);
+    }
+    return false;
+}
+
+void DownloadScheduler::settleDrained(int task)
+{
+    if (!m_drained.contains(task) || m_taskInflight.value(task) > 0) return;
+    m_drained.remove(task);
+    const QString taskId = m_taskIds.value(task);
+    const DownloadTask t = m_store->getTask(taskId);
+    if (!isActiveStatus(t.status) || t.failedTiles == 0) return; // 无失败时由 reportProgress 置 completed
+    qDebug() << "Task" << taskId << "finished with" << t.failedTiles << "failed tiles";
+    setTaskStatus(taskId, "partial");
+}
+
+bool DownloadScheduler::scanCursor(TaskCursor &c, Outstanding &job, TileId &id, int &budget)
+{
+    const QString taskId = m_taskIds.value(c.task);
+    while (c.range.position() < c.end) {
+        // 位图中已完成的序号整段跳过，不逐个查缓存
+        const qint64 pos = c.range.position();
+        const qint64 pending = m_store->nextPending(taskId, pos);
+        if (pending != pos) {
+            flushSkipped(c);
+            c.range.seek(qMin(pending, c.end));
+            continue;
+        }
+        c.range.next(id);
+        if (!m_fetcher->pyramid().contains(id) && !underUniform(id)) {
+            job.task = c.task;
+            job.ordinal = pos;
+            flushSkipped(c);
+            return true;
+        }
+        // 已存在：直接计入完成（连续命中合并为一条区间记录）
+        if (c.skipped == 0) c.skipStart = pos;
+        ++c.skipped;
+        if (--budget <= 0) break;
+    }
+    flushSkipped(c);
+    return false;
+}
+
+bool DownloadScheduler::underUniform(const TileId &id) const
+{
+    // 纯色祖先的子树按虚拟瓦片计入完成，不再下载
+    if (!m_settings.skipUniformTiles) return false;
+    TileId ancestor;
+    quint32 argb = 0;
+    return m_fetcher->pyramid().uniformAncestor(id, ancestor, argb);
+}
+
+void DownloadScheduler::flushSkipped(TaskCursor &c)
+{
+    if (c.skipped == 0 || !m_store) return;
+    const QString taskId = m_taskIds.value(c.task);
+    const_cast<ManifestStore*>(m_store)->markDone(taskId, c.skipStart, c.skipStart + c.skipped - 1);
+    c.skipped = 0;
+    reportProgress(taskId);
+}
+
+void DownloadScheduler::reportProgress(const QString &taskId)
+{
+    auto t = m_store->getTask(taskId);
+    emit taskProgress(taskId, t.completedTiles, t.totalTiles);
+    if (t.totalTiles > 0 && t.completedTiles >= t.totalTiles && t.status != "completed") {
+        m_store->setStatus(taskId, "completed");
+        emit taskStatusChanged(taskId, "completed");
+    }
 }
 
-static void clampTileRange(int z, int &minX, int &maxX, int &minY, int &maxY)
+int DownloadScheduler::taskHandle(const QString &taskId)
 {
-    int n = 1 << z;
-    minX = qMax(0, minX); maxX = qMin(n - 1, maxX);
-    minY = qMax(0, minY); maxY = qMin(n - 1, maxY);
+    auto it = m_taskHandles.constFind(taskId);
+    if (it != m_taskHandles.constEnd()) return it.value();
+    const int handle = m_taskIds.size();
+    m_taskIds.append(taskId);
+    m_taskHandles.insert(taskId, handle);
+    return handle;
 }
 
-void DownloadScheduler::buildQueueFromTasks()
+void DownloadScheduler::buildCursorsFromTasks()
 {
-    m_queue.clear();
+    m_cursors.clear();
+    m_paused.clear();
+    m_drained.clear();
+    m_rr = 0;
     if (!m_store) return;
     auto tasks = m_store->tasks();
-    const int HARD_LIMIT = 200000; // 与 UI 层一致的硬阈值保护（按“需要下载”的数量衡量）
-    QDir cacheDir(m_settings.cacheDir);
     for (const auto &t : tasks) {
-        int enqueued = 0;            // 需要下载的数量
-        int preExisting = 0;         // 已存在数量
-        int taskTotal = 0;           // 任务总瓦片数量（保持为所有范围内的总数）
-        for (int z = t.minZoom; z <= t.maxZoom; ++z) {
-            int n = 1 << z;
-            int minX = int((t.minLon + 180.0) / 360.0 * n);
-            int maxX = int((t.maxLon + 180.0) / 360.0 * n);
-            auto lat2y = [n](double lat){ double r = lat * M_PI / 180.0; return int((1.0 - log(tan(r) + 1.0 / cos(r)) / M_PI) / 2.0 * n); };
-            int minY = lat2y(t.maxLat); // 注意: 瓦片 Y 轴向下
-            int maxY = lat2y(t.minLat);
-            clampTileRange(z, minX, maxX, minY, maxY);
-            for (int x = minX; x <= maxX; ++x) {
-                for (int y = minY; y <= maxY; ++y) {
-                    // 判断是否已存在
-                    QString fp = cacheDir.absoluteFilePath(QString::number(z) + "/" + QString::number(x) + "/" + QString::number(y) + ".png");
-                    if (QFile::exists(fp)) {
-                        preExisting++;
-                    } else {
-                        if (enqueued >= HARD_LIMIT) {
-                            if (m_store) const_cast<ManifestStore*>(m_store)->setStatus(t.id, "cancelled");
-                            break;
-                        }
-                        m_queue.enqueue({t.id, x, y, z});
-                        enqueued++;
-                    }
-                    taskTotal++;
-                }
-                if (enqueued >= HARD_LIMIT) break;
-            }
-            if (enqueued >= HARD_LIMIT) break;
+        if (!isActiveStatus(t.status)) continue;
+        appendCursor(t);
+    }
+    const_cast<ManifestStore*>(m_store)->save();
+}
+
+void DownloadScheduler::appendCursor(const DownloadTask &t)
+{
+    TaskCursor c;
+    c.task = taskHandle(t.id);
+    c.weight = qMax(1, t.priority + 1);
+    qint64 bboxTotal = 0;
+    if (m_presetRanges.contains(t.id)) {
+        c.range = m_presetRanges.value(t.id);
+        bboxTotal = c.range.total();
+    } else {
+        c.range = rangeForTask(t, &bboxTotal);
+    }
+    emit taskPlanned(t.id, c.range.total(), bboxTotal);
+    // 总数按各层矩形/区间算术得出；区域未变时沿用完成位图，游标直接定位到第一个未完成序号
+    m_store->setTotalTiles(t.id, c.range.total());
+    c.end = t.shardEnd >= 0 ? qMin(t.shardEnd, c.range.total()) : c.range.total();
+    c.range.seek(qMin(m_store->nextPending(t.id, qMax<qint64>(0, t.shardBegin)), c.end));
+    const DownloadTask cur = m_store->getTask(t.id);
+    if (!cur.doneBits.isEmpty()) {
+        QStringList levels;
+        for (int i = 0; i < c.range.levels().size(); ++i) {
+            const qint64 begin = c.range.levelStart(i);
+            const qint64 count = c.range.levels()[i].count();
+            levels << QString("z%1 %2/%3").arg(c.range.levels()[i].z)
+                      .arg(cur.doneBits.countRange(begin, begin + count)).arg(count);
         }
-        if (m_store) const_cast<ManifestStore*>(m_store)->setTotalTiles(t.id, taskTotal);
+        qDebug() << "Task" << t.id << "resumes at" << c.range.position() << "-" << levels.join(", ");
     }
-    if (m_store) const_cast<ManifestStore*>(m_store)->save();
+    emit taskProgress(t.id, cur.completedTiles, cur.totalTiles);
+    m_drained.remove(c.task);
+    m_cursors.append(c);
 }
 
 void DownloadScheduler::onTileCached(int x, int y, int z, bool success)
 {
-    Q_UNUSED(success);
-    auto key = packKey(x,y,z);
-    if (m_outstanding.contains(key)) {
-        QString taskId = m_outstanding.take(key);
-        m_inflight = qMax(0, m_inflight - 1);
-        if (m_store) {
-            const_cast<ManifestStore*>(m_store)->updateProgress(taskId, success ? 1 : 0, success ? 0 : 1);
-            const_cast<ManifestStore*>(m_store)->save();
-            // 触发进度信号（读一遍任务得到总数与完成数）
-            auto t = m_store->getTask(taskId);
-            emit taskProgress(taskId, t.completedTiles, t.totalTiles);
+    QVector<Outstanding> waiters;
+    if (!m_outstanding.take(TileId(x, y, z), waiters)) return;
+    m_inflight = qMax(0, m_inflight - 1);
+    if (!m_store) return;
+    // 一次回调记入所有等待该瓦片的任务；每个瓦片只追加一条日志记录，重复回调只会重复置位，计数不漂移
+    for (const Outstanding &job : waiters) {
+        const QString taskId = m_taskIds.value(job.task);
+        if (success) const_cast<ManifestStore*>(m_store)->markDone(taskId, job.ordinal, job.ordinal);
+        else const_cast<ManifestStore*>(m_store)->markFailed(taskId, job.ordinal);
+        reportProgress(taskId);
+        if (--m_taskInflight[job.task] <= 0) {
+            m_taskInflight.remove(job.task);
+            settleDrained(job.task);
         }
-        // emit taskProgress(taskId, ...); // 后续补充具体值
     }
 }
 
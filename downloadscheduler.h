@@ -5,10 +5,15 @@
 #include <QQueue>
 #include <QTimer>
 #include <QHash>
+#include <QSet>
+#include <QVector>
 #include <QtGlobal>
-class TileMapManager;
+class TileFetcher;
 #include "manifeststore.h"
 #include "mapmanagersettings.h"
+#include "tileid.h"
+#include "tilerange.h"
+#include "flathashmap.h"
 
 class DownloadScheduler : public QObject {
     Q_OBJECT
@@ -17,19 +22,31 @@ public:
 
     void configure(const MapManagerSettings &settings);
     void setManifest(ManifestStore *store);
-    void setTileManager(TileMapManager *mgr);
+    void setFetcher(TileFetcher *fetcher); // 抓取与落盘（GUI 取自 TileMapManager，命令行自建）
 
     void start();
     void pause();
     void resume() { start(); }
-    void enqueueTask(const DownloadTask &task); // 追加任务到清单并保存
-    void pauseTask(const QString &taskId); // TODO
-    void resumeTask(const QString &taskId); // TODO
-    void cancelTask(const QString &taskId); // TODO
+    // 后台模式（窗口最小化）：并发上限提高 kBackgroundConcurrency 倍，速率限制不变
+    void setBackgroundMode(bool background) { m_background = background; }
+    QString enqueueTask(const DownloadTask &task); // 追加任务到清单并保存，返回任务 id
+    // 清单中范围相同（经纬度、层级、边界文件）且未取消的整区任务；有多个时取进度最多的，没有返回空
+    QString findTask(const DownloadTask &like) const;
+    // 单任务控制：暂停/取消把游标移出轮转，恢复时放回（暂停前的位置不变）
+    void pauseTask(const QString &taskId);
+    void resumeTask(const QString &taskId);
+    void cancelTask(const QString &taskId);
+
+    // 任务的瓦片范围：沿线任务按折线缓冲区，有边界文件时按多边形，否则按经纬度矩形；
+    // bboxTotal 返回外包矩形瓦片数
+    static TileRange rangeForTask(const DownloadTask &task, qint64 *bboxTotal = nullptr);
+    // 预先给定任务范围（分片进程对同一任务反复建游标时避免重复栅格化）
+    void setTaskRange(const QString &taskId, const TileRange &range) { m_presetRanges.insert(taskId, range); }
 
 signals:
-    void taskProgress(const QString &taskId, int completed, int total);
+    void taskProgress(const QString &taskId, qint64 completed, qint64 total);
     void taskStatusChanged(const QString &taskId, const QString &status);
+    void taskPlanned(const QString &taskId, qint64 total, qint64 bboxTotal);
     void allTasksFinished();
 
 private slots:
@@ -41,18 +58,49 @@ private:
     ManifestStore *m_store = nullptr;
     QTimer m_timer; // 简易令牌：按速率周期发起
     int m_inflight = 0;
-    TileMapManager *m_mgr = nullptr;
-
-    struct TileJob { QString taskId; int x; int y; int z; };
-    QQueue<TileJob> m_queue;
-    bool m_queueBuilt = false;
-    void buildQueueFromTasks();
-
-    struct TileKey { int x; int y; int z; };
-    struct TileKeyHash { inline size_t operator()(const TileKey &k) const noexcept { return qHash(k.x) ^ (qHash(k.y)<<1) ^ (qHash(k.z)<<2); } };
-    struct TileKeyEq { inline bool operator()(const TileKey &a, const TileKey &b) const noexcept { return a.x==b.x && a.y==b.y && a.z==b.z; } };
-    QHash<quint64, QString> m_outstanding; // packed key -> taskId
-    static inline quint64 packKey(int x,int y,int z){ return (quint64(z)&0x3F)<<58 | (quint64(x)&0x3FFFFFF)<<32 | (quint64(y)&0xFFFFFFFF); }
+    TileFetcher *m_fetcher = nullptr;
+    bool m_background = false;
+    static constexpr int kBackgroundConcurrency = 2;
+
+    // 每个任务一个惰性游标，内存 O(任务数)；task: 任务句柄（m_taskIds 下标）
+    // 游标按完成位图跳过已完成序号；skipStart/skipped 为尚未记入清单的一段连续本地命中
+    // weight = priority + 1，deficit 为本轮剩余额度（差额轮询）；end 为分片终点（不含）
+    struct TaskCursor {
+        int task = -1;
+        TileRange range;
+        qint64 end = 0;
+        qint64 skipStart = 0;
+        qint64 skipped = 0;
+        int weight = 1;
+        int deficit = 0;
+    };
+    QVector<TaskCursor> m_cursors;   // 轮转中的任务
+    QHash<int, TaskCursor> m_paused; // 暂停任务的游标
+    int m_rr = 0;                    // 当前轮到的游标下标
+    bool m_cursorsBuilt = false;
+    QHash<QString, TileRange> m_presetRanges;
+    void buildCursorsFromTasks();
+    void appendCursor(const DownloadTask &t);
+    struct Outstanding { int task = -1; qint64 ordinal = 0; }; // 在途瓦片所属任务句柄与序号
+    bool nextJob(Outstanding &job, TileId &id); // 跳过已完成/已缓存瓦片；超出单次跳过预算时返回 false
+    bool scanCursor(TaskCursor &c, Outstanding &job, TileId &id, int &budget);
+    bool takeCursor(const QString &taskId, TaskCursor &out); // 移出轮转
+    void setTaskStatus(const QString &taskId, const QString &status);
+    void flushSkipped(TaskCursor &c);
+    bool underUniform(const TileId &id) const; // 开启纯色跳过且有纯色祖先
+    void reportProgress(const QString &taskId); // 发进度信号，全部完成时置 completed
+    // 游标已走完的任务：在途瓦片全部回调后，仍有失败瓦片则置 partial（本次运行结束，下次启动或续传时重试）
+    QHash<int, int> m_taskInflight; // 任务句柄 -> 在途瓦片数
+    QSet<int> m_drained;            // 游标已走完、等待在途瓦片回调的任务句柄
+    void settleDrained(int task);
+
+    // tile -> 等待它的（任务句柄, 序号）；区域重叠的任务共用同一个在途请求，回调时逐一记入
+    FlatHashMap<TileId, QVector<Outstanding>, TileIdHash> m_outstanding;
+
+    // 任务 id 与小整数句柄互转，避免每个在途瓦片持有一份 QString
+    QVector<QString> m_taskIds;
+    QHash<QString, int> m_taskHandles;
+    int taskHandle(const QString &taskId);
 };
 
 #endif // DOWNLOADSCHEDULER_H
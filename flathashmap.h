@@ -0,0 +1,202 @@
+#ifndef FLATHASHMAP_H
+#define FLATHASHMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// 开放寻址哈希表：线性探测 + 反向移位删除（无墓碑）。
+// 键、值、占用标记分别连续存放，查找只扫键数组；适用于整数类键（如 TileId）。
+// Hash 需返回分布良好的 size_t（低位直接作为桶下标）。
+template <typename K, typename V, typename Hash>
+class FlatHashMap
+{
+public:
+    FlatHashMap() = default;
+    explicit FlatHashMap(size_t expected) { reserve(expected); }
+
+    size_t size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+    size_t capacity() const { return m_keys.size(); }
+
+    void clear()
+    {
+        m_keys.clear();
+        m_values.clear();
+        m_used.clear();
+        m_size = 0;
+        m_mask = 0;
+    }
+
+    void reserve(size_t expected)
+    {
+        size_t cap = 16;
+        while (cap * kMaxLoadNum < expected * kMaxLoadDen) cap <<= 1;
+        if (cap > capacity()) rehash(cap);
+    }
+
+    bool contains(const K &key) const { return findIndex(key) != npos; }
+
+    V *find(const K &key)
+    {
+        const size_t i = findIndex(key);
+        return i == npos ? nullptr : &m_values[i];
+    }
+    const V *find(const K &key) const
+    {
+        const size_t i = findIndex(key);
+        return i == npos ? nullptr : &m_values[i];
+    }
+
+    V value(const K &key, const V &def = V()) const
+    {
+        const V *v = find(key);
+        return v ? *v : def;
+    }
+
+    // 插入或覆盖
+    void insert(const K &key, const V &val) { slotFor(key) = val; }
+    void insert(const K &key, V &&val) { slotFor(key) = std::move(val); }
+
+    V &operator[](const K &key) { return slotFor(key); }
+
+    bool remove(const K &key)
+    {
+        const size_t i = findIndex(key);
+        if (i == npos) return false;
+        eraseAt(i);
+        return true;
+    }
+
+    // 取出并删除；不存在返回 false
+    bool take(const K &key, V &out)
+    {
+        const size_t i = findIndex(key);
+        if (i == npos) return false;
+        out = std::move(m_values[i]);
+        eraseAt(i);
+        return true;
+    }
+
+    // 按条件批量删除；pred(key, value) 返回 true 的被移除
+    template <typename Pred>
+    size_t removeIf(Pred pred)
+    {
+        std::vector<K> doomed;
+        for (size_t i = 0; i < m_keys.size(); ++i) {
+            if (m_used[i] && pred(m_keys[i], m_values[i])) doomed.push_back(m_keys[i]);
+        }
+        for (const K &k : doomed) remove(k);
+        return doomed.size();
+    }
+
+    // 遍历所有元素：f(key, value)
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (size_t i = 0; i < m_keys.size(); ++i) {
+            if (m_used[i]) f(m_keys[i], m_values[i]);
+        }
+    }
+
+private:
+    static constexpr size_t npos = size_t(-1);
+    // 最大装载因子 7/8
+    static constexpr size_t kMaxLoadNum = 7;
+    static constexpr size_t kMaxLoadDen = 8;
+
+    size_t findIndex(const K &key) const
+    {
+        if (m_size == 0) return npos;
+        size_t i = Hash()(key) & m_mask;
+        while (m_used[i]) {
+            if (m_keys[i] == key) return i;
+            i = (i + 1) & m_mask;
+        }
+        return npos;
+    }
+
+    V &slotFor(const K &key)
+    {
+        if ((m_size + 1) * kMaxLoadDen > capacity() * kMaxLoadNum) {
+            rehash(capacity() ? capacity() * 2 : 16);
+        }
+        size_t i = Hash()(key) & m_mask;
+        while (m_used[i]) {
+            if (m_keys[i] == key) return m_values[i];
+            i = (i + 1) & m_mask;
+        }
+        m_used[i] = 1;
+        m_keys[i] = key;
+        m_values[i] = V();
+        ++m_size;
+        return m_values[i];
+    }
+
+    // 反向移位：把后续同簇元素前移填补空位，保持探测链连续
+    void eraseAt(size_t hole)
+    {
+        size_t i = (hole + 1) & m_mask;
+        while (m_used[i]) {
+            const size_t home = Hash()(m_keys[i]) & m_mask;
+            // home 不在 (hole, i] 循环区间内时，元素可以移到 hole
+            const bool movable = hole <= i ? (home <= hole || home > i)
+                                           : (home <= hole && home > i);
+            if (movable) {
+                m_keys[hole] = m_keys[i];
+                m_values[hole] = std::move(m_values[i]);
+                hole = i;
+            }
+            i = (i + 1) & m_mask;
+        }
+        m_used[hole] = 0;
+        m_values[hole] = V();
+        --m_size;
+    }
+
+    void rehash(size_t newCap)
+    {
+        std::vector<K> oldKeys;
+        std::vector<V> oldValues;
+        std::vector<uint8_t> oldUsed;
+        oldKeys.swap(m_keys);
+        oldValues.swap(m_values);
+        oldUsed.swap(m_used);
+
+        m_keys.assign(newCap, K());
+        m_values.resize(newCap);
+        m_used.assign(newCap, 0);
+        m_mask = newCap - 1;
+        m_size = 0;
+        for (size_t j = 0; j < oldKeys.size(); ++j) {
+            if (!oldUsed[j]) continue;
+            size_t i = Hash()(oldKeys[j]) & m_mask;
+            while (m_used[i]) i = (i + 1) & m_mask;
+            m_used[i] = 1;
+            m_keys[i] = oldKeys[j];
+            m_values[i] = std::move(oldValues[j]);
+            ++m_size;
+        }
+    }
+
+    std::vector<K> m_keys;
+    std::vector<V> m_values;
+    std::vector<uint8_t> m_used;
+    size_t m_size = 0;
+    size_t m_mask = 0;
+};
+
+// 通用整数哈希（splitmix64 终结步）
+struct FlatIntHash
+{
+    size_t operator()(uint64_t v) const noexcept
+    {
+        v += 0x9E3779B97F4A7C15ull;
+        v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+        v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+        return size_t(v ^ (v >> 31));
+    }
+};
+
+#endif // FLATHASHMAP_H
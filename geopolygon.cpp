@@ -0,0 +1,71 @@
+#include "geopolygon.h"
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+QRectF GeoPolygon::bounds() const
+{
+    bool first = true;
+    double minX = 0, minY = 0, maxX = 0, maxY = 0;
+    for (const auto &ring : rings) {
+        for (const QPointF &p : ring) {
+            if (first) { minX = maxX = p.x(); minY = maxY = p.y(); first = false; continue; }
+            minX = qMin(minX, p.x()); maxX = qMax(maxX, p.x());
+            minY = qMin(minY, p.y()); maxY = qMax(maxY, p.y());
+        }
+    }
+    return first ? QRectF() : QRectF(QPointF(minX, minY), QPointF(maxX, maxY));
+}
+
+static void appendRing(const QJsonArray &coords, GeoPolygon &out)
+{
+    QVector<QPointF> ring;
+    ring.reserve(coords.size());
+    for (const auto &v : coords) {
+        const QJsonArray pt = v.toArray();
+        if (pt.size() < 2) continue;
+        ring.append(QPointF(pt.at(0).toDouble(), pt.at(1).toDouble()));
+    }
+    // 去掉与首点重复的闭合点
+    if (ring.size() > 1 && ring.first() == ring.last()) ring.removeLast();
+    if (ring.size() >= 3) out.rings.append(ring);
+}
+
+static void appendGeometry(const QJsonObject &geom, GeoPolygon &out)
+{
+    const QString type = geom.value("type").toString();
+    if (type == "Polygon") {
+        for (const auto &ring : geom.value("coordinates").toArray()) appendRing(ring.toArray(), out);
+    } else if (type == "MultiPolygon") {
+        for (const auto &poly : geom.value("coordinates").toArray()) {
+            for (const auto &ring : poly.toArray()) appendRing(ring.toArray(), out);
+        }
+    } else if (type == "GeometryCollection") {
+        for (const auto &g : geom.value("geometries").toArray()) appendGeometry(g.toObject(), out);
+    } else if (type == "Feature") {
+        appendGeometry(geom.value("geometry").toObject(), out);
+    } else if (type == "FeatureCollection") {
+        for (const auto &f : geom.value("features").toArray()) appendGeometry(f.toObject(), out);
+    }
+}
+
+GeoPolygon GeoPolygon::loadGeoJson(const QString &path, QString *error)
+{
+    GeoPolygon poly;
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        if (error) *error = QString("cannot open %1").arg(path);
+        return poly;
+    }
+    QJsonParseError perr;
+    const QJsonDocument doc = QJsonDocument::fromJson(f.readAll(), &perr);
+    f.close();
+    if (!doc.isObject()) {
+        if (error) *error = perr.errorString();
+        return poly;
+    }
+    appendGeometry(doc.object(), poly);
+    if (poly.isEmpty() && error) *error = "no polygon geometry";
+    return poly;
+}
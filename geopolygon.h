@@ -0,0 +1,21 @@
+#ifndef GEOPOLYGON_H
+#define GEOPOLYGON_H
+
+#include <QString>
+#include <QVector>
+#include <QPointF>
+#include <QRectF>
+
+// 经纬度多边形（点为 x=经度, y=纬度）。
+// 多个多边形及其内环统一存为环列表，按奇偶规则判定内外，洞自然扣除。
+struct GeoPolygon {
+    QVector<QVector<QPointF>> rings;
+
+    bool isEmpty() const { return rings.isEmpty(); }
+    QRectF bounds() const; // left=最小经度, top=最小纬度
+
+    // 读取 GeoJSON：Polygon / MultiPolygon，可包在 Feature / FeatureCollection / GeometryCollection 中
+    static GeoPolygon loadGeoJson(const QString &path, QString *error = nullptr);
+};
+
+#endif // GEOPOLYGON_H
@@ -5,6 +5,7 @@
 #include <QDebug>
 #include "basewindow.h"
 #include "myform.h"
+#include "asynclogger.h"
 
 // class MyWindow : public BaseWindow {
 // public:
@@ -40,12 +41,18 @@ int main(int argc, char *argv[]) {
         styleFile.close();
     }
 
-    BaseWindow window;
-    MyForm *form = new MyForm(&window); // parent 设为 window，自动管理内存
-    window.setContentWidget(form);
-    window.resize(960, 720);
-    window.show();
-
-    qDebug() << "=== Application window shown ===";
-    return app.exec();
+    int rc = 0;
+    {
+        BaseWindow window;
+        MyForm *form = new MyForm(&window); // parent 设为 window，自动管理内存
+        window.setContentWidget(form);
+        QObject::connect(&window, &BaseWindow::minimizedChanged, form, &MyForm::setBackgroundMode);
+        window.resize(960, 720);
+        window.show();
+
+        qDebug() << "=== Application window shown ===";
+        rc = app.exec();
+    } // 窗口在此析构，析构过程中的日志仍进入缓冲
+    AsyncLogger::shutdown(); // 写完缓冲中剩余的日志
+    return rc;
 }
\ No newline at end of file
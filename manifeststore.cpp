@@ -4,18 +4,35 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QUuid>
+#include <QSaveFile>
+#include <QDebug>
+#if defined(Q_OS_WIN)
+#include <io.h>
+#elif defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
 
 static QJsonObject toJson(const DownloadTask &t)
 {
     QJsonObject o;
     o["id"] = t.id;
     o["minLat"] = t.minLat; o["maxLat"] = t.maxLat; o["minLon"] = t.minLon; o["maxLon"] = t.maxLon;
+    o["polygonPath"] = t.polygonPath;
+    if (!t.route.isEmpty()) {
+        QJsonArray route;
+        for (const QPointF &p : t.route) route.push_back(QJsonArray{p.x(), p.y()});
+        o["route"] = route;
+        o["bufferMeters"] = t.bufferMeters;
+    }
     o["minZoom"] = t.minZoom; o["maxZoom"] = t.maxZoom;
     o["priority"] = t.priority;
     o["status"] = t.status;
     o["totalTiles"] = t.totalTiles;
     o["completedTiles"] = t.completedTiles;
     o["failedTiles"] = t.failedTiles;
+    if (!t.doneBits.isEmpty()) o["doneBits"] = QString::fromLatin1(t.doneBits.toBytes().toBase64());
+    if (!t.failedBits.isEmpty()) o["failedBits"] = QString::fromLatin1(t.failedBits.toBytes().toBase64());
+    if (t.shardEnd >= 0) { o["shardBegin"] = t.shardBegin; o["shardEnd"] = t.shardEnd; }
     o["createdAt"] = t.createdAt.toString(Qt::ISODateWithMs);
     o["updatedAt"] = t.updatedAt.toString(Qt::ISODateWithMs);
     return o;
@@ -27,56 +44,271 @@ static DownloadTask fromJson(const QJsonObject &o)
     t.id = o.value("id").toString();
     t.minLat = o.value("minLat").toDouble(); t.maxLat = o.value("maxLat").toDouble();
     t.minLon = o.value("minLon").toDouble(); t.maxLon = o.value("maxLon").toDouble();
+    t.polygonPath = o.value("polygonPath").toString();
+    for (const auto &v : o.value("route").toArray()) {
+        const QJsonArray p = v.toArray();
+        if (p.size() >= 2) t.route.push_back(QPointF(p.at(0).toDouble(), p.at(1).toDouble()));
+    }
+    t.bufferMeters = o.value("bufferMeters").toDouble(0);
     t.minZoom = o.value("minZoom").toInt(3); t.maxZoom = o.value("maxZoom").toInt(10);
     t.priority = o.value("priority").toInt(0);
     t.status = o.value("status").toString("pending");
-    t.totalTiles = o.value("totalTiles").toInt(0);
-    t.completedTiles = o.value("completedTiles").toInt(0);
-    t.failedTiles = o.value("failedTiles").toInt(0);
+    t.totalTiles = o.value("totalTiles").toInteger(0);
+    t.completedTiles = o.value("completedTiles").toInteger(0);
+    t.failedTiles = o.value("failedTiles").toInteger(0);
+    bool doneOk = false, failedOk = false;
+    t.doneBits = TileBitmap::fromBytes(QByteArray::fromBase64(o.value("doneBits").toString().toLatin1()), &doneOk);
+    t.failedBits = TileBitmap::fromBytes(QByteArray::fromBase64(o.value("failedBits").toString().toLatin1()), &failedOk);
+    if (!doneOk || !failedOk) qDebug() << "Manifest task" << t.id << "has a corrupt tile bitmap, progress restarts";
+    // 计数以位图为准（旧清单没有位图时从零开始，已缓存瓦片会在遍历中快速跳过）
+    t.completedTiles = t.doneBits.count();
+    t.failedTiles = t.failedBits.count();
+    t.shardBegin = o.value("shardBegin").toInteger(0);
+    t.shardEnd = o.value("shardEnd").toInteger(-1);
     t.createdAt = QDateTime::fromString(o.value("createdAt").toString(), Qt::ISODateWithMs);
     t.updatedAt = QDateTime::fromString(o.value("updatedAt").toString(), Qt::ISODateWithMs);
     return t;
 }
 
-ManifestStore::ManifestStore(const QString &path)
+// 日志行格式：<seq> <op> <taskId> [参数...]\n
+//   D 起始序号 结束序号 | F 序号 | T 总数 | R（清空位图）| S 状态
+static const int kSyncEvery = 64;        // 累计多少条记录 fsync 一次
+static const int kSyncIntervalMs = 1000; // 或距上次 fsync 超过该时长
+static const int kCompactEvery = 20000;  // 日志记录数超过该值时写快照并截断
+
+static bool syncFile(QFile &f)
+{
+    if (!f.flush()) return false;
+#if defined(Q_OS_WIN)
+    return _commit(f.handle()) == 0;
+#elif defined(Q_OS_UNIX)
+    return ::fsync(f.handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+ManifestStore::ManifestStore(const QString &path, bool readOnly)
     : m_path(path)
+    , m_readOnly(readOnly)
+{
+}
+
+ManifestStore::~ManifestStore()
+{
+    closeJournal();
+}
+
+void ManifestStore::closeJournal()
+{
+    if (!m_journal.isOpen()) return;
+    if (m_unsynced > 0) syncFile(m_journal);
+    m_unsynced = 0;
+    m_journal.close();
+}
+
+DownloadTask *ManifestStore::findTask(const QString &id)
+{
+    for (auto &t : m_tasks) if (t.id == id) return &t;
+    return nullptr;
+}
+
+const DownloadTask *ManifestStore::findTask(const QString &id) const
 {
+    for (const auto &t : m_tasks) if (t.id == id) return &t;
+    return nullptr;
+}
+
+void ManifestStore::applyDone(DownloadTask &t, qint64 from, qint64 to)
+{
+    t.doneBits.addRange(from, to);
+    if (!t.failedBits.isEmpty()) {
+        for (qint64 i = from; i <= to; ++i) t.failedBits.remove(i);
+    }
+    t.completedTiles = t.doneBits.count();
+    t.failedTiles = t.failedBits.count();
+}
+
+void ManifestStore::applyFailed(DownloadTask &t, qint64 ordinal)
+{
+    if (t.doneBits.contains(ordinal)) return;
+    t.failedBits.add(ordinal);
+    t.failedTiles = t.failedBits.count();
+}
+
+void ManifestStore::applyTotal(DownloadTask &t, qint64 total)
+{
+    // 区域变化后序号不再对应原瓦片，位图作废
+    if (t.totalTiles != total && (!t.doneBits.isEmpty() || !t.failedBits.isEmpty())) applyReset(t);
+    t.totalTiles = total;
+}
+
+void ManifestStore::applyReset(DownloadTask &t)
+{
+    t.doneBits.clear();
+    t.failedBits.clear();
+    t.completedTiles = 0;
+    t.failedTiles = 0;
 }
 
 bool ManifestStore::load()
 {
-    QFile f(m_path);
-    if (!f.open(QIODevice::ReadOnly)) { m_tasks.clear(); return false; }
-    auto doc = QJsonDocument::fromJson(f.readAll());
-    f.close();
+    closeJournal();
     m_tasks.clear();
-    if (!doc.isObject()) return false;
-    auto arr = doc.object().value("tasks").toArray();
-    for (auto v : arr) m_tasks.push_back(fromJson(v.toObject()));
+    m_seq = 0;
+    m_journalRecords = 0;
+    bool snapshotOk = false;
+    QFile f(m_path);
+    if (f.open(QIODevice::ReadOnly)) {
+        auto doc = QJsonDocument::fromJson(f.readAll());
+        f.close();
+        if (doc.isObject()) {
+            snapshotOk = true;
+            const QJsonObject root = doc.object();
+            for (auto v : root.value("tasks").toArray()) m_tasks.push_back(fromJson(v.toObject()));
+            m_seq = root.value("journalSeq").toInteger(0);
+        }
+    }
+
+    // 重放快照之后的日志；末尾不完整的行（写入中途崩溃）忽略
+    QFile j(m_path + ".journal");
+    int replayed = 0;
+    qint64 validSize = 0;
+    if (j.open(QIODevice::ReadOnly)) {
+        while (!j.atEnd()) {
+            const QByteArray line = j.readLine();
+            if (!line.endsWith('\n')) break;
+            validSize = j.pos();
+            ++m_journalRecords;
+            if (applyRecord(line.trimmed())) ++replayed;
+        }
+        const bool torn = validSize < j.size();
+        j.close();
+        // 截掉残行，避免后续追加与其拼接
+        if (torn && !m_readOnly) QFile::resize(j.fileName(), validSize);
+    }
+    if (replayed > 0) qDebug() << "Manifest journal replayed" << replayed << "records, seq" << m_seq;
+    return snapshotOk || replayed > 0;
+}
+
+bool ManifestStore::applyRecord(const QByteArray &line)
+{
+    const QList<QByteArray> f = line.split(' ');
+    if (f.size() < 3 || f.at(1).size() != 1) return false;
+    bool ok = false;
+    const qint64 seq = f.at(0).toLongLong(&ok);
+    if (!ok || seq <= m_seq) return false; // 已包含在快照中
+    m_seq = seq;
+    DownloadTask *t = findTask(QString::fromLatin1(f.at(2)));
+    if (!t) return false;
+    switch (f.at(1).at(0)) {
+    case 'D':
+        if (f.size() < 5) return false;
+        applyDone(*t, f.at(3).toLongLong(), f.at(4).toLongLong());
+        break;
+    case 'F':
+        if (f.size() < 4) return false;
+        applyFailed(*t, f.at(3).toLongLong());
+        break;
+    case 'T':
+        if (f.size() < 4) return false;
+        applyTotal(*t, f.at(3).toLongLong());
+        break;
+    case 'R':
+        applyReset(*t);
+        break;
+    case 'S':
+        if (f.size() < 4) return false;
+        t->status = QString::fromUtf8(f.at(3));
+        break;
+    default:
+        return false;
+    }
     return true;
 }
 
-bool ManifestStore::save() const
+void ManifestStore::appendRecord(char op, const QString &id, const QByteArray &a, const QByteArray &b)
 {
+    if (m_readOnly) return;
+    if (m_journalRecords >= kCompactEvery) {
+        save();
+        return; // 快照已包含本次变更
+    }
+    if (!m_journal.isOpen()) {
+        m_journal.setFileName(m_path + ".journal");
+        if (!m_journal.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qDebug() << "Manifest journal open failed:" << m_journal.errorString();
+            return;
+        }
+        m_lastSync.start();
+    }
+    QByteArray line = QByteArray::number(++m_seq);
+    line += ' ';
+    line += op;
+    line += ' ';
+    line += id.toLatin1();
+    if (!a.isEmpty()) { line += ' '; line += a; }
+    if (!b.isEmpty()) { line += ' '; line += b; }
+    line += '\n';
+    m_journal.write(line);
+    // 每条记录都交给操作系统（进程崩溃不丢），按组 fsync（掉电最多丢一组）
+    m_journal.flush();
+    ++m_journalRecords;
+    if (++m_unsynced >= kSyncEvery || m_lastSync.elapsed() >= kSyncIntervalMs) sync();
+}
+
+void ManifestStore::sync()
+{
+    if (!m_journal.isOpen() || m_unsynced == 0) return;
+    if (!syncFile(m_journal)) qDebug() << "Manifest journal fsync failed";
+    m_unsynced = 0;
+    m_lastSync.restart();
+}
+
+bool ManifestStore::save()
+{
+    if (m_readOnly) return false;
     QJsonArray arr; for (const auto &t : m_tasks) arr.push_back(toJson(t));
-    QJsonObject root; root["tasks"] = arr;
-    QFile f(m_path);
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
-    f.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
-    f.close();
+    QJsonObject root;
+    root["tasks"] = arr;
+    root["journalSeq"] = m_seq;
+    // 先原子替换快照，再截断日志；两步之间崩溃时重放按序号跳过旧记录
+    QSaveFile f(m_path);
+    if (!f.open(QIODevice::WriteOnly)) return false;
+    f.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    if (!f.commit()) {
+        qDebug() << "Manifest snapshot write failed:" << f.errorString();
+        return false;
+    }
+    closeJournal();
+    QFile::resize(m_path + ".journal", 0);
+    m_journalRecords = 0;
     return true;
 }
 
-void ManifestStore::upsertTask(const DownloadTask &t)
+void ManifestStore::mergeBits(const QString &id, const TileBitmap &done, const TileBitmap &failed)
+{
+    DownloadTask *t = findTask(id);
+    if (!t) return;
+    t->doneBits.unite(done);
+    t->failedBits.unite(failed);
+    t->failedBits.subtract(t->doneBits);
+    t->completedTiles = t->doneBits.count();
+    t->failedTiles = t->failedBits.count();
+    t->updatedAt = QDateTime::currentDateTime();
+}
+
+QString ManifestStore::upsertTask(const DownloadTask &t)
 {
     for (auto &it : m_tasks) {
-        if (it.id == t.id) { it = t; return; }
+        if (it.id == t.id) { it = t; return t.id; }
     }
     DownloadTask c = t;
     if (c.id.isEmpty()) c.id = QUuid::createUuid().toString(QUuid::WithoutBraces);
     if (!c.createdAt.isValid()) c.createdAt = QDateTime::currentDateTime();
     c.updatedAt = c.createdAt;
     m_tasks.push_back(c);
+    return c.id;
 }
 
 void ManifestStore::removeTask(const QString &id)
@@ -90,36 +322,53 @@ DownloadTask ManifestStore::getTask(const QString &id) const
     return DownloadTask();
 }
 
-void ManifestStore::updateProgress(const QString &id, int completedDelta, int failedDelta)
+void ManifestStore::markDone(const QString &id, qint64 from, qint64 to)
 {
-    for (auto &t : m_tasks) {
-        if (t.id == id) {
-            t.completedTiles += completedDelta;
-            t.failedTiles += failedDelta;
-            if (t.completedTiles < 0) t.completedTiles = 0;
-            if (t.totalTiles > 0 && t.completedTiles > t.totalTiles) t.completedTiles = t.totalTiles;
-            t.updatedAt = QDateTime::currentDateTime();
-            return;
-        }
-    }
+    DownloadTask *t = findTask(id);
+    if (!t || to < from) return;
+    applyDone(*t, from, to);
+    t->updatedAt = QDateTime::currentDateTime();
+    appendRecord('D', id, QByteArray::number(from), QByteArray::number(to));
 }
 
-void ManifestStore::setStatus(const QString &id, const QString &status)
+void ManifestStore::markFailed(const QString &id, qint64 ordinal)
 {
-    for (auto &t : m_tasks) {
-        if (t.id == id) {
-            t.status = status;
-            t.updatedAt = QDateTime::currentDateTime();
-            return;
-        }
-    }
+    DownloadTask *t = findTask(id);
+    if (!t) return;
+    applyFailed(*t, ordinal);
+    t->updatedAt = QDateTime::currentDateTime();
+    appendRecord('F', id, QByteArray::number(ordinal));
 }
 
-void ManifestStore::setTotalTiles(const QString &id, int total)
+qint64 ManifestStore::nextPending(const QString &id, qint64 from) const
 {
-    for (auto &t : m_tasks) {
-        if (t.id == id) { t.totalTiles = total; t.updatedAt = QDateTime::currentDateTime(); return; }
-    }
+    const DownloadTask *t = findTask(id);
+    return t ? t->doneBits.nextClear(from) : from;
 }
 
+void ManifestStore::setStatus(const QString &id, const QString &status)
+{
+    DownloadTask *t = findTask(id);
+    if (!t || t->status == status) return;
+    t->status = status;
+    t->updatedAt = QDateTime::currentDateTime();
+    appendRecord('S', id, status.toUtf8());
+}
 
+void ManifestStore::setTotalTiles(const QString &id, qint64 total)
+{
+    DownloadTask *t = findTask(id);
+    if (!t || t->totalTiles == total) return;
+    applyTotal(*t, total);
+    t->updatedAt = QDateTime::currentDateTime();
+    appendRecord('T', id, QByteArray::number(total));
+}
+
+void ManifestStore::resetProgress(const QString &id)
+{
+    DownloadTask *t = findTask(id);
+    if (!t) return;
+    applyReset(*t);
+    t->updatedAt = QDateTime::currentDateTime();
+    appendRecord('R', id, QByteArray());
+}
@@ -4,37 +4,80 @@
 #include <QString>
 #include <QVector>
 #include <QDateTime>
+#include <QPointF>
+#include <QFile>
+#include <QElapsedTimer>
+#include "tilebitmap.h"
 
 struct DownloadTask {
     QString id;        // uuid-like
     double minLat = 0.0, maxLat = 0.0, minLon = 0.0, maxLon = 0.0;
+    QString polygonPath; // 边界 GeoJSON；非空时按多边形精确覆盖，经纬度范围为其外包矩形
+    QVector<QPointF> route;   // 沿线下载的折线（lon,lat）；非空时按缓冲区覆盖
+    double bufferMeters = 0;  // 折线两侧缓冲距离（米）
     int minZoom = 3, maxZoom = 10;
     int priority = 0;
     QString status;    // pending/downloading/paused/completed/cancelled
-    int totalTiles = 0;
-    int completedTiles = 0;
-    int failedTiles = 0;
+    qint64 totalTiles = 0;     // 可达数百万，用 64 位
+    qint64 completedTiles = 0; // = doneBits.count()
+    qint64 failedTiles = 0;    // = failedBits.count()
+    // 按 TileRange 序号（任务区域内的遍历次序）记录的完成/失败位图；总数变化时作废
+    TileBitmap doneBits;
+    TileBitmap failedBits;
+    // 分片任务：只遍历序号 [shardBegin, shardEnd)；shardEnd < 0 表示整个区域
+    qint64 shardBegin = 0;
+    qint64 shardEnd = -1;
     QDateTime createdAt;
     QDateTime updatedAt;
 };
 
+// 任务清单：快照（JSON）+ 追加式日志。
+// 完成/失败序号、状态等高频变更只向 <path>.journal 追加一行带序号的紧凑记录，按组 fsync；
+// 日志过长或 save() 时写新快照（QSaveFile 原子替换）并截断日志。load() 读快照后重放序号更大的记录。
 class ManifestStore {
 public:
-    explicit ManifestStore(const QString &path);
+    // readOnly：只读取快照与日志（其他进程仍在写入），不截断残行、不写任何文件
+    explicit ManifestStore(const QString &path, bool readOnly = false);
+    ~ManifestStore();
     bool load();
-    bool save() const;
+    bool save(); // 写快照并截断日志（结构变更后调用）
+    void sync(); // 立即 fsync 未落盘的日志记录
 
     QVector<DownloadTask> tasks() const { return m_tasks; }
-    void upsertTask(const DownloadTask &t);
+    QString upsertTask(const DownloadTask &t); // 返回任务 id（新任务自动分配）
     void removeTask(const QString &id);
     DownloadTask getTask(const QString &id) const;
-    void updateProgress(const QString &id, int completedDelta, int failedDelta);
+    // 序号 [from, to] 完成（同时清除其失败位）；单个序号失败
+    void markDone(const QString &id, qint64 from, qint64 to);
+    void markFailed(const QString &id, qint64 ordinal);
+    qint64 nextPending(const QString &id, qint64 from) const; // >= from 的第一个未完成序号
     void setStatus(const QString &id, const QString &status);
-    void setTotalTiles(const QString &id, int total);
+    void setTotalTiles(const QString &id, qint64 total); // 与原总数不同则清空位图
+    void resetProgress(const QString &id); // 清空完成/失败位图
+    // 合并其他进程（分片）的完成/失败位图；只改内存，由调用方 save()
+    void mergeBits(const QString &id, const TileBitmap &done, const TileBitmap &failed);
+    QString path() const { return m_path; }
 
 private:
+    DownloadTask *findTask(const QString &id);
+    const DownloadTask *findTask(const QString &id) const;
+    static void applyDone(DownloadTask &t, qint64 from, qint64 to);
+    static void applyFailed(DownloadTask &t, qint64 ordinal);
+    static void applyTotal(DownloadTask &t, qint64 total);
+    static void applyReset(DownloadTask &t);
+    bool applyRecord(const QByteArray &line); // 重放一行日志
+    void appendRecord(char op, const QString &id, const QByteArray &a, const QByteArray &b = QByteArray());
+    void closeJournal();
+
     QString m_path;
+    bool m_readOnly = false;
     QVector<DownloadTask> m_tasks;
+
+    QFile m_journal;
+    qint64 m_seq = 0;         // 最后一条记录的序号（快照中保存为 journalSeq）
+    int m_journalRecords = 0; // 当前日志记录数，超过阈值时压缩
+    int m_unsynced = 0;       // 已写入但未 fsync 的记录数
+    QElapsedTimer m_lastSync;
 };
 
 #endif // MANIFESTSTORE_H
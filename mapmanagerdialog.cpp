@@ -45,6 +45,25 @@ MapManagerDialog::MapManagerDialog(QWidget *parent)
     grid->addWidget(new QLabel(tr("最大纬度")), r, 0); m_editMaxLat = new QLineEdit(this); m_editMaxLat->setText("54"); grid->addWidget(m_editMaxLat, r++, 1);
     grid->addWidget(new QLabel(tr("最小经度")), r, 0); m_editMinLon = new QLineEdit(this); m_editMinLon->setText("73"); grid->addWidget(m_editMinLon, r++, 1);
     grid->addWidget(new QLabel(tr("最大经度")), r, 0); m_editMaxLon = new QLineEdit(this); m_editMaxLon->setText("135"); grid->addWidget(m_editMaxLon, r++, 1);
+    // 边界文件（可选）：按多边形精确覆盖下载，替代经纬度矩形
+    grid->addWidget(new QLabel(tr("边界文件(GeoJSON)")), r, 0);
+    {
+        QWidget *w = new QWidget(this);
+        QHBoxLayout *hl = new QHBoxLayout(w);
+        hl->setContentsMargins(0,0,0,0);
+        hl->setSpacing(6);
+        m_editPolygon = new QLineEdit(w);
+        m_editPolygon->setPlaceholderText(tr("留空则按经纬度范围"));
+        m_btnBrowsePolygon = new QPushButton(tr("浏览..."), w);
+        hl->addWidget(m_editPolygon, /*stretch*/1);
+        hl->addWidget(m_btnBrowsePolygon);
+        grid->addWidget(w, r++, 1);
+        connect(m_btnBrowsePolygon, &QPushButton::clicked, this, [this]() {
+            QString file = QFileDialog::getOpenFileName(this, tr("选择边界文件"), m_editPolygon->text(),
+                                                        tr("GeoJSON (*.geojson *.json)"));
+            if (!file.isEmpty()) m_editPolygon->setText(file);
+        });
+    }
     grid->addWidget(new QLabel(tr("层级最小")), r, 0); m_spinMinZoom = new QSpinBox(this); m_spinMinZoom->setRange(0, 20); grid->addWidget(m_spinMinZoom, r++, 1);
     grid->addWidget(new QLabel(tr("层级最大")), r, 0); m_spinMaxZoom = new QSpinBox(this); m_spinMaxZoom->setRange(0, 20); grid->addWidget(m_spinMaxZoom, r++, 1);
     grid->addWidget(new QLabel(tr("最大并发")), r, 0); m_spinConcurrent = new QSpinBox(this); m_spinConcurrent->setRange(1, 64); grid->addWidget(m_spinConcurrent, r++, 1);
@@ -52,10 +71,13 @@ MapManagerDialog::MapManagerDialog(QWidget *parent)
     grid->addWidget(new QLabel(tr("最大重试")), r, 0); m_spinRetry = new QSpinBox(this); m_spinRetry->setRange(0, 10); grid->addWidget(m_spinRetry, r++, 1);
     grid->addWidget(new QLabel(tr("退避毫秒")), r, 0); m_spinBackoff = new QSpinBox(this); m_spinBackoff->setRange(0, 600000); grid->addWidget(m_spinBackoff, r++, 1);
     grid->addWidget(new QLabel(tr("预取环")), r, 0); m_spinPrefetch = new QSpinBox(this); m_spinPrefetch->setRange(0, 2); grid->addWidget(m_spinPrefetch, r++, 1);
+    grid->addWidget(new QLabel(tr("渐进加载阈值毫秒")), r, 0); m_spinProgressive = new QSpinBox(this); m_spinProgressive->setRange(0, 60000); m_spinProgressive->setToolTip(tr("预计下载耗时超过该值时先显示低层级瓦片，0 关闭")); grid->addWidget(m_spinProgressive, r++, 1);
     m_chkAsyncNetwork = new QCheckBox(tr("启用全异步网络下载"), this);
     grid->addWidget(m_chkAsyncNetwork, r++, 1);
     m_chkBrowseDownload = new QCheckBox(tr("边看边下（可视区域缺失瓦片自动下载）"), this);
     grid->addWidget(m_chkBrowseDownload, r++, 1);
+    m_chkSkipUniform = new QCheckBox(tr("跳过纯色瓦片的子瓦片（海洋/荒漠）"), this);
+    grid->addWidget(m_chkSkipUniform, r++, 1);
     lay->addLayout(grid);
     m_progressBar = new QProgressBar(this);
     m_progressBar->setRange(0, 100);
@@ -64,14 +86,50 @@ MapManagerDialog::MapManagerDialog(QWidget *parent)
     m_progressLabel = new QLabel(tr("进度: 0%"), this);
     lay->addWidget(m_progressBar);
     lay->addWidget(m_progressLabel);
+    m_planLabel = new QLabel(this);
+    m_planLabel->setWordWrap(true);
+    lay->addWidget(m_planLabel);
     m_btnSave = new QPushButton(tr("保存设置"));
     m_btnStart = new QPushButton(tr("开始下载"));
     m_btnPauseResume = new QPushButton(tr("暂停"));
+    m_spinPriority = new QSpinBox(this);
+    m_spinPriority->setRange(0, 9);
+    m_spinPriority->setToolTip(tr("多个任务同时下载时按 优先级+1 的比例分配带宽"));
     QHBoxLayout *ops = new QHBoxLayout();
     ops->addWidget(m_btnSave);
+    ops->addWidget(new QLabel(tr("优先级")));
+    ops->addWidget(m_spinPriority);
     ops->addWidget(m_btnStart);
     ops->addWidget(m_btnPauseResume);
     lay->addLayout(ops);
+    // 覆盖率（基于缓存覆盖索引，不遍历目录）
+    QHBoxLayout *cov = new QHBoxLayout();
+    m_btnCoverage = new QPushButton(tr("统计覆盖率"));
+    m_coverageLabel = new QLabel(tr("覆盖率: -"), this);
+    m_coverageLabel->setWordWrap(true);
+    m_btnBuildPyramid = new QPushButton(tr("本地生成低层级"));
+    cov->addWidget(m_btnCoverage);
+    cov->addWidget(m_btnBuildPyramid);
+    cov->addWidget(m_coverageLabel, 1);
+    lay->addLayout(cov);
+    connect(m_btnCoverage, &QPushButton::clicked, this, &MapManagerDialog::requestCoverage);
+    connect(m_btnBuildPyramid, &QPushButton::clicked, this, &MapManagerDialog::requestBuildPyramid);
+    // 沿线下载：以距离测量的折线为中心线，两侧缓冲指定米数
+    QHBoxLayout *route = new QHBoxLayout();
+    m_spinBuffer = new QSpinBox(this);
+    m_spinBuffer->setRange(10, 50000);
+    m_spinBuffer->setSingleStep(100);
+    m_spinBuffer->setValue(500);
+    m_spinBuffer->setSuffix(tr(" 米"));
+    m_btnRoute = new QPushButton(tr("沿测量线下载"));
+    route->addWidget(new QLabel(tr("缓冲距离")));
+    route->addWidget(m_spinBuffer);
+    route->addWidget(m_btnRoute);
+    route->addStretch(1);
+    lay->addLayout(route);
+    connect(m_btnRoute, &QPushButton::clicked, this, [this]() {
+        emit requestRouteDownload(m_spinBuffer->value());
+    });
     connect(m_btnSave, &QPushButton::clicked, this, &MapManagerDialog::requestSaveSettings);
     connect(m_btnStart, &QPushButton::clicked, this, &MapManagerDialog::requestStartDownload);
     connect(m_btnPauseResume, &QPushButton::clicked, this, [this]() {
@@ -82,22 +140,92 @@ MapManagerDialog::MapManagerDialog(QWidget *parent)
     m_taskList = new QListWidget(this);
     lay->addWidget(m_taskList);
     m_taskItems = new QHash<QString, QListWidgetItem*>();
+    // 选中任务的单独控制
+    QHBoxLayout *taskOps = new QHBoxLayout();
+    m_btnPauseTask = new QPushButton(tr("暂停任务"));
+    m_btnResumeTask = new QPushButton(tr("恢复任务"));
+    m_btnCancelTask = new QPushButton(tr("取消任务"));
+    taskOps->addWidget(m_btnPauseTask);
+    taskOps->addWidget(m_btnResumeTask);
+    taskOps->addWidget(m_btnCancelTask);
+    taskOps->addStretch(1);
+    lay->addLayout(taskOps);
+    connect(m_btnPauseTask, &QPushButton::clicked, this, [this]() {
+        const QString id = selectedTaskId();
+        if (!id.isEmpty()) emit requestPauseTask(id);
+    });
+    connect(m_btnResumeTask, &QPushButton::clicked, this, [this]() {
+        const QString id = selectedTaskId();
+        if (!id.isEmpty()) emit requestResumeTask(id);
+    });
+    connect(m_btnCancelTask, &QPushButton::clicked, this, [this]() {
+        const QString id = selectedTaskId();
+        if (!id.isEmpty()) emit requestCancelTask(id);
+    });
 }
 
-void MapManagerDialog::onTaskProgress(const QString &taskId, int completed, int total)
+// 任务项数据：UserRole 任务 id，+1 状态，+2 完成数，+3 总数
+QListWidgetItem *MapManagerDialog::taskItem(const QString &taskId)
 {
-    m_currentTaskId = taskId;
-    int percent = (total > 0) ? (completed * 100 / total) : 0;
-    m_progressBar->setValue(percent);
-    m_progressLabel->setText(tr("进度: %1% (%2/%3)").arg(percent).arg(completed).arg(total));
-
-    // 列表中更新或新增任务项
     QListWidgetItem *item = m_taskItems->value(taskId, nullptr);
     if (!item) {
         item = new QListWidgetItem(taskId, m_taskList);
+        item->setData(Qt::UserRole, taskId);
         (*m_taskItems)[taskId] = item;
     }
-    item->setText(tr("%1  %2/%3 (%4%)").arg(taskId, QString::number(completed), QString::number(total), QString::number(percent)));
+    return item;
+}
+
+void MapManagerDialog::refreshTaskItem(QListWidgetItem *item)
+{
+    const QString taskId = item->data(Qt::UserRole).toString();
+    const QString status = item->data(Qt::UserRole + 1).toString();
+    const qint64 completed = item->data(Qt::UserRole + 2).toLongLong();
+    const qint64 total = item->data(Qt::UserRole + 3).toLongLong();
+    const int percent = (total > 0) ? int(completed * 100 / total) : 0;
+    item->setText(tr("%1  %2/%3 (%4%)  %5").arg(taskId, QString::number(completed), QString::number(total),
+                                               QString::number(percent), status));
+}
+
+QString MapManagerDialog::selectedTaskId() const
+{
+    QListWidgetItem *item = m_taskList->currentItem();
+    return item ? item->data(Qt::UserRole).toString() : QString();
+}
+
+void MapManagerDialog::addTask(const QString &taskId, const QString &status, qint64 completed, qint64 total)
+{
+    QListWidgetItem *item = taskItem(taskId);
+    item->setData(Qt::UserRole + 1, status);
+    item->setData(Qt::UserRole + 2, completed);
+    item->setData(Qt::UserRole + 3, total);
+    refreshTaskItem(item);
+}
+
+void MapManagerDialog::onTaskStatusChanged(const QString &taskId, const QString &status)
+{
+    QListWidgetItem *item = taskItem(taskId);
+    item->setData(Qt::UserRole + 1, status);
+    refreshTaskItem(item);
+}
+
+int MapManagerDialog::taskPriority() const
+{
+    return m_spinPriority ? m_spinPriority->value() : 0;
+}
+
+void MapManagerDialog::onTaskProgress(const QString &taskId, qint64 completed, qint64 total)
+{
+    m_currentTaskId = taskId;
+    int percent = (total > 0) ? int(completed * 100 / total) : 0;
+    m_progressBar->setValue(percent);
+    m_progressLabel->setText(tr("进度: %1% (%2/%3)").arg(percent).arg(completed).arg(total));
+
+    // 列表中更新或新增任务项
+    QListWidgetItem *item = taskItem(taskId);
+    item->setData(Qt::UserRole + 2, completed);
+    item->setData(Qt::UserRole + 3, total);
+    refreshTaskItem(item);
 }
 
 MapManagerSettings MapManagerDialog::getSettings() const
@@ -106,6 +234,7 @@ MapManagerSettings MapManagerDialog::getSettings() const
     s.tileUrlTemplate = m_editUrl ? m_editUrl->text() : s.tileUrlTemplate;
     if (m_editServers) s.servers = m_editServers->text().split(',', Qt::SkipEmptyParts);
     if (m_editCacheDir) s.cacheDir = m_editCacheDir->text();
+    if (m_editPolygon) s.regionPolygonPath = m_editPolygon->text().trimmed();
     if (m_spinMinZoom) s.minZoom = m_spinMinZoom->value();
     if (m_spinMaxZoom) s.maxZoom = m_spinMaxZoom->value();
     if (m_spinConcurrent) s.maxConcurrent = m_spinConcurrent->value();
@@ -113,8 +242,10 @@ MapManagerSettings MapManagerDialog::getSettings() const
     if (m_spinRetry) s.retryMax = m_spinRetry->value();
     if (m_spinBackoff) s.backoffInitialMs = m_spinBackoff->value();
     if (m_spinPrefetch) s.prefetchRing = m_spinPrefetch->value();
+    if (m_spinProgressive) s.progressiveThresholdMs = m_spinProgressive->value();
     if (m_chkAsyncNetwork) s.useAsyncNetwork = m_chkAsyncNetwork->isChecked();
     if (m_chkBrowseDownload) s.browseDownload = m_chkBrowseDownload->isChecked();
+    if (m_chkSkipUniform) s.skipUniformTiles = m_chkSkipUniform->isChecked();
     return s;
 }
 
@@ -123,6 +254,7 @@ void MapManagerDialog::setSettings(const MapManagerSettings &s)
     if (m_editUrl) m_editUrl->setText(s.tileUrlTemplate);
     if (m_editServers) m_editServers->setText(s.servers.join(','));
     if (m_editCacheDir) m_editCacheDir->setText(s.cacheDir);
+    if (m_editPolygon) m_editPolygon->setText(s.regionPolygonPath);
     if (m_spinMinZoom) m_spinMinZoom->setValue(s.minZoom);
     if (m_spinMaxZoom) m_spinMaxZoom->setValue(s.maxZoom);
     if (m_spinConcurrent) m_spinConcurrent->setValue(s.maxConcurrent);
@@ -130,8 +262,36 @@ void MapManagerDialog::setSettings(const MapManagerSettings &s)
     if (m_spinRetry) m_spinRetry->setValue(s.retryMax);
     if (m_spinBackoff) m_spinBackoff->setValue(s.backoffInitialMs);
     if (m_spinPrefetch) m_spinPrefetch->setValue(s.prefetchRing);
+    if (m_spinProgressive) m_spinProgressive->setValue(s.progressiveThresholdMs);
     if (m_chkAsyncNetwork) m_chkAsyncNetwork->setChecked(s.useAsyncNetwork);
     if (m_chkBrowseDownload) m_chkBrowseDownload->setChecked(s.browseDownload);
+    if (m_chkSkipUniform) m_chkSkipUniform->setChecked(s.skipUniformTiles);
+}
+
+bool MapManagerDialog::getRegion(double &minLat, double &maxLat, double &minLon, double &maxLon) const
+{
+    bool ok1 = false, ok2 = false, ok3 = false, ok4 = false;
+    minLat = m_editMinLat->text().toDouble(&ok1);
+    maxLat = m_editMaxLat->text().toDouble(&ok2);
+    minLon = m_editMinLon->text().toDouble(&ok3);
+    maxLon = m_editMaxLon->text().toDouble(&ok4);
+    return ok1 && ok2 && ok3 && ok4 && minLat < maxLat && minLon < maxLon;
 }
 
+void MapManagerDialog::setCoverageText(const QString &text)
+{
+    if (m_coverageLabel) m_coverageLabel->setText(text);
+}
 
+void MapManagerDialog::onTaskPlanned(const QString &taskId, qint64 total, qint64 bboxTotal)
+{
+    if (!m_planLabel) return;
+    if (bboxTotal <= total) {
+        m_planLabel->setText(tr("任务 %1: 共 %2 张瓦片").arg(taskId).arg(total));
+        return;
+    }
+    const qint64 saved = bboxTotal - total;
+    m_planLabel->setText(tr("任务 %1: 多边形覆盖 %2 张，外包矩形 %3 张，节省 %4 张 (%5%)")
+                             .arg(taskId).arg(total).arg(bboxTotal).arg(saved)
+                             .arg(double(saved) * 100.0 / double(bboxTotal), 0, 'f', 1));
+}
@@ -10,6 +10,7 @@ class QSpinBox;
 class QPushButton;
 class QListWidget;
 class QCheckBox;
+class QListWidgetItem;
 template <typename K, typename V> class QHash;
 #include "mapmanagersettings.h"
 
@@ -24,9 +25,18 @@ public:
     explicit MapManagerDialog(QWidget *parent = nullptr);
 
 public slots:
-    void onTaskProgress(const QString &taskId, int completed, int total);
+    void onTaskProgress(const QString &taskId, qint64 completed, qint64 total);
     MapManagerSettings getSettings() const;
     void setSettings(const MapManagerSettings &s);
+    // 读取区域输入框；任一无效返回 false
+    bool getRegion(double &minLat, double &maxLat, double &minLon, double &maxLon) const;
+    void setCoverageText(const QString &text);
+    // 任务规划结果：多边形覆盖数与外包矩形数对比
+    void onTaskPlanned(const QString &taskId, qint64 total, qint64 bboxTotal);
+    void onTaskStatusChanged(const QString &taskId, const QString &status);
+    // 列表中登记已有任务（打开对话框时从清单填充）
+    void addTask(const QString &taskId, const QString &status, qint64 completed, qint64 total);
+    int taskPriority() const; // 新任务优先级（权重 = 优先级 + 1）
 
 signals:
     void requestSaveSettings();
@@ -36,8 +46,15 @@ signals:
     void requestPauseTask(const QString &taskId);
     void requestResumeTask(const QString &taskId);
     void requestCancelTask(const QString &taskId);
+    void requestCoverage(); // 统计当前区域各层级缓存覆盖率
+    void requestBuildPyramid(); // 由已缓存的高层级瓦片本地生成缺失的低层级
+    void requestRouteDownload(double bufferMeters); // 沿最近的测量折线下载
 
 private:
+    QListWidgetItem *taskItem(const QString &taskId);
+    void refreshTaskItem(QListWidgetItem *item);
+    QString selectedTaskId() const;
+
     QProgressBar *m_progressBar = nullptr;
     QLabel *m_progressLabel = nullptr;
     QString m_currentTaskId;
@@ -51,6 +68,8 @@ private:
     QLineEdit *m_editMaxLat = nullptr;
     QLineEdit *m_editMinLon = nullptr;
     QLineEdit *m_editMaxLon = nullptr;
+    QLineEdit *m_editPolygon = nullptr;
+    QPushButton *m_btnBrowsePolygon = nullptr;
     QSpinBox  *m_spinMinZoom = nullptr;
     QSpinBox  *m_spinMaxZoom = nullptr;
     QSpinBox  *m_spinConcurrent = nullptr;
@@ -58,11 +77,23 @@ private:
     QSpinBox  *m_spinRetry = nullptr;
     QSpinBox  *m_spinBackoff = nullptr;
     QSpinBox  *m_spinPrefetch = nullptr;
+    QSpinBox  *m_spinProgressive = nullptr;
     QCheckBox *m_chkAsyncNetwork = nullptr;
     QCheckBox *m_chkBrowseDownload = nullptr;
+    QCheckBox *m_chkSkipUniform = nullptr;
     QPushButton *m_btnSave = nullptr;
     QPushButton *m_btnStart = nullptr;
     QPushButton *m_btnPauseResume = nullptr;
+    QPushButton *m_btnCoverage = nullptr;
+    QPushButton *m_btnBuildPyramid = nullptr;
+    QLabel *m_coverageLabel = nullptr;
+    QLabel *m_planLabel = nullptr;
+    QSpinBox *m_spinBuffer = nullptr;
+    QPushButton *m_btnRoute = nullptr;
+    QSpinBox *m_spinPriority = nullptr;
+    QPushButton *m_btnPauseTask = nullptr;
+    QPushButton *m_btnResumeTask = nullptr;
+    QPushButton *m_btnCancelTask = nullptr;
     QListWidget *m_taskList = nullptr;
     QHash<QString, class QListWidgetItem*> *m_taskItems = nullptr;
 };
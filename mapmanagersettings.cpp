@@ -12,6 +12,7 @@ static QJsonObject toJson(const MapManagerSettings &s)
     QJsonArray arr; for (const auto &sv : s.servers) arr.push_back(sv);
     o["servers"] = arr;
     o["cacheDir"] = s.cacheDir;
+    o["regionPolygonPath"] = s.regionPolygonPath;
     o["minZoom"] = s.minZoom;
     o["maxZoom"] = s.maxZoom;
     o["maxConcurrent"] = s.maxConcurrent;
@@ -19,8 +20,11 @@ static QJsonObject toJson(const MapManagerSettings &s)
     o["retryMax"] = s.retryMax;
     o["backoffInitialMs"] = s.backoffInitialMs;
     o["prefetchRing"] = s.prefetchRing;
+    o["progressiveThresholdMs"] = s.progressiveThresholdMs;
     o["useAsyncNetwork"] = s.useAsyncNetwork;
     o["browseDownload"] = s.browseDownload;
+    o["skipUniformTiles"] = s.skipUniformTiles;
+    o["uniformMinZoom"] = s.uniformMinZoom;
     return o;
 }
 
@@ -33,6 +37,7 @@ static MapManagerSettings fromJson(const QJsonObject &o)
         for (auto v : o.value("servers").toArray()) s.servers << v.toString();
     }
     if (o.contains("cacheDir")) s.cacheDir = o.value("cacheDir").toString();
+    if (o.contains("regionPolygonPath")) s.regionPolygonPath = o.value("regionPolygonPath").toString();
     if (o.contains("minZoom")) s.minZoom = o.value("minZoom").toInt(s.minZoom);
     if (o.contains("maxZoom")) s.maxZoom = o.value("maxZoom").toInt(s.maxZoom);
     if (o.contains("maxConcurrent")) s.maxConcurrent = o.value("maxConcurrent").toInt(s.maxConcurrent);
@@ -40,8 +45,11 @@ static MapManagerSettings fromJson(const QJsonObject &o)
     if (o.contains("retryMax")) s.retryMax = o.value("retryMax").toInt(s.retryMax);
     if (o.contains("backoffInitialMs")) s.backoffInitialMs = o.value("backoffInitialMs").toInt(s.backoffInitialMs);
     if (o.contains("prefetchRing")) s.prefetchRing = o.value("prefetchRing").toInt(s.prefetchRing);
+    if (o.contains("progressiveThresholdMs")) s.progressiveThresholdMs = o.value("progressiveThresholdMs").toInt(s.progressiveThresholdMs);
     if (o.contains("useAsyncNetwork")) s.useAsyncNetwork = o.value("useAsyncNetwork").toBool();
     if (o.contains("browseDownload")) s.browseDownload = o.value("browseDownload").toBool();
+    if (o.contains("skipUniformTiles")) s.skipUniformTiles = o.value("skipUniformTiles").toBool();
+    if (o.contains("uniformMinZoom")) s.uniformMinZoom = o.value("uniformMinZoom").toInt(s.uniformMinZoom);
     return s;
 }
 
@@ -54,8 +62,14 @@ MapManagerSettings MapManagerSettings::load(const QString &path, bool *ok)
         if (s.cacheDir.isEmpty()) s.cacheDir = QDir::currentPath() + "/tilemap";
         return s;
     }
-    auto doc = QJsonDocument::fromJson(f.readAll());
+    const QByteArray data = f.readAll();
     f.close();
+    return fromBytes(data, ok);
+}
+
+MapManagerSettings MapManagerSettings::fromBytes(const QByteArray &data, bool *ok)
+{
+    auto doc = QJsonDocument::fromJson(data);
     if (!doc.isObject()) {
         if (ok) *ok = false;
         MapManagerSettings s;
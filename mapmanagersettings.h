@@ -3,12 +3,15 @@
 
 #include <QString>
 #include <QStringList>
+#include <QByteArray>
 
 struct MapManagerSettings {
     QString tileUrlTemplate = "https://{server}.tile.openstreetmap.org/{z}/{x}/{y}.png";
     QStringList servers = {"a", "b", "c"};
     QString cacheDir; // 例如: E:/Project/.../tilemap
 
+    QString regionPolygonPath; // 区域边界 GeoJSON（可空，空则按经纬度范围）
+
     int minZoom = 3;
     int maxZoom = 10;
 
@@ -19,11 +22,18 @@ struct MapManagerSettings {
     int backoffInitialMs = 3000; // 指数退避起始
 
     int prefetchRing = 1; // 0/1/2
+    int progressiveThresholdMs = 2000; // 视口预计下载耗时超过该值时先取低层级覆盖瓦片（0 关闭）
 
     bool useAsyncNetwork = false; // 是否使用全异步网络下载
     bool browseDownload = true;    // 边看边下：可视区域缺失瓦片自动下载
 
+    // 批量下载时识别纯色瓦片（海洋、荒漠），其子树不再下载，按纯色虚拟瓦片显示
+    bool skipUniformTiles = false;
+    int uniformMinZoom = 6; // 只信任该层级及以上的纯色瓦片（低层级纯色海域在高层级可能出现小岛）
+
     static MapManagerSettings load(const QString &path, bool *ok = nullptr);
+    // 解析 JSON 文本；不是 JSON 对象时 ok=false 并返回默认值
+    static MapManagerSettings fromBytes(const QByteArray &data, bool *ok = nullptr);
     bool save(const QString &path) const;
 };
 
@@ -1,5 +1,6 @@
 #include "maptools.h"
 #include "tilemapmanager.h"
+#include "webmercator.h"
 #include <QMouseEvent>
 #include <QKeyEvent>
 #include <QGraphicsView>
@@ -103,12 +104,10 @@ namespace MapToolUtil {
 
     void sceneToLatLon(const ToolContext &ctx, const QPointF &scenePt, int zoom, int tileSize,
                        double &lat, double &lon) {
-        int n = 1 << zoom;
-        double tileX = scenePt.x() / tileSize;
-        double tileY = scenePt.y() / tileSize;
-        lon = tileX / n * 360.0 - 180.0;
-        double latRad = qAtan(std::sinh(M_PI * (1 - 2 * tileY / n)));
-        lat = qRadiansToDegrees(latRad);
+        Q_UNUSED(ctx);
+        const QPointF ll = WebMercator::unproject(scenePt.x(), scenePt.y(), double(1 << zoom) * tileSize);
+        lon = ll.x();
+        lat = ll.y();
     }
 }
 
@@ -246,19 +245,9 @@ void MeasureBase::onViewChanged(const ToolContext &ctx) {
     for (auto *it : m_committed) delete it;
     m_committed.clear();
     for (const auto &geo : m_committedGeo) {
-        // 投影回当前缩放下的 scene 坐标（WebMercator）
-        QVector<QPointF> pts;
-        pts.reserve(geo.latLon.size());
-        int z = ctx.tileManager->getZoom();
-        int n = 1 << z;
-        for (const auto &ll : geo.latLon) {
-            double lon = ll.x();
-            double lat = ll.y();
-            double x = (lon + 180.0) / 360.0 * n * m_tileSize;
-            double latRad = qDegreesToRadians(lat);
-            double y = (1.0 - qLn(qTan(latRad/2.0 + M_PI/4.0)) / M_PI) / 2.0 * n * m_tileSize;
-            pts.push_back(QPointF(x, y));
-        }
+        // 投影回当前缩放下的 scene 坐标（WebMercator 批量）
+        const int z = ctx.tileManager->getZoom();
+        const QVector<QPointF> pts = WebMercator::projectBatch(geo.latLon, double(1 << z) * m_tileSize);
         if (pts.size() < 2) continue;
         QPainterPath pp;
         pp.moveTo(pts.first());
@@ -295,6 +284,13 @@ void MeasureBase::onViewChanged(const ToolContext &ctx) {
 // ================= MeasureDistanceTool =================
 MeasureDistanceTool::MeasureDistanceTool(QObject *parent) : MeasureBase(parent) {}
 
+QVector<QPointF> MeasureDistanceTool::lastRoute() const {
+    for (int i = m_committedGeo.size() - 1; i >= 0; --i) {
+        if (!m_committedGeo[i].closed) return m_committedGeo[i].latLon;
+    }
+    return {};
+}
+
 ToolDescriptor MeasureDistanceTool::descriptor() const {
     ToolDescriptor d; d.id = "measure_distance"; d.name = QObject::tr("距离测量");
     d.icon = QIcon(); d.cursor = QCursor(Qt::CrossCursor); d.hint = QObject::tr("左键加点, 右键撤销, 双击结束, ESC 取消");
@@ -401,17 +397,11 @@ bool MeasureAreaTool::onMouseMove(const ToolContext &ctx, QMouseEvent *e) {
     updateRubber(ctx, tmp, tmp.size()>=3);
 
     // compute area using WebMercator projection + shoelace
-    auto merc = [](double lat, double lon){
-        double x = MapToolUtil::EARTH_R * qDegreesToRadians(lon);
-        double y = MapToolUtil::EARTH_R * qLn(qTan(M_PI/4.0 + qDegreesToRadians(lat)/2.0));
-        return QPointF(x,y);
-    };
+    // 场景坐标本身就是墨卡托平面坐标，按比例换算为米即可，无需逐点反投影再投影
+    const double metersPerPixel = 2.0 * M_PI * MapToolUtil::EARTH_R
+                                  / (double(1 << ctx.tileManager->getZoom()) * m_tileSize);
     QVector<QPointF> poly;
-    for (const auto &p : tmp) {
-        double lat, lon;
-        MapToolUtil::sceneToLatLon(ctx, p, ctx.tileManager->getZoom(), m_tileSize, lat, lon);
-        poly.push_back(merc(lat, lon));
-    }
+    for (const auto &p : tmp) poly.push_back(p * metersPerPixel);
     double area = 0.0; // m^2
     for (int i=0;i<poly.size();++i) {
         const auto &a = poly[i];
@@ -151,6 +151,8 @@ public:
     bool onMouseDoubleClick(const ToolContext &ctx, QMouseEvent *e) override;
     bool onKeyPress(const ToolContext &ctx, QKeyEvent *e) override;
     void onViewChanged(const ToolContext &ctx) override { MeasureBase::onViewChanged(ctx); }
+    // 最近一条已完成的测量折线（lon,lat），无则为空
+    QVector<QPointF> lastRoute() const;
 
 private:
     QVector<QPointF> m_pointsScene;
@@ -1,6 +1,9 @@
 #include "myform.h"
 #include "ui_myform.h"
 #include "tilemapmanager.h"  // 添加瓦片地图管理器头文件
+#include "tilelayer.h"
+#include "geopolygon.h"
+#include "webmercator.h"
 #include <QDebug>
 #include <QFileDialog>
 #include <QMessageBox>
@@ -31,12 +34,17 @@
 #include <QGroupBox>
 #include <QGridLayout>
 #include <QPropertyAnimation>
+#include <QVariantAnimation>
+#include <QNativeGestureEvent>
 #include <QGraphicsOpacityEffect>
 #include <cmath>
 #include "mapmanagerdialog.h"
 #include "downloadscheduler.h"
 #include "manifeststore.h"
 #include "mapmanagersettings.h"
+#include "settingsstore.h"
+#include "asynclogger.h"
+#include "pyramidbuilder.h"
 
 MyForm::MyForm(QWidget *parent)
     : QWidget(parent)
@@ -84,6 +92,9 @@ static QIcon makePlusMinusIcon(bool isPlus, const QColor &color = QColor(255,255
 
 MyForm::~MyForm()
 {
+    // 调度器先停，再关闭清单（日志落盘）
+    delete downloadScheduler;
+    delete manifestStore;
     delete ui;
 }
 
@@ -297,30 +308,103 @@ void MyForm::setupFunctionalArea() {
         "QMenu::separator{height:1px; background:#e6e6e6; margin:6px 10px;}";
     menuBar->setStyleSheet(menuStyle);
     connect(actMapMgr, &QAction::triggered, this, [this]() {
+        if (!downloadScheduler) return;
         auto dlg = new MapManagerDialog(this);
         dlg->setAttribute(Qt::WA_DeleteOnClose, true);
-        static ManifestStore store("manifest.json");
-        store.load();
-        static MapManagerSettings settings = MapManagerSettings::load("settings.json");
-        dlg->setSettings(settings);
-        auto *sched = new DownloadScheduler(dlg);
-        sched->configure(settings);
-        sched->setManifest(&store);
-        sched->setTileManager(tileMapManager);
+        dlg->setSettings(*settingsStore->snapshot());
+        // 调度器归窗体所有，关闭对话框不影响后台任务；以下连接随对话框销毁自动断开
+        DownloadScheduler *sched = downloadScheduler;
         connect(sched, &DownloadScheduler::taskProgress, dlg, &MapManagerDialog::onTaskProgress);
+        connect(sched, &DownloadScheduler::taskPlanned, dlg, &MapManagerDialog::onTaskPlanned);
+        connect(sched, &DownloadScheduler::taskStatusChanged, dlg, &MapManagerDialog::onTaskStatusChanged);
+        connect(dlg, &MapManagerDialog::requestPauseTask, sched, &DownloadScheduler::pauseTask);
+        connect(dlg, &MapManagerDialog::requestResumeTask, sched, &DownloadScheduler::resumeTask);
+        connect(dlg, &MapManagerDialog::requestCancelTask, sched, &DownloadScheduler::cancelTask);
+        for (const DownloadTask &t : manifestStore->tasks()) dlg->addTask(t.id, t.status, t.completedTiles, t.totalTiles);
         connect(dlg, &MapManagerDialog::requestPause, sched, &DownloadScheduler::pause);
         connect(dlg, &MapManagerDialog::requestResume, sched, &DownloadScheduler::resume);
-        connect(dlg, &MapManagerDialog::requestStartDownload, this, [sched, &store, dlg]() mutable {
-            // 读取对话框设置（当前区域使用默认中国范围；后续可改为表单读取）
+        connect(dlg, &MapManagerDialog::requestStartDownload, this, [sched, dlg]() mutable {
+            // 读取对话框设置：有边界文件时按多边形，范围取其外包矩形；否则用表单经纬度（无效时默认中国）
             auto s = dlg->getSettings();
             DownloadTask t; t.minLat = 18; t.maxLat = 54; t.minLon = 73; t.maxLon = 135;
+            double minLat, maxLat, minLon, maxLon;
+            if (dlg->getRegion(minLat, maxLat, minLon, maxLon)) {
+                t.minLat = minLat; t.maxLat = maxLat; t.minLon = minLon; t.maxLon = maxLon;
+            }
+            if (!s.regionPolygonPath.isEmpty()) {
+                const QRectF b = GeoPolygon::loadGeoJson(s.regionPolygonPath).bounds();
+                if (!b.isNull()) {
+                    t.polygonPath = s.regionPolygonPath;
+                    t.minLon = b.left(); t.maxLon = b.right();
+                    t.minLat = b.top(); t.maxLat = b.bottom();
+                }
+            }
             t.minZoom = s.minZoom; t.maxZoom = s.maxZoom; t.status = "pending";
-            store.upsertTask(t); store.save();
+            t.priority = dlg->taskPriority();
+            // 经调度器登记：运行中时直接加入轮转
+            sched->enqueueTask(t);
             sched->start();
         });
-        connect(dlg, &MapManagerDialog::requestSaveSettings, this, [dlg, &settings]() mutable {
-            settings = dlg->getSettings();
-            settings.save("settings.json");
+        connect(dlg, &MapManagerDialog::requestRouteDownload, this, [this, sched, dlg](double bufferMeters) {
+            const QVector<QPointF> route = distanceTool ? distanceTool->lastRoute() : QVector<QPointF>();
+            if (route.isEmpty()) {
+                dlg->setCoverageText(tr("沿线下载: 请先用距离测量画出路线"));
+                return;
+            }
+            auto s = dlg->getSettings();
+            DownloadTask t;
+            t.route = route;
+            t.bufferMeters = bufferMeters;
+            // 经纬度范围记录路线外包矩形，仅用于展示与对比
+            t.minLon = t.maxLon = route.first().x();
+            t.minLat = t.maxLat = route.first().y();
+            for (const QPointF &p : route) {
+                t.minLon = qMin(t.minLon, p.x()); t.maxLon = qMax(t.maxLon, p.x());
+                t.minLat = qMin(t.minLat, p.y()); t.maxLat = qMax(t.maxLat, p.y());
+            }
+            t.minZoom = s.minZoom; t.maxZoom = s.maxZoom; t.status = "pending";
+            t.priority = dlg->taskPriority();
+            sched->enqueueTask(t);
+            sched->start();
+            updateStatus(tr("已添加沿线下载任务：%1 个折点，缓冲 %2 米").arg(route.size()).arg(bufferMeters));
+        });
+        connect(dlg, &MapManagerDialog::requestCoverage, this, [this, dlg]() {
+            double minLat, maxLat, minLon, maxLon;
+            if (!tileMapManager || !dlg->getRegion(minLat, maxLat, minLon, maxLon)) {
+                dlg->setCoverageText(tr("覆盖率: 区域无效"));
+                return;
+            }
+            const MapManagerSettings s = dlg->getSettings();
+            const TilePyramid &pyr = tileMapManager->pyramid();
+            QStringList parts;
+            for (int z = s.minZoom; z <= s.maxZoom; ++z) {
+                int x0, y0, x1, y1;
+                WebMercator::lonLatToTile(minLon, maxLat, z, x0, y0);
+                WebMercator::lonLatToTile(maxLon, minLat, z, x1, y1);
+                const double ratio = pyr.coverageRatio(z, x0, y0, x1, y1);
+                parts << QString("z%1 %2%").arg(z).arg(ratio * 100.0, 0, 'f', 1);
+            }
+            dlg->setCoverageText(tr("覆盖率: ") + parts.join("  "));
+        });
+        PyramidBuilder *builder = tileMapManager->pyramidBuilder();
+        connect(dlg, &MapManagerDialog::requestBuildPyramid, this, [this, dlg, builder]() {
+            // 从最深的已缓存层级向下生成到最小层级
+            if (!builder->start(dlg->getSettings().minZoom, tileMapManager->pyramid().maxLevel()))
+                dlg->setCoverageText(tr("本地生成: 正在运行"));
+        });
+        connect(builder, &PyramidBuilder::levelStarted, dlg, [dlg](int z, int tiles) {
+            dlg->setCoverageText(tr("本地生成: z%1 共 %2 张").arg(z).arg(tiles));
+        });
+        connect(builder, &PyramidBuilder::progress, dlg, [this](qint64 generated, double rate) {
+            updateStatus(tr("本地生成低层级: 已生成 %1 张, %2 张/秒").arg(generated).arg(rate, 0, 'f', 1));
+        });
+        connect(builder, &PyramidBuilder::finished, dlg, [dlg](qint64 generated, qint64 failed, qint64 ms) {
+            dlg->setCoverageText(tr("本地生成完成: %1 张, 失败 %2, 用时 %3 秒")
+                                 .arg(generated).arg(failed).arg(ms / 1000.0, 0, 'f', 1));
+        });
+        connect(dlg, &MapManagerDialog::requestSaveSettings, this, [this, dlg]() {
+            // 保存即替换快照并经 settingsChanged 下发
+            if (!settingsStore->save(dlg->getSettings())) updateStatus(tr("设置保存失败"));
         });
         dlg->show();
     });
@@ -469,10 +553,27 @@ void MyForm::setupMapArea() {
     
     // 创建瓦片地图管理器
     logMessage("Creating TileMapManager");
-    tileMapManager = new TileMapManager(this);
+    // 先读取设置，首次索引扫描直接针对配置的缓存目录
+    settingsStore = new SettingsStore("settings.json", this);
+    tileMapManager = new TileMapManager(settingsStore->hasFile() ? settingsStore->snapshot()->cacheDir : QString(), this);
     logMessage(QString("TileMapManager created: %1").arg(tileMapManager != nullptr));
     tileMapManager->initScene(mapScene);
+    setupDownloadEngine();
     ui->graphicsView->setViewportUpdateMode(QGraphicsView::SmartViewportUpdate);
+    dragFrameTimer = new QTimer(this);
+    dragFrameTimer->setSingleShot(true);
+    dragFrameTimer->setInterval(16); // 每帧最多滚动一次
+    connect(dragFrameTimer, &QTimer::timeout, this, &MyForm::applyDragFrame);
+    zoomHoldTimer = new QTimer(this);
+    zoomHoldTimer->setSingleShot(true);
+    zoomHoldTimer->setInterval(ZOOM_HOLD_MAX_MS);
+    // 预载就绪或等待超时：按当前残差重新判断是否切换层级
+    connect(zoomHoldTimer, &QTimer::timeout, this, [this]() {
+        if (zoomHoldLevel >= 0) applyZoomResidual(zoomResidual);
+    });
+    connect(tileMapManager, &TileMapManager::zoomStageReady, this, [this](int zoom) {
+        if (zoom == zoomHoldLevel) applyZoomResidual(zoomResidual);
+    });
     
     // 初始化工具管理器与事件分发
     toolManager = new ToolManager(this);
@@ -480,31 +581,16 @@ void MyForm::setupMapArea() {
         ToolContext tctx; tctx.scene = mapScene; tctx.view = ui->graphicsView; tctx.tileManager = tileMapManager;
         toolManager->setContext(tctx);
         auto tDist = new MeasureDistanceTool(toolManager);
+        distanceTool = tDist;
         auto tArea = new MeasureAreaTool(toolManager);
         toolManager->registerTool(tDist);
         toolManager->registerTool(tArea);
         connect(toolManager, &ToolManager::requestStatus, this, [this](const QString &s){ updateStatus(s); });
         connect(toolManager, &ToolManager::requestCursor, this, [this](const QCursor &c){ ui->graphicsView->viewport()->setCursor(c); });
     }
-    // 应用可配置设置（若存在 settings.json）
-    bool ok = false;
-    MapManagerSettings s = MapManagerSettings::load("settings.json", &ok);
-    if (ok) {
-        if (!s.tileUrlTemplate.isEmpty()) tileMapManager->setTileSource(s.tileUrlTemplate);
-        // 若 settings 未提供 cacheDir，则使用 TileMapManager 默认的项目根 tilemap
-        if (!s.cacheDir.isEmpty()) tileMapManager->setCacheDir(s.cacheDir);
-        tileMapManager->setMaxConcurrentRequests(qMax(1, s.maxConcurrent));
-        if (!s.servers.isEmpty()) tileMapManager->setServerList(s.servers);
-        tileMapManager->setPrefetchRing(s.prefetchRing);
-        tileMapManager->setUseAsyncNetwork(s.useAsyncNetwork);
-        // 边看边下控制：在可视区域更新逻辑中启用允许下载
-        // 如果关闭，则拖拽/缩放只加载本地瓦片
-        // 这里不需额外设置，逻辑在 TileMapManager::calculateVisibleTiles 中通过 allowDownload 参数控制
-        if (!s.browseDownload) {
-            // 若关闭边看边下，我们在滚动/缩放触发的更新中用 allowDownload=false
-            // 由事件回调里判断该设置
-        }
-    }
+    // 应用可配置设置（若存在 settings.json），之后文件变更时热重载
+    applySettings(*settingsStore->snapshot());
+    connect(settingsStore, &SettingsStore::settingsChanged, this, &MyForm::applySettings);
     
     // 创建视图更新定时器（用于拖动时延迟更新瓦片）
     viewUpdateTimer = new QTimer(this);
@@ -526,10 +612,8 @@ void MyForm::setupMapArea() {
         positionStatusOverlay();
     });
     
-    // 连接下载进度信号（在这里连接，因为tileMapManager已经创建）
-    logMessage("Connecting regionDownloadProgress signal");
-    connect(tileMapManager, &TileMapManager::regionDownloadProgress, this, &MyForm::onRegionDownloadProgress);
     connect(tileMapManager, &TileMapManager::viewportActivity, this, [this](int toDownload, int loaded, bool enabled){
+        if (backgroundMode) return;
         QString tip;
         if (enabled) {
             if (toDownload > 0) tip = tr("正在下载可视区域: 需下%1, 本地%2").arg(toDownload).arg(loaded);
@@ -540,13 +624,6 @@ void MyForm::setupMapArea() {
         }
         updateStatus(tip);
     });
-    connect(tileMapManager, &TileMapManager::downloadFinished, this, [this]() {
-        updateStatus("Tile map download completed");
-        // 隐藏进度条
-        isDownloading = false;
-        progressBar->setVisible(false);
-        progressBar->setValue(0);
-    });
     connect(tileMapManager, &TileMapManager::localTilesFound, this, [this](int zoomLevel, int tileCount) {
         updateStatus(QString("Found %1 local tiles at zoom level %2").arg(tileCount).arg(zoomLevel));
     });
@@ -598,8 +675,8 @@ void MyForm::setupMapArea() {
             // 将视图中心定位到当前地图中心对应的全图绝对坐标
             QPointF centerScene = tileMapManager->getCenterScenePos();
             ui->graphicsView->centerOn(centerScene);
-            updateStatus(QString("Ready - Current zoom level: %1/%2").arg(currentZoomLevel).arg(MAX_ZOOM_LEVEL));
-            logMessage(QString("Current zoom level: %1/%2").arg(currentZoomLevel).arg(MAX_ZOOM_LEVEL));
+            updateStatus(QString("Ready - Current zoom level: %1/%2").arg(currentZoomLevel).arg(maxZoomLevel()));
+            logMessage(QString("Current zoom level: %1/%2").arg(currentZoomLevel).arg(maxZoomLevel()));
         } else {
             updateStatus("Ready - Use 'Load Tile Map' to download new tiles");
         }
@@ -759,6 +836,11 @@ void MyForm::positionGraphicsOverlayScene()
     return;
 }
 
+int MyForm::maxZoomLevel() const
+{
+    return tileMapManager ? tileMapManager->getMaxZoom() : MAX_ZOOM_LEVEL;
+}
+
 bool MyForm::eventFilter(QObject *obj, QEvent *event)
 {
     if (obj == ui->graphicsView->viewport()) {
@@ -772,54 +854,22 @@ bool MyForm::eventFilter(QObject *obj, QEvent *event)
         } else if (event->type() == QEvent::MouseButtonDblClick) {
             if (toolManager && toolManager->handleMouseDoubleClick(static_cast<QMouseEvent*>(event))) return true;
         }
+        if (event->type() == QEvent::NativeGesture && tileMapManager) {
+            // 触控板捏合：直接跟随手势，无动画
+            QNativeGestureEvent *ge = static_cast<QNativeGestureEvent*>(event);
+            if (ge->gestureType() == Qt::ZoomNativeGesture) {
+                zoomByLevels(std::log2(1.0 + ge->value()), ge->position().toPoint(), false);
+                return true;
+            }
+        }
         if (event->type() == QEvent::Wheel) {
             QWheelEvent *wheelEvent = static_cast<QWheelEvent*>(event);
             
-            // 如果瓦片地图管理器存在，使用离散的层级缩放
+            // 如果瓦片地图管理器存在，使用连续缩放（每格一层，触控板按比例）
             if (tileMapManager) {
-                int newZoomLevel = currentZoomLevel;
-                
-                if (wheelEvent->angleDelta().y() > 0) {
-                    // 放大：增加层级
-                    newZoomLevel = qMin(currentZoomLevel + 1, MAX_ZOOM_LEVEL);
-                } else {
-                    // 缩小：减少层级
-                    newZoomLevel = qMax(currentZoomLevel - 1, MIN_ZOOM_LEVEL);
-                }
-                
-                // 如果层级发生变化，更新瓦片地图
-                if (newZoomLevel != currentZoomLevel) {
-                    // 获取鼠标在视口中的位置
-                    QPoint mouseViewportPos = wheelEvent->position().toPoint();
-                    QPointF mouseScenePos = ui->graphicsView->mapToScene(mouseViewportPos);
-                    
-                    qDebug() << "Zoom from" << currentZoomLevel << "to" << newZoomLevel 
-                             << "at viewport:" << mouseViewportPos 
-                             << "scene:" << mouseScenePos;
-                    
-                    // 更新缩放级别
-                    currentZoomLevel = newZoomLevel;
-                    
-                    // 关键：以鼠标位置为中心进行缩放
-                    // 传递鼠标在视口中的位置（像素坐标）
-                    tileMapManager->setZoomAtMousePosition(
-                        currentZoomLevel, 
-                        mouseScenePos.x(), 
-                        mouseScenePos.y(),
-                        mouseViewportPos.x(),
-                        mouseViewportPos.y(),
-                        ui->graphicsView->viewport()->width(),
-                        ui->graphicsView->viewport()->height()
-                    );
-                // 缩放后将视图中心与新中心像素对齐，保持锚点一致
-                QPointF centerScene = tileMapManager->getCenterScenePos();
-                ui->graphicsView->centerOn(centerScene);
-                // 用对齐后的真实中心触发一次立即更新，避免缩放中心与加载中心不一致
-                tileMapManager->updateTilesForViewImmediate(centerScene.x(), centerScene.y());
-                    
-                    updateStatus(QString("Tile Map Zoom Level: %1/%2").arg(currentZoomLevel).arg(MAX_ZOOM_LEVEL));
-                    // 通知工具系统视图改变，以重建叠加标记
-                    if (toolManager) toolManager->refreshForViewChange();
+                const double levels = wheelEvent->angleDelta().y() / 120.0;
+                if (levels != 0.0) {
+                    zoomByLevels(levels, wheelEvent->position().toPoint(), true);
                 }
             } else {
                 // 如果没有瓦片地图管理器，使用原来的连续缩放
@@ -848,6 +898,13 @@ bool MyForm::eventFilter(QObject *obj, QEvent *event)
                     lastRightClickScenePos = ui->graphicsView->mapToScene(lastRightClickPos);
                     isRightClickDragging = true;
                     if (tileMapManager) tileMapManager->setDragging(true);
+                    // 拖拽期间只更新最小区域：滚动由视口 blit，重绘仅限露出条带
+                    ui->graphicsView->setViewportUpdateMode(QGraphicsView::MinimalViewportUpdate);
+                    dragPendingDelta = QPoint();
+                    dragMoveEvents = 0;
+                    dragFramesApplied = 0;
+                    dragClock.start();
+                    if (tileMapManager && tileMapManager->tileLayer()) tileMapManager->tileLayer()->resetPaintStats();
                     ui->graphicsView->setCursor(Qt::ClosedHandCursor);
                     return true; // 事件已处理
                 }
@@ -856,28 +913,32 @@ bool MyForm::eventFilter(QObject *obj, QEvent *event)
             QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
             // 只有当鼠标在QGraphicsView区域时，右键拖拽才生效
             if (isRightClickDragging && (mouseEvent->buttons() & Qt::RightButton)) {
-                // 使用滚动条实现 1:1 平移，避免映射误差与轴向耦合
-                    QPointF delta = mouseEvent->pos() - lastRightClickPos;
-                QScrollBar *h = ui->graphicsView->horizontalScrollBar();
-                QScrollBar *v = ui->graphicsView->verticalScrollBar();
-                // 方向修正：拖拽左（delta<0）应显示右侧 → 滚动值增加
-                h->setValue(h->value() - (int)delta.x());
-                v->setValue(v->value() - (int)delta.y());
-                    lastRightClickPos = mouseEvent->pos();
-                lastRightClickScenePos = ui->graphicsView->mapToScene(mouseEvent->pos());
-
-                if (tileMapManager && !isDownloading) {
-                    QPointF centeredScene = ui->graphicsView->mapToScene(ui->graphicsView->viewport()->rect().center());
-                    tileMapManager->updateTilesForViewImmediate(centeredScene.x(), centeredScene.y());
-                }
-                    return true; // 事件已处理
+                // 只累计位移，由帧定时器统一滚动与加载瓦片
+                dragPendingDelta += mouseEvent->pos() - lastRightClickPos;
+                lastRightClickPos = mouseEvent->pos();
+                dragMoveEvents++;
+                if (!dragFrameTimer->isActive()) dragFrameTimer->start();
+                return true; // 事件已处理
             }
         } else if (event->type() == QEvent::MouseButtonRelease) {
             QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
             // 右键释放时禁用拖拽模式
             if (mouseEvent->button() == Qt::RightButton) {
+                // 应用最后一帧未提交的位移
+                dragFrameTimer->stop();
+                applyDragFrame();
+                lastRightClickScenePos = ui->graphicsView->mapToScene(lastRightClickPos);
                 isRightClickDragging = false;
                 ui->graphicsView->setCursor(Qt::ArrowCursor);
+                ui->graphicsView->setViewportUpdateMode(QGraphicsView::SmartViewportUpdate);
+                if (tileMapManager && tileMapManager->tileLayer()) {
+                    const TileLayerItem::PaintStats st = tileMapManager->tileLayer()->paintStats();
+                    qDebug() << "Drag frames: mouse moves" << dragMoveEvents << "applied" << dragFramesApplied
+                             << "in" << dragClock.elapsed() << "ms, paints" << st.frames
+                             << "avg(ms)" << (st.frames ? st.totalNs / 1e6 / st.frames : 0.0)
+                             << "max(ms)" << st.maxNs / 1e6
+                             << "tiles/paint" << (st.frames ? double(st.tilesDrawn) / st.frames : 0.0);
+                }
                 
                 if (tileMapManager && !isDownloading) {
                     tileMapManager->setDragging(false);
@@ -995,6 +1056,134 @@ bool MyForm::eventFilter(QObject *obj, QEvent *event)
     return QWidget::eventFilter(obj, event);
 }
 
+void MyForm::applyDragFrame()
+{
+    if (dragPendingDelta.isNull()) return;
+    // 方向修正：拖拽左（delta<0）应显示右侧 → 滚动值增加
+    QScrollBar *h = ui->graphicsView->horizontalScrollBar();
+    QScrollBar *v = ui->graphicsView->verticalScrollBar();
+    h->setValue(h->value() - dragPendingDelta.x());
+    v->setValue(v->value() - dragPendingDelta.y());
+    dragPendingDelta = QPoint();
+    dragFramesApplied++;
+
+    if (tileMapManager && !isDownloading) {
+        QPointF centeredScene = ui->graphicsView->mapToScene(ui->graphicsView->viewport()->rect().center());
+        tileMapManager->updateTilesForViewImmediate(centeredScene.x(), centeredScene.y());
+    }
+}
+
+void MyForm::zoomByLevels(double levels, const QPoint &anchorViewport, bool animated)
+{
+    if (!tileMapManager) return;
+    zoomAnchor = anchorViewport;
+    // 目标残差限制在可用层级范围内
+    const double minTarget = MIN_ZOOM_LEVEL - currentZoomLevel;
+    const double maxTarget = maxZoomLevel() - currentZoomLevel;
+    const double base = (zoomAnim && zoomAnim->state() == QAbstractAnimation::Running) ? zoomTarget : zoomResidual;
+    zoomTarget = qBound(minTarget, base + levels, maxTarget);
+
+    if (!animated) {
+        if (zoomAnim) zoomAnim->stop();
+        applyZoomResidual(zoomTarget);
+        return;
+    }
+    if (!zoomAnim) {
+        zoomAnim = new QVariantAnimation(this);
+        zoomAnim->setDuration(160);
+        zoomAnim->setEasingCurve(QEasingCurve::OutCubic);
+        connect(zoomAnim, &QVariantAnimation::valueChanged, this, [this](const QVariant &v) {
+            applyZoomResidual(v.toDouble());
+        });
+        connect(zoomAnim, &QVariantAnimation::finished, this, [this]() {
+            // 动画结束后按最终视图补齐可见瓦片
+            QPointF c = ui->graphicsView->mapToScene(ui->graphicsView->viewport()->rect().center());
+            tileMapManager->updateTilesForViewImmediate(c.x(), c.y());
+        });
+    }
+    zoomAnim->stop();
+    zoomAnim->setStartValue(zoomResidual);
+    zoomAnim->setEndValue(zoomTarget);
+    zoomAnim->start();
+}
+
+bool MyForm::zoomLevelReady(int target, double residual)
+{
+    if (zoomHoldLevel != target) {
+        QGraphicsView *view = ui->graphicsView;
+        QPointF centerScene = view->mapToScene(view->viewport()->rect().center());
+        tileMapManager->syncCenterToScene(centerScene.x(), centerScene.y());
+        tileMapManager->stageZoom(target);
+        zoomHoldLevel = target;
+        zoomHoldTimer->start();
+    }
+    // 超过一整层时旧层级已放大两倍，不再等待
+    const bool ready = qAbs(residual) >= 1.0 || !zoomHoldTimer->isActive()
+                       || tileMapManager->stagedFraction() >= tileMapManager->zoomHoldThreshold();
+    if (ready) {
+        zoomHoldLevel = -1;
+        zoomHoldTimer->stop();
+    }
+    return ready;
+}
+
+void MyForm::cancelZoomHold()
+{
+    if (zoomHoldLevel < 0) return;
+    zoomHoldLevel = -1;
+    zoomHoldTimer->stop();
+    tileMapManager->cancelStagedZoom();
+}
+
+void MyForm::applyZoomResidual(double residual)
+{
+    if (!tileMapManager || zoomApplying) return;
+    zoomApplying = true;
+    QGraphicsView *view = ui->graphicsView;
+    QPointF anchorScene = view->mapToScene(zoomAnchor);
+
+    // 残差越过半层且目标层级瓦片已预载到位时切换层级：旧层级瓦片转为占位，新层级瓦片淡入
+    int dz = 0;
+    if (residual >= 0.5 && currentZoomLevel < maxZoomLevel()) dz = 1;
+    else if (residual <= -0.5 && currentZoomLevel > MIN_ZOOM_LEVEL) dz = -1;
+    if (dz == 0) cancelZoomHold();
+    else if (!zoomLevelReady(currentZoomLevel + dz, residual)) dz = 0;
+    if (dz != 0) {
+        QPointF centerScene = view->mapToScene(view->viewport()->rect().center());
+        tileMapManager->syncCenterToScene(centerScene.x(), centerScene.y());
+        tileMapManager->setZoom(currentZoomLevel + dz);
+        const int applied = tileMapManager->getZoom() - currentZoomLevel;
+        if (applied != 0) {
+            currentZoomLevel += applied;
+            residual -= applied;
+            zoomTarget -= applied;
+            anchorScene *= std::pow(2.0, applied);
+            if (zoomAnim && zoomAnim->state() == QAbstractAnimation::Running) {
+                // 动画区间换算到新层级
+                zoomAnim->setStartValue(zoomAnim->startValue().toDouble() - applied);
+                zoomAnim->setEndValue(zoomAnim->endValue().toDouble() - applied);
+            }
+            updateStatus(QString("Tile Map Zoom Level: %1/%2").arg(currentZoomLevel).arg(maxZoomLevel()));
+            if (toolManager) toolManager->refreshForViewChange();
+        }
+    }
+    // 到达层级边界时不再继续放大/缩小
+    if (currentZoomLevel >= maxZoomLevel()) residual = qMin(residual, 0.0);
+    if (currentZoomLevel <= MIN_ZOOM_LEVEL) residual = qMax(residual, 0.0);
+    zoomResidual = residual;
+
+    // 只改变视图变换，不重建场景；再滚动使锚点保持在光标下
+    const qreal s = std::pow(2.0, residual);
+    const QGraphicsView::ViewportAnchor oldAnchor = view->transformationAnchor();
+    view->setTransformationAnchor(QGraphicsView::NoAnchor);
+    view->setTransform(QTransform::fromScale(s, s));
+    view->setTransformationAnchor(oldAnchor);
+    const QPoint drift = view->mapFromScene(anchorScene) - zoomAnchor;
+    view->horizontalScrollBar()->setValue(view->horizontalScrollBar()->value() + drift.x());
+    view->verticalScrollBar()->setValue(view->verticalScrollBar()->value() + drift.y());
+    zoomApplying = false;
+}
+
 void MyForm::updateStatus(const QString &message) {
     if (gvStatusLabel) {
         auto *eff = qobject_cast<QGraphicsOpacityEffect*>(gvStatusLabel->graphicsEffect());
@@ -1223,6 +1412,11 @@ void MyForm::handleLoadTileMapButtonClicked()
     // 设置缩放级别为最小层级（3）开始
     logMessage("Setting zoom level to MIN_ZOOM_LEVEL");
     currentZoomLevel = MIN_ZOOM_LEVEL;
+    // 清除连续缩放残差
+    if (zoomAnim) zoomAnim->stop();
+    cancelZoomHold();
+    zoomResidual = zoomTarget = 0.0;
+    ui->graphicsView->resetTransform();
     tileMapManager->setZoom(currentZoomLevel);
     
     // 触发中国区域级别3的瓦片地图下载
@@ -1236,90 +1430,64 @@ void MyForm::handleLoadTileMapButtonClicked()
 void MyForm::handleZoomInTileMapButtonClicked()
 {
     qDebug() << "Zoom In Tile Map button clicked";
-    
-    // 使用固定的10级缩放限制
-    if (currentZoomLevel < MAX_ZOOM_LEVEL) {
-        currentZoomLevel++;
-        
-        // 按钮缩放：以视口中心为缩放点
-        QRect viewportRect = ui->graphicsView->viewport()->rect();
-        QPoint viewportCenter = viewportRect.center();
-        QPointF sceneCenter = ui->graphicsView->mapToScene(viewportCenter);
-        
-        tileMapManager->setZoomAtMousePosition(
-            currentZoomLevel,
-            sceneCenter.x(),
-            sceneCenter.y(),
-            viewportCenter.x(),
-            viewportCenter.y(),
-            viewportRect.width(),
-            viewportRect.height()
-        );
-        // 与滚轮缩放保持一致：对齐视图中心并立即刷新可见瓦片
-        QPointF centerScene = tileMapManager->getCenterScenePos();
-        ui->graphicsView->centerOn(centerScene);
-        tileMapManager->updateTilesForViewImmediate(centerScene.x(), centerScene.y());
-        
-        // 更新状态显示
-        updateStatus(QString("Tile Map Zoom Level: %1/%2").arg(currentZoomLevel).arg(MAX_ZOOM_LEVEL));
-        qDebug() << "Tile map zoom in to level:" << currentZoomLevel;
-        if (toolManager) toolManager->refreshForViewChange();
-    } else {
-        updateStatus(QString("Maximum zoom level reached (%1/%2)").arg(currentZoomLevel).arg(MAX_ZOOM_LEVEL));
-        qDebug() << "Cannot zoom in further, already at max level:" << MAX_ZOOM_LEVEL;
-    }
+    if (!tileMapManager) return;
+    // 按钮缩放：以视口中心为缩放点，与滚轮共用连续缩放
+    zoomByLevels(1.0, ui->graphicsView->viewport()->rect().center(), true);
 }
 
 void MyForm::handleZoomOutTileMapButtonClicked()
 {
     qDebug() << "Zoom Out Tile Map button clicked";
-    
-    // 使用固定的10级缩放限制
-    if (currentZoomLevel > MIN_ZOOM_LEVEL) {
-        currentZoomLevel--;
-        
-        // 按钮缩放：以视口中心为缩放点
-        QRect viewportRect = ui->graphicsView->viewport()->rect();
-        QPoint viewportCenter = viewportRect.center();
-        QPointF sceneCenter = ui->graphicsView->mapToScene(viewportCenter);
-        
-        tileMapManager->setZoomAtMousePosition(
-            currentZoomLevel,
-            sceneCenter.x(),
-            sceneCenter.y(),
-            viewportCenter.x(),
-            viewportCenter.y(),
-            viewportRect.width(),
-            viewportRect.height()
-        );
-        // 与滚轮缩放保持一致：对齐视图中心并立即刷新可见瓦片
-        QPointF centerScene2 = tileMapManager->getCenterScenePos();
-        ui->graphicsView->centerOn(centerScene2);
-        tileMapManager->updateTilesForViewImmediate(centerScene2.x(), centerScene2.y());
-        
-        // 更新状态显示
-        updateStatus(QString("Tile Map Zoom Level: %1/%2").arg(currentZoomLevel).arg(MAX_ZOOM_LEVEL));
-        qDebug() << "Tile map zoom out to level:" << currentZoomLevel;
-        if (toolManager) toolManager->refreshForViewChange();
-    } else {
-        updateStatus(QString("Minimum zoom level reached (%1/%2)").arg(MIN_ZOOM_LEVEL).arg(MAX_ZOOM_LEVEL));
-        qDebug() << "Cannot zoom out further, already at min level:" << MIN_ZOOM_LEVEL;
-    }
+    if (!tileMapManager) return;
+    // 按钮缩放：以视口中心为缩放点，与滚轮共用连续缩放
+    zoomByLevels(-1.0, ui->graphicsView->viewport()->rect().center(), true);
 }
 
 void MyForm::onTileDownloadProgress(int current, int total)
 {
     if (total > 0) {
-        int progress = (current * 100) / total;
+        int progress = int((current * 100) / total);
         updateStatus(QString("Downloading tiles: %1% (%2/%3)").arg(progress).arg(current).arg(total));
     } else {
         updateStatus(QString("Downloading tiles: %1 tiles").arg(current));
     }
 }
 
-void MyForm::onRegionDownloadProgress(int current, int total, int zoom)
+void MyForm::setupDownloadEngine()
 {
-    qDebug() << "MyForm::onRegionDownloadProgress received:" << current << "/" << total << "zoom:" << zoom;
+    // 区域下载与地图管理对话框共用：同一清单、同一调度器、同一抓取器（视图缓存索引）
+    manifestStore = new ManifestStore("manifest.json");
+    manifestStore->load();
+    downloadScheduler = new DownloadScheduler;
+    downloadScheduler->configure(*settingsStore->snapshot());
+    downloadScheduler->setManifest(manifestStore);
+    downloadScheduler->setFetcher(tileMapManager->fetcher());
+    connect(downloadScheduler, &DownloadScheduler::taskProgress, this, &MyForm::onDownloadTaskProgress);
+    connect(downloadScheduler, &DownloadScheduler::taskStatusChanged, this, [this](const QString &taskId, const QString &status) {
+        if (taskId != regionTaskId) return;
+        if (status == "completed") finishRegionDownload("Tile map download completed");
+        else if (status == "cancelled") finishRegionDownload(tr("区域下载已取消"));
+        else if (status == "partial")
+            finishRegionDownload(tr("区域下载结束，%1 张瓦片失败，下次续传时重试").arg(manifestStore->getTask(taskId).failedTiles));
+    });
+    connect(downloadScheduler, &DownloadScheduler::allTasksFinished, this, [this]() {
+        // 兜底：任务状态信号已收起进度条时 regionTaskId 为空，这里不再重复
+        if (!regionTaskId.isEmpty()) finishRegionDownload("Tile map download finished");
+    });
+}
+
+void MyForm::finishRegionDownload(const QString &message)
+{
+    regionTaskId.clear();
+    updateStatus(message);
+    isDownloading = false;
+    progressBar->setVisible(false);
+    progressBar->setValue(0);
+}
+
+void MyForm::onDownloadTaskProgress(const QString &taskId, qint64 completed, qint64 total)
+{
+    if (taskId != regionTaskId) return;
     
     // 显示进度条
     if (!isDownloading) {
@@ -1328,18 +1496,12 @@ void MyForm::onRegionDownloadProgress(int current, int total, int zoom)
     }
     
     if (total > 0) {
-        int progress = (current * 100) / total;
-        qDebug() << "Download progress:" << current << "/" << total << "(" << progress << "%) at zoom level" << zoom;
-        
-        // 更新进度条
+        int progress = int((completed * 100) / total);
         progressBar->setValue(progress);
-        progressBar->setFormat(QString("Downloading zoom level %1: %2% (%3/%4)").arg(zoom).arg(progress).arg(current).arg(total));
-        
-        // 更新状态标签
-        updateStatus(QString("Downloading zoom level %1: %2% (%3/%4)").arg(zoom).arg(progress).arg(current).arg(total));
+        progressBar->setFormat(QString("Downloading region: %1% (%2/%3)").arg(progress).arg(completed).arg(total));
+        updateStatus(QString("Downloading region: %1% (%2/%3)").arg(progress).arg(completed).arg(total));
     } else {
-        qDebug() << "Download progress:" << current << "tiles at zoom level" << zoom;
-        updateStatus(QString("Downloading zoom level %1: %2 tiles").arg(zoom).arg(current));
+        updateStatus(QString("Downloading region: %1 tiles").arg(completed));
     }
 }
 
@@ -1350,45 +1512,23 @@ void MyForm::startRegionDownload()
     // 下载中国区域的地图瓦片
     // 中国大致范围：纬度18°N-54°N，经度73°E-135°E
     // 下载缩放级别：1-10级，提供良好的缩放体验
-    logMessage("Calling tileMapManager->downloadRegion for China region");
+    logMessage("Enqueueing China region task to the download scheduler");
     logMessage("Parameters: minLat=18.0, maxLat=54.0, minLon=73.0, maxLon=135.0, minZoom=3, maxZoom=10");
 
-    // —— 预估瓦片数量并进行阈值保护 ——
+    // —— 预估瓦片数量，规模较大时提示确认 ——
+    // 下载按游标逐批取瓦片，不再设硬上限
     const double minLat = 18.0, maxLat = 54.0, minLon = 73.0, maxLon = 135.0;
     const int minZoom = 3, maxZoom = 10;
-    const int SOFT_LIMIT = 50000;   // 超过提示确认
-    const int HARD_LIMIT = 200000;  // 超过直接禁止
-
-    auto clamp = [](int v, int lo, int hi){ return qMax(lo, qMin(hi, v)); };
-    auto latToY = [](double lat, int n){
-        const double PI = 3.14159265358979323846;
-        double r = lat * PI / 180.0;
-        return (int)((1.0 - log(tan(r) + 1.0 / cos(r)) / PI) / 2.0 * n);
-    };
+    const qint64 SOFT_LIMIT = 50000;   // 超过提示确认
 
-    qint64 estimatedTiles = 0;
-    for (int z = minZoom; z <= maxZoom; ++z) {
-        int n = 1 << z;
-        int minX = (int)((minLon + 180.0) / 360.0 * n);
-        int maxX = (int)((maxLon + 180.0) / 360.0 * n);
-        int minY = latToY(maxLat, n); // 注意：Y 向下
-        int maxY = latToY(minLat, n);
-        minX = clamp(minX, 0, n - 1);
-        maxX = clamp(maxX, 0, n - 1);
-        minY = clamp(minY, 0, n - 1);
-        maxY = clamp(maxY, 0, n - 1);
-        if (maxX < minX || maxY < minY) continue;
-        estimatedTiles += (qint64)(maxX - minX + 1) * (qint64)(maxY - minY + 1);
-        if (estimatedTiles > (qint64)HARD_LIMIT * 2) break; // 提前中断估算
-    }
+    // 设置了边界文件时按多边形精确覆盖，避开海域与邻国；范围与地图管理中的任务同样由调度器计算
+    DownloadTask t;
+    t.minLat = minLat; t.maxLat = maxLat; t.minLon = minLon; t.maxLon = maxLon;
+    t.minZoom = minZoom; t.maxZoom = maxZoom; t.status = "pending";
+    t.polygonPath = settingsStore->snapshot()->regionPolygonPath;
+    qint64 bboxTiles = 0;
+    const qint64 estimatedTiles = DownloadScheduler::rangeForTask(t, &bboxTiles).total();
 
-    if (estimatedTiles > HARD_LIMIT) {
-        QMessageBox::critical(this, tr("任务过大"),
-            tr("预计将下载约 %1 张瓦片，超过上限 %2。已阻止此次下载。\n\n请缩小范围或降低层级再试。")
-                .arg(estimatedTiles).arg(HARD_LIMIT));
-        updateStatus(tr("下载任务被阻止：规模超限"));
-        return;
-    }
     if (estimatedTiles > SOFT_LIMIT) {
         auto ret = QMessageBox::question(this, tr("确认大规模下载"),
             tr("预计将下载约 %1 张瓦片，可能耗时较长并占用较多存储。是否继续？")
@@ -1400,16 +1540,72 @@ void MyForm::startRegionDownload()
         }
     }
 
-    tileMapManager->downloadRegion(minLat, maxLat, minLon, maxLon, minZoom, maxZoom);
+    // 经调度器登记，进度与清单续传和地图管理中的任务一致；
+    // 清单里已有同一区域的任务（含上次运行留下的）时续传该任务，不新建重复任务
+    const QString existing = downloadScheduler->findTask(t);
+    if (existing.isEmpty()) {
+        regionTaskId = downloadScheduler->enqueueTask(t);
+    } else {
+        regionTaskId = existing;
+        const DownloadTask cur = manifestStore->getTask(existing);
+        logMessage(QString("Resuming existing region task %1 (%2/%3, %4)")
+                   .arg(existing).arg(cur.completedTiles).arg(cur.totalTiles).arg(cur.status));
+        if (cur.status == "completed") {
+            finishRegionDownload(tr("该区域已下载完成"));
+            return;
+        }
+        if (cur.status == "paused" || cur.status == "partial") downloadScheduler->resumeTask(existing);
+    }
+    downloadScheduler->start();
     
+    if (estimatedTiles < bboxTiles) {
+        updateStatus(tr("开始按边界下载：%1 张瓦片，较外包矩形节省 %2 张").arg(estimatedTiles).arg(bboxTiles - estimatedTiles));
+        logMessage("China region map download initiated (polygon) - Levels 3-10");
+        return;
+    }
     updateStatus("Starting China region map download (levels 3-10)...");
     logMessage("China region map download initiated - Levels 3-10");
 }
 
+void MyForm::applySettings(const MapManagerSettings &s)
+{
+    // 没有 settings.json 时瓦片管理器保持自身默认值（缓存目录在项目根 tilemap）
+    if (tileMapManager && settingsStore->hasFile()) {
+        if (!s.tileUrlTemplate.isEmpty()) tileMapManager->setTileSource(s.tileUrlTemplate);
+        if (!s.cacheDir.isEmpty() && s.cacheDir != tileMapManager->getCacheDir()) tileMapManager->setCacheDir(s.cacheDir);
+        tileMapManager->setMaxConcurrentRequests(qMax(1, s.maxConcurrent));
+        if (!s.servers.isEmpty()) tileMapManager->setServerList(s.servers);
+        tileMapManager->setPrefetchRing(s.prefetchRing);
+        tileMapManager->setProgressiveThresholdMs(s.progressiveThresholdMs);
+        tileMapManager->setSkipUniformTiles(s.skipUniformTiles);
+        // 异步网络模式只在工作线程启动时生效
+        tileMapManager->setUseAsyncNetwork(s.useAsyncNetwork);
+        tileMapManager->setRetryPolicy(s.retryMax, s.backoffInitialMs);
+        // 边看边下（browseDownload）由视图更新时读取快照决定
+    }
+    if (downloadScheduler) downloadScheduler->configure(s);
+}
+
+void MyForm::setBackgroundMode(bool background)
+{
+    if (background == backgroundMode) return;
+    backgroundMode = background;
+    logMessage(QString("Background mode %1").arg(background ? "on" : "off"));
+    if (background) {
+        if (viewUpdateTimer) viewUpdateTimer->stop();
+        if (dragFrameTimer) dragFrameTimer->stop();
+        if (gvStatusDelayTimer) gvStatusDelayTimer->stop();
+        if (gvStatusFadeAnim) gvStatusFadeAnim->stop();
+    }
+    if (downloadScheduler) downloadScheduler->setBackgroundMode(background);
+    // 还原：已在图层中的瓦片保留，由管理器补算后台期间跳过或丢弃的部分
+    if (tileMapManager) tileMapManager->setBackgroundMode(background);
+}
+
 void MyForm::updateVisibleTiles()
 {
-    if (!tileMapManager || !ui->graphicsView || isDownloading) {
-        qDebug() << "updateVisibleTiles: Skipping update - tileMapManager:" << (tileMapManager != nullptr) 
+    if (!tileMapManager || !ui->graphicsView || isDownloading || backgroundMode) {
+        TILE_DEBUG() << "updateVisibleTiles: Skipping update - tileMapManager:" << (tileMapManager != nullptr) 
                  << "graphicsView:" << (ui->graphicsView != nullptr) 
                  << "isDownloading:" << isDownloading;
         return;
@@ -1420,13 +1616,12 @@ void MyForm::updateVisibleTiles()
         ui->graphicsView->viewport()->rect().center()
     );
     
-    qDebug() << "updateVisibleTiles: View center in scene:" << viewCenter;
+    TILE_DEBUG() << "updateVisibleTiles: View center in scene:" << viewCenter;
     
     // 通知瓦片地图管理器根据新的视图中心加载瓦片
     // 根据设置决定是否边看边下
-    bool ok = false; auto s = MapManagerSettings::load("settings.json", &ok);
-    // 若未找到 settings.json，仍然使用默认：边看边下开启，缓存目录在项目根 tilemap
-    if (ok && !s.browseDownload) {
+    // 内存快照，不读盘；未找到 settings.json 时为默认值：边看边下开启
+    if (!settingsStore->snapshot()->browseDownload) {
         // 仅加载本地（不触发下载）
         // 通过立即计算但禁止下载来刷新本地可视瓦片
         tileMapManager->calculateVisibleTiles(false);
@@ -1443,13 +1638,8 @@ void MyForm::updateVisibleTiles()
 
 void MyForm::logMessage(const QString &message)
 {
-    // 记录日志到文件
-    QFile logFile("debug.log");
-    if (logFile.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
-        QTextStream out(&logFile);
-        out << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz") << " - " << message << "\n";
-        logFile.close();
-    }
+    // 记录日志到文件（异步写入，不在界面线程打开文件）
+    AsyncLogger::log(QStringLiteral("debug.log"), message);
     
     // 同时输出到控制台
     qDebug() << message;
@@ -16,11 +16,17 @@
 #include <QScrollBar>
 #include <QToolButton>
 #include <QGraphicsProxyWidget>
+#include <QElapsedTimer>
 #include "maptools.h"
+#include "mapmanagersettings.h"
 
 // 添加TileMapManager的前置声明
 class TileMapManager;
+class ManifestStore;
+class DownloadScheduler;
+class SettingsStore;
 class QPropertyAnimation;
+class QVariantAnimation;
 
 namespace Ui {
 class MyForm;
@@ -62,7 +68,7 @@ private slots:
     
     // 瓦片下载进度槽函数
     void onTileDownloadProgress(int current, int total);
-    void onRegionDownloadProgress(int current, int total, int zoom); // 区域下载进度槽函数
+    void onDownloadTaskProgress(const QString &taskId, qint64 completed, qint64 total); // 区域下载进度槽函数
 
     // Overlay 相关槽
     void onOverlayPanToggled(bool checked);
@@ -82,10 +88,32 @@ private:
     bool isRightClickDragging;
     QPoint lastRightClickPos;
     QPointF lastRightClickScenePos;
+    // 拖拽按帧合并：累计鼠标位移，每帧滚动一次（视口 blit 平移，只重绘露出条带）
+    QTimer *dragFrameTimer = nullptr;
+    QPoint dragPendingDelta;
+    int dragMoveEvents = 0;
+    int dragFramesApplied = 0;
+    QElapsedTimer dragClock;
+    void applyDragFrame();
+    
+    // 连续缩放：在当前层级上叠加的视图缩放残差（log2，范围约 ±0.5）
+    double zoomResidual = 0.0;
+    double zoomTarget = 0.0;
+    QPoint zoomAnchor;                 // 缩放锚点（视口坐标）
+    QVariantAnimation *zoomAnim = nullptr;
+    bool zoomApplying = false;
+    // 层级切换前保持旧层级（按变换缩放），等目标层级可见瓦片预载到阈值比例或超时再切换
+    QTimer *zoomHoldTimer = nullptr;
+    int zoomHoldLevel = -1;
+    static constexpr int ZOOM_HOLD_MAX_MS = 300;
+    bool zoomLevelReady(int target, double residual);
+    void cancelZoomHold();
     
     // 缩放限制
     static constexpr int MIN_ZOOM_LEVEL = 3;   // 最小缩放层级（限制为3-10）
     static constexpr int MAX_ZOOM_LEVEL = 10;  // 最大缩放层级
+    // 含超采样放大的上限（由瓦片管理器按缓存层级给出）
+    int maxZoomLevel() const;
     
     // 瓦片地图管理器
     TileMapManager *tileMapManager;
@@ -93,6 +121,15 @@ private:
     // 进度条相关
     QProgressBar *progressBar;
     bool isDownloading;
+
+    // 批量下载：区域下载与地图管理对话框共用同一清单与调度器
+    ManifestStore *manifestStore = nullptr;
+    DownloadScheduler *downloadScheduler = nullptr;
+    SettingsStore *settingsStore = nullptr; // settings.json 的内存快照，文件变更时热重载
+    void applySettings(const MapManagerSettings &s); // 下发到瓦片管理器/工作线程/调度器的唯一路径
+    QString regionTaskId; // “加载瓦片地图”发起的任务，其进度驱动进度条
+    void setupDownloadEngine();
+    void finishRegionDownload(const QString &message);
     
     // 拖动更新相关
     QTimer *viewUpdateTimer;  // 延迟更新定时器
@@ -122,15 +159,19 @@ private:
 
     // 工具系统
     ToolManager *toolManager = nullptr;
+    MeasureDistanceTool *distanceTool = nullptr; // 沿线下载取其测量折线
 
     // 图形视图左下角状态覆盖
     QLabel *gvStatusLabel = nullptr;
     QTimer *gvStatusDelayTimer = nullptr;
     QPropertyAnimation *gvStatusFadeAnim = nullptr;
+    bool backgroundMode = false;
     
     // 日志记录函数
     void logMessage(const QString &message);
     void updateVisibleTiles();  // 更新可见瓦片
+    void zoomByLevels(double levels, const QPoint &anchorViewport, bool animated); // 连续缩放入口
+    void applyZoomResidual(double residual);
     
     void setupFunctionalArea();
     void setupMapArea();
@@ -146,6 +187,8 @@ private:
     // 添加公共方法来触发区域下载
 public:
     void startRegionDownload(); // 公共方法来触发区域下载
+    // 窗口最小化时进入后台模式：停掉界面定时器与瓦片插入/解码，批量下载提高并发；还原时增量刷新
+    void setBackgroundMode(bool background);
 };
 
 #endif // MYFORM_H
\ No newline at end of file
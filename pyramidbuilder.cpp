@@ -0,0 +1,147 @@
+#include "pyramidbuilder.h"
+#include <QtConcurrent>
+#include <QSaveFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PYRAMIDBUILDER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static const int kTileSize = 256;
+
+void PyramidBuilder::downsample2x(const QImage &src, QImage &dst, int dx, int dy)
+{
+    const int w = src.width() / 2;
+    const int h = src.height() / 2;
+    for (int y = 0; y < h; ++y) {
+        const quint32 *r0 = reinterpret_cast<const quint32 *>(src.constScanLine(2 * y));
+        const quint32 *r1 = reinterpret_cast<const quint32 *>(src.constScanLine(2 * y + 1));
+        quint32 *out = reinterpret_cast<quint32 *>(dst.scanLine(dy + y)) + dx;
+        int x = 0;
+#ifdef PYRAMIDBUILDER_SSE2
+        // 每次 4 个源像素（两行）-> 2 个目标像素：按通道扩成 16 位，上下相加后左右相加，(s + 2) >> 2
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for (; x + 2 <= w; x += 2) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r0 + 2 * x));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(r1 + 2 * x));
+            const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)); // 源像素 0、1
+            const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)); // 源像素 2、3
+            const __m128i sumLo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            const __m128i sumHi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+            const __m128i avg = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(sumLo, sumHi), two), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + x), _mm_packus_epi16(avg, zero));
+        }
+#endif
+        for (; x < w; ++x) {
+            const quint32 p[4] = {r0[2 * x], r0[2 * x + 1], r1[2 * x], r1[2 * x + 1]};
+            quint32 v = 0;
+            for (int shift = 0; shift < 32; shift += 8) {
+                const quint32 s = ((p[0] >> shift) & 0xFF) + ((p[1] >> shift) & 0xFF)
+                                + ((p[2] >> shift) & 0xFF) + ((p[3] >> shift) & 0xFF);
+                v |= ((s + 2) >> 2) << shift;
+            }
+            out[x] = v;
+        }
+    }
+}
+
+QImage PyramidBuilder::buildParent(const QString &cacheDir, const TileId &parent)
+{
+    // 预乘格式下直接平均各通道，半透明边缘不会发黑
+    QImage dst(kTileSize, kTileSize, QImage::Format_ARGB32_Premultiplied);
+    for (int i = 0; i < 4; ++i) {
+        const TileId child(parent.x() * 2 + (i & 1), parent.y() * 2 + (i >> 1), parent.z() + 1);
+        QImage img(cacheDir + QLatin1Char('/') + child.relativePath());
+        if (img.isNull()) return QImage();
+        if (img.width() != kTileSize || img.height() != kTileSize)
+            img = img.scaled(kTileSize, kTileSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        img = img.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        downsample2x(img, dst, (i & 1) * kTileSize / 2, (i >> 1) * kTileSize / 2);
+    }
+    return dst;
+}
+
+PyramidBuilder::PyramidBuilder(TilePyramid *pyramid, QObject *parent)
+    : QObject(parent)
+    , m_pyramid(pyramid)
+{
+    connect(&m_watcher, &QFutureWatcher<void>::finished, this, &PyramidBuilder::onLevelFinished);
+    connect(&m_watcher, &QFutureWatcher<void>::progressValueChanged, this, [this](int done) {
+        emit progress(m_generated + done, rate(m_generated + done));
+    });
+}
+
+bool PyramidBuilder::start(int minZoom, int maxZoom)
+{
+    if (isRunning() || !m_pyramid || m_cacheDir.isEmpty()) return false;
+    m_minZoom = qMax(0, minZoom);
+    m_level = qMin(maxZoom, TilePyramid::kMaxLevel) - 1;
+    m_generated = 0;
+    m_failed = 0;
+    m_cancel = false;
+    m_clock.start();
+    runLevel();
+    return true;
+}
+
+void PyramidBuilder::runLevel()
+{
+    for (; m_level >= m_minZoom && !m_cancel; --m_level) {
+        m_jobs.clear();
+        for (const TileId &id : m_pyramid->completeParents(m_level)) {
+            Job j;
+            j.id = id;
+            m_jobs.append(j);
+        }
+        if (m_jobs.isEmpty()) continue;
+        emit levelStarted(m_level, m_jobs.size());
+        const QString cacheDir = m_cacheDir;
+        std::atomic<bool> *cancel = &m_cancel;
+        m_watcher.setFuture(QtConcurrent::map(m_jobs, [cacheDir, cancel](Job &j) {
+            if (*cancel) return;
+            const QImage img = buildParent(cacheDir, j.id);
+            if (img.isNull()) return;
+            const QString path = cacheDir + QLatin1Char('/') + j.id.relativePath();
+            QDir().mkpath(QFileInfo(path).path());
+            QSaveFile f(path);
+            if (!f.open(QIODevice::WriteOnly)) return;
+            j.ok = img.convertToFormat(QImage::Format_ARGB32).save(&f, "PNG") && f.commit();
+        }));
+        return;
+    }
+    finish();
+}
+
+void PyramidBuilder::onLevelFinished()
+{
+    // 覆盖索引只在本线程更新；新瓦片使上一层的父节点可能变得完整
+    for (const Job &j : m_jobs) {
+        if (j.ok) {
+            m_pyramid->insert(j.id);
+            ++m_generated;
+        } else if (!m_cancel) {
+            ++m_failed;
+        }
+    }
+    qDebug() << "PyramidBuilder: z" << m_level << "done," << m_generated << "generated," << m_failed << "failed";
+    emit progress(m_generated, rate(m_generated));
+    m_jobs.clear();
+    --m_level;
+    runLevel();
+}
+
+void PyramidBuilder::finish()
+{
+    m_level = -1;
+    emit finished(m_generated, m_failed, m_clock.elapsed());
+}
+
+double PyramidBuilder::rate(qint64 generated) const
+{
+    const qint64 ms = m_clock.elapsed();
+    return ms > 0 ? double(generated) * 1000.0 / double(ms) : 0.0;
+}
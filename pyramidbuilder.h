@@ -0,0 +1,62 @@
+#ifndef PYRAMIDBUILDER_H
+#define PYRAMIDBUILDER_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QImage>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <atomic>
+#include "tileid.h"
+#include "tilepyramid.h"
+
+// 本地生成低层级瓦片：z 层缺失、且四个子瓦片都已缓存的节点，由子瓦片 2x2 盒式下采样（SSE2）得到，
+// 写入普通缓存并更新覆盖索引。自高层向低层逐层推进（本层生成的瓦片让上一层的父节点变得完整），
+// 每层用 QtConcurrent::map 在全局线程池上并行解码/滤波/编码。
+class PyramidBuilder : public QObject
+{
+    Q_OBJECT
+public:
+    // pyramid 由调用方持有，只在本对象所在线程更新
+    explicit PyramidBuilder(TilePyramid *pyramid, QObject *parent = nullptr);
+
+    void setCacheDir(const QString &dir) { m_cacheDir = dir; }
+    // 生成 [minZoom, maxZoom - 1] 层（maxZoom 为最高的已缓存子层级）；运行中返回 false
+    bool start(int minZoom, int maxZoom);
+    void cancel() { m_cancel = true; }
+    bool isRunning() const { return m_watcher.isRunning() || m_level >= 0; }
+
+    // 由四个子瓦片合成 parent；任一子瓦片读取失败返回空图
+    static QImage buildParent(const QString &cacheDir, const TileId &parent);
+    // 2x2 盒式滤波：src 为预乘 ARGB32，结果写入 dst 的 (dx, dy) 起 src 一半大小的区域
+    static void downsample2x(const QImage &src, QImage &dst, int dx, int dy);
+
+signals:
+    void levelStarted(int z, int tiles);
+    void progress(qint64 generated, double tilesPerSec);
+    void finished(qint64 generated, qint64 failed, qint64 elapsedMs);
+
+private:
+    struct Job {
+        TileId id;
+        bool ok = false;
+    };
+    void runLevel();       // 收集 m_level 层的待生成节点并启动并行任务；无可生成时继续下一层
+    void onLevelFinished();
+    void finish();
+    double rate(qint64 generated) const;
+
+    TilePyramid *m_pyramid;
+    QString m_cacheDir;
+    int m_minZoom = 0;
+    int m_level = -1; // 当前层级，-1 表示空闲
+    QVector<Job> m_jobs;
+    QFutureWatcher<void> m_watcher;
+    QElapsedTimer m_clock;
+    qint64 m_generated = 0;
+    qint64 m_failed = 0;
+    std::atomic<bool> m_cancel{false};
+};
+
+#endif // PYRAMIDBUILDER_H
@@ -0,0 +1,419 @@
+// seeder/main.cpp：命令行批量预下载
+// 读取清单（可附加一个多边形/矩形任务），按设置中的并发与速率运行同一套调度器，定期打印吞吐与剩余时间。
+// 进度写入清单日志，中断后再次运行从完成位图继续。
+// --spawn N：按序号把各任务切成固定大小的分片，启动 N 个 --worker 子进程抢占分片（锁文件协调），
+// 本进程定期把各分片清单的完成位图合并回主清单并汇总进度。
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTimer>
+#include <QHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QProcess>
+#include <QTextStream>
+#include <QDebug>
+#include "downloadscheduler.h"
+#include "manifeststore.h"
+#include "mapmanagersettings.h"
+#include "tilefetcher.h"
+#include "pyramidbuilder.h"
+#include "tilepyramid.h"
+#include "geopolygon.h"
+
+static QTextStream &out()
+{
+    static QTextStream s(stdout);
+    return s;
+}
+
+static QString formatDuration(qint64 secs)
+{
+    if (secs < 0) return QStringLiteral("--:--:--");
+    return QString("%1:%2:%3").arg(secs / 3600, 2, 10, QLatin1Char('0'))
+                              .arg(secs / 60 % 60, 2, 10, QLatin1Char('0'))
+                              .arg(secs % 60, 2, 10, QLatin1Char('0'));
+}
+
+// 进度行：吞吐为指数滑动平均；mb < 0 时不显示流量
+static QString progressLine(qint64 ms, qint64 done, qint64 total, double rate, double mb)
+{
+    const qint64 eta = rate > 0.0 ? qint64(double(total - done) / rate) : -1;
+    QString line = QString("[%1] %2/%3 tiles (%4%)  %5 tiles/s")
+                       .arg(formatDuration(ms / 1000)).arg(done).arg(total)
+                       .arg(total > 0 ? double(done) * 100.0 / double(total) : 0.0, 0, 'f', 1)
+                       .arg(rate, 0, 'f', 1);
+    if (mb >= 0.0) line += QString("  %1 MB").arg(mb, 0, 'f', 1);
+    return line + QString("  ETA %1").arg(formatDuration(eta));
+}
+
+static bool isActiveTask(const DownloadTask &t)
+{
+    return t.status != "completed" && t.status != "paused" && t.status != "cancelled";
+}
+
+// 分片按序号切分，大小为位图块（65536）的整数倍，合并时整块对齐
+static const qint64 kShardSize = qint64(1) << 18;
+
+static QString shardDir(const QString &manifestPath, const QString &taskId)
+{
+    return manifestPath + ".shards/" + taskId;
+}
+
+// 分片 k 的文件前缀：.lock 占用锁、.json(+.journal) 分片清单、.done 本轮已走完
+static QString shardBase(const QString &manifestPath, const QString &taskId, qint64 k)
+{
+    return shardDir(manifestPath, taskId) + QString("/shard-%1").arg(k);
+}
+
+// 在分片自己的清单上跑一遍调度器：任务副本只遍历窗口内序号，只继承主清单位图中窗口内的部分
+static void runShard(const DownloadTask &task, const TileRange &range, qint64 k,
+                     const QString &base, const MapManagerSettings &settings, TileFetcher *fetcher)
+{
+    const qint64 begin = k * kShardSize;
+    const qint64 end = qMin(range.total(), (k + 1) * kShardSize);
+    const TileBitmap done = task.doneBits.slice(begin, end);
+    const TileBitmap failed = task.failedBits.slice(begin, end);
+    ManifestStore shard(base + ".json");
+    shard.load(); // 上次中断的分片从自己的位图继续
+    if (shard.getTask(task.id).id.isEmpty()) {
+        DownloadTask copy = task;
+        copy.doneBits = done;
+        copy.failedBits = failed;
+        copy.completedTiles = done.count();
+        copy.failedTiles = failed.count();
+        shard.upsertTask(copy);
+    } else {
+        shard.mergeBits(task.id, done, failed);
+    }
+    DownloadTask st = shard.getTask(task.id);
+    st.shardBegin = begin;
+    st.shardEnd = end;
+    st.status = "pending";
+    shard.upsertTask(st);
+    shard.save();
+
+    DownloadScheduler sched;
+    sched.configure(settings);
+    sched.setManifest(&shard);
+    sched.setFetcher(fetcher);
+    sched.setTaskRange(task.id, range);
+    QEventLoop loop;
+    QObject::connect(&sched, &DownloadScheduler::allTasksFinished, &loop, &QEventLoop::quit);
+    sched.start();
+    loop.exec();
+    shard.save();
+
+    const DownloadTask done = shard.getTask(task.id);
+    out() << "Shard " << k << " of task " << task.id << " finished: "
+          << done.doneBits.countRange(st.shardBegin, st.shardEnd) << "/" << (st.shardEnd - st.shardBegin)
+          << " tiles" << Qt::endl;
+    QFile marker(base + ".done");
+    if (marker.open(QIODevice::WriteOnly)) marker.close();
+}
+
+// 工作进程：主清单只读；依次抢占未完成分片，全部被占用时等待后重扫（持有者崩溃后锁可被回收）
+static int runWorker(const ManifestStore &store, const MapManagerSettings &settings, TileFetcher *fetcher)
+{
+    for (const DownloadTask &t : store.tasks()) {
+        if (!isActiveTask(t)) continue;
+        const TileRange range = DownloadScheduler::rangeForTask(t);
+        const qint64 total = range.total();
+        const qint64 shards = (total + kShardSize - 1) / kShardSize;
+        QDir().mkpath(shardDir(store.path(), t.id));
+        for (;;) {
+            bool busy = false;
+            for (qint64 k = 0; k < shards; ++k) {
+                const QString base = shardBase(store.path(), t.id, k);
+                const qint64 begin = k * kShardSize;
+                const qint64 end = qMin(total, begin + kShardSize);
+                if (QFile::exists(base + ".done") || t.doneBits.countRange(begin, end) == end - begin) continue;
+                QLockFile lock(base + ".lock");
+                lock.setStaleLockTime(0); // 不按时长判定过期，只回收持有进程已退出的锁
+                if (!lock.tryLock(0)) {
+                    busy = true;
+                    continue;
+                }
+                if (!QFile::exists(base + ".done")) runShard(t, range, k, base, settings, fetcher);
+                lock.unlock();
+            }
+            if (!busy) break;
+            QEventLoop wait;
+            QTimer::singleShot(5000, &wait, &QEventLoop::quit);
+            wait.exec();
+        }
+    }
+    return 0;
+}
+
+// 把各分片清单的位图并入主清单（分片清单只读打开，写入方仍在运行）。
+// 只合并分片窗口内的位；快照与日志自上次合并后都未变化的分片跳过
+static void mergeShards(ManifestStore &store)
+{
+    static QHash<QString, QPair<QDateTime, qint64>> merged; // 分片清单 -> (最后修改时刻, 日志大小)
+    bool changed = false;
+    for (const DownloadTask &t : store.tasks()) {
+        if (!isActiveTask(t)) continue;
+        QDir dir(shardDir(store.path(), t.id));
+        for (const QString &name : dir.entryList(QStringList() << "shard-*.json", QDir::Files)) {
+            const QString path = dir.filePath(name);
+            const QFileInfo snap(path), journal(path + ".journal");
+            const QPair<QDateTime, qint64> stamp(qMax(snap.lastModified(), journal.lastModified()), journal.size());
+            if (merged.value(path) == stamp) continue;
+            ManifestStore shard(path, true);
+            if (!shard.load()) continue;
+            const DownloadTask st = shard.getTask(t.id);
+            if (st.id.isEmpty()) continue;
+            const qint64 end = st.shardEnd >= 0 ? st.shardEnd : st.totalTiles;
+            store.mergeBits(t.id, st.doneBits.slice(st.shardBegin, end), st.failedBits.slice(st.shardBegin, end));
+            merged.insert(path, stamp);
+            changed = true;
+        }
+    }
+    if (changed) store.save();
+}
+
+static int runCoordinator(QCoreApplication &app, ManifestStore &store, int workers,
+                          const QStringList &workerArgs, int reportSecs)
+{
+    // 先算好各任务总数并清掉上一轮的 .done 标记，失败瓦片在本轮重试
+    for (const DownloadTask &t : store.tasks()) {
+        if (!isActiveTask(t)) continue;
+        store.setTotalTiles(t.id, DownloadScheduler::rangeForTask(t).total());
+        store.setStatus(t.id, "downloading");
+        QDir dir(shardDir(store.path(), t.id));
+        for (const QString &name : dir.entryList(QStringList() << "shard-*.done", QDir::Files)) dir.remove(name);
+    }
+    store.save();
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 lastDone = -1;
+    qint64 lastMs = 0;
+    double rate = 0.0;
+    auto report = [&]() {
+        mergeShards(store);
+        qint64 done = 0, total = 0;
+        for (const DownloadTask &t : store.tasks()) {
+            if (!isActiveTask(t)) continue;
+            done += t.completedTiles;
+            total += t.totalTiles;
+        }
+        const qint64 ms = clock.elapsed();
+        if (lastDone >= 0 && ms > lastMs) {
+            const double inst = double(done - lastDone) * 1000.0 / double(ms - lastMs);
+            rate = rate > 0.0 ? 0.3 * inst + 0.7 * rate : inst;
+        }
+        lastDone = done;
+        lastMs = ms;
+        out() << progressLine(ms, done, total, rate, -1.0) << Qt::endl;
+    };
+    QTimer reportTimer;
+    reportTimer.setInterval(reportSecs * 1000);
+    QObject::connect(&reportTimer, &QTimer::timeout, &app, report);
+
+    int running = workers;
+    int exitCode = 0;
+    for (int i = 0; i < workers; ++i) {
+        QProcess *p = new QProcess(&app);
+        p->setProcessChannelMode(QProcess::MergedChannels);
+        QObject::connect(p, &QProcess::readyReadStandardOutput, &app, [p, i]() {
+            while (p->canReadLine())
+                out() << QString("[w%1] ").arg(i) << QString::fromLocal8Bit(p->readLine()).trimmed() << Qt::endl;
+        });
+        QObject::connect(p, &QProcess::finished, &app, [&, i](int code, QProcess::ExitStatus status) {
+            if (status != QProcess::NormalExit || code != 0)
+                out() << "Worker " << i << " exited abnormally (" << code << ")" << Qt::endl;
+            if (--running > 0) return;
+            report();
+            qint64 failed = 0;
+            for (const DownloadTask &t : store.tasks()) {
+                if (!isActiveTask(t)) continue;
+                failed += t.failedTiles;
+                if (t.totalTiles > 0 && t.completedTiles >= t.totalTiles) {
+                    store.setStatus(t.id, "completed");
+                    QDir(shardDir(store.path(), t.id)).removeRecursively();
+                }
+            }
+            store.save();
+            out() << "Finished, " << failed << " tiles failed (retried on next run)" << Qt::endl;
+            exitCode = failed > 0 ? 1 : 0;
+            app.quit();
+        });
+        p->start(QCoreApplication::applicationFilePath(), workerArgs);
+    }
+    out() << "Spawned " << workers << " workers" << Qt::endl;
+    reportTimer.start();
+    app.exec();
+    return exitCode;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("seeder");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Seed the tile cache without the GUI.");
+    parser.addHelpOption();
+    QCommandLineOption optManifest("manifest", "Task manifest (default manifest.json).", "file", "manifest.json");
+    QCommandLineOption optSettings("settings", "Settings file (default settings.json).", "file", "settings.json");
+    QCommandLineOption optPolygon("polygon", "Add a task covering a GeoJSON polygon.", "file");
+    QCommandLineOption optBBox("bbox", "Add a task covering minLon,minLat,maxLon,maxLat.", "bbox");
+    QCommandLineOption optMinZoom("min-zoom", "Minimum zoom of the added task.", "z");
+    QCommandLineOption optMaxZoom("max-zoom", "Maximum zoom of the added task.", "z");
+    QCommandLineOption optPriority("priority", "Priority of the added task (weight = priority + 1).", "n", "0");
+    QCommandLineOption optCache("cache", "Tile cache directory.", "dir");
+    QCommandLineOption optConcurrency("concurrency", "Maximum concurrent requests.", "n");
+    QCommandLineOption optRate("rate", "Requests per second.", "n");
+    QCommandLineOption optInterval("report", "Progress report interval in seconds (default 5).", "s", "5");
+    QCommandLineOption optSpawn("spawn", "Run n worker processes over shards of each task.", "n");
+    QCommandLineOption optBuild("build-pyramid", "Generate missing lower zooms (down to --min-zoom) from cached tiles, then exit.");
+    QCommandLineOption optWorker("worker", "Internal: claim and download shards (started by --spawn).");
+    optWorker.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOptions({optManifest, optSettings, optPolygon, optBBox, optMinZoom, optMaxZoom, optPriority,
+                       optCache, optConcurrency, optRate, optInterval, optSpawn, optBuild, optWorker});
+    parser.process(app);
+
+    MapManagerSettings settings = MapManagerSettings::load(parser.value(optSettings));
+    if (parser.isSet(optCache)) settings.cacheDir = parser.value(optCache);
+    if (parser.isSet(optConcurrency)) settings.maxConcurrent = qMax(1, parser.value(optConcurrency).toInt());
+    if (parser.isSet(optRate)) settings.rateLimitPerSec = qMax(1, parser.value(optRate).toInt());
+    if (parser.isSet(optMinZoom)) settings.minZoom = parser.value(optMinZoom).toInt();
+    if (parser.isSet(optMaxZoom)) settings.maxZoom = parser.value(optMaxZoom).toInt();
+
+    // 工作进程只读主清单，进度写各自的分片清单
+    const bool worker = parser.isSet(optWorker);
+    ManifestStore store(QFileInfo(parser.value(optManifest)).absoluteFilePath(), worker);
+    store.load();
+
+    // 命令行区域：多边形优先，范围取其外包矩形
+    if (!worker && (parser.isSet(optPolygon) || parser.isSet(optBBox))) {
+        DownloadTask t;
+        t.minZoom = settings.minZoom;
+        t.maxZoom = settings.maxZoom;
+        t.priority = parser.value(optPriority).toInt();
+        t.status = "pending";
+        if (parser.isSet(optPolygon)) {
+            QString error;
+            const GeoPolygon poly = GeoPolygon::loadGeoJson(parser.value(optPolygon), &error);
+            if (poly.isEmpty()) {
+                out() << "Cannot load polygon " << parser.value(optPolygon) << ": " << error << Qt::endl;
+                return 2;
+            }
+            const QRectF b = poly.bounds();
+            t.polygonPath = parser.value(optPolygon);
+            t.minLon = b.left(); t.maxLon = b.right();
+            t.minLat = b.top(); t.maxLat = b.bottom();
+        } else {
+            const QStringList v = parser.value(optBBox).split(',');
+            bool ok = v.size() == 4;
+            double c[4] = {0, 0, 0, 0};
+            for (int i = 0; ok && i < 4; ++i) c[i] = v[i].toDouble(&ok);
+            if (!ok || c[0] >= c[2] || c[1] >= c[3]) {
+                out() << "Invalid --bbox, expected minLon,minLat,maxLon,maxLat" << Qt::endl;
+                return 2;
+            }
+            t.minLon = c[0]; t.minLat = c[1]; t.maxLon = c[2]; t.maxLat = c[3];
+        }
+        const QString id = store.upsertTask(t);
+        store.save();
+        out() << "Added task " << id << " z" << t.minZoom << "-" << t.maxZoom << Qt::endl;
+    }
+
+    if (parser.isSet(optSpawn)) {
+        // 子进程沿用本进程的设置与覆盖参数（并发、速率为每个进程各自的值）
+        QStringList args{"--worker", "--manifest", store.path(),
+                         "--settings", QFileInfo(parser.value(optSettings)).absoluteFilePath()};
+        if (parser.isSet(optCache)) args << "--cache" << QFileInfo(settings.cacheDir).absoluteFilePath();
+        if (parser.isSet(optConcurrency)) args << "--concurrency" << QString::number(settings.maxConcurrent);
+        if (parser.isSet(optRate)) args << "--rate" << QString::number(settings.rateLimitPerSec);
+        return runCoordinator(app, store, qMax(1, parser.value(optSpawn).toInt()), args,
+                              qMax(1, parser.value(optInterval).toInt()));
+    }
+
+    TilePyramid pyramid;
+    {
+        QElapsedTimer t; t.start();
+        const qint64 n = pyramid.buildFromCache(settings.cacheDir);
+        out() << "Cache " << settings.cacheDir << ": " << n << " tiles indexed in " << t.elapsed() << " ms" << Qt::endl;
+    }
+    if (parser.isSet(optBuild)) {
+        PyramidBuilder builder(&pyramid);
+        builder.setCacheDir(settings.cacheDir);
+        QObject::connect(&builder, &PyramidBuilder::levelStarted, &app, [](int z, int tiles) {
+            out() << "z" << z << ": " << tiles << " tiles to generate" << Qt::endl;
+        });
+        QObject::connect(&builder, &PyramidBuilder::finished, &app, [&app](qint64 generated, qint64 failed, qint64 ms) {
+            out() << "Generated " << generated << " tiles (" << failed << " failed) in " << formatDuration(ms / 1000)
+                  << ", " << QString::number(ms > 0 ? double(generated) * 1000.0 / double(ms) : 0.0, 'f', 1)
+                  << " tiles/s" << Qt::endl;
+            app.exit(failed > 0 ? 1 : 0);
+        });
+        // 放到事件循环中启动：无可生成瓦片时 finished 会同步发出
+        QTimer::singleShot(0, &builder, [&]() { builder.start(settings.minZoom, pyramid.maxLevel()); });
+        return app.exec();
+    }
+
+    TileFetcher fetcher(&pyramid);
+    fetcher.configure(settings);
+    if (worker) return runWorker(store, settings, &fetcher);
+
+    DownloadScheduler sched;
+    sched.configure(settings);
+    sched.setManifest(&store);
+    sched.setFetcher(&fetcher);
+
+    // 各任务最新进度；汇总后计算吞吐（指数滑动平均）与剩余时间
+    struct Progress { qint64 done = 0; qint64 total = 0; };
+    QHash<QString, Progress> progress;
+    QObject::connect(&sched, &DownloadScheduler::taskProgress, &app,
+                     [&progress](const QString &taskId, qint64 completed, qint64 total) {
+        progress[taskId] = Progress{completed, total};
+    });
+    QObject::connect(&sched, &DownloadScheduler::taskStatusChanged, &app,
+                     [](const QString &taskId, const QString &status) {
+        out() << "Task " << taskId << " " << status << Qt::endl;
+    });
+
+    QElapsedTimer clock;
+    clock.start();
+    qint64 lastDone = -1;
+    qint64 lastMs = 0;
+    double rate = 0.0;
+    auto report = [&]() {
+        qint64 done = 0, total = 0;
+        for (const Progress &p : progress) { done += p.done; total += p.total; }
+        const qint64 ms = clock.elapsed();
+        if (lastDone >= 0 && ms > lastMs) {
+            const double inst = double(done - lastDone) * 1000.0 / double(ms - lastMs);
+            rate = rate > 0.0 ? 0.3 * inst + 0.7 * rate : inst;
+        }
+        lastDone = done;
+        lastMs = ms;
+        out() << progressLine(ms, done, total, rate, double(fetcher.bytesReceived()) / (1024.0 * 1024.0))
+              << Qt::endl;
+    };
+    QTimer reportTimer;
+    reportTimer.setInterval(qMax(1, parser.value(optInterval).toInt()) * 1000);
+    QObject::connect(&reportTimer, &QTimer::timeout, &app, report);
+
+    int exitCode = 0;
+    QObject::connect(&sched, &DownloadScheduler::allTasksFinished, &app, [&]() {
+        report();
+        qint64 failed = 0;
+        for (const DownloadTask &t : store.tasks()) failed += t.failedTiles;
+        store.save();
+        out() << "Finished, " << failed << " tiles failed (retried on next run)" << Qt::endl;
+        exitCode = failed > 0 ? 1 : 0;
+        app.quit();
+    });
+
+    reportTimer.start();
+    sched.start();
+    app.exec();
+    return exitCode;
+}
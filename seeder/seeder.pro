@@ -0,0 +1,41 @@
+# 命令行批量预下载（无 GUI）：与主程序共用调度、清单与抓取代码；gui 模块仅用于 QImage 解码（纯色瓦片识别）
+QT       = core gui network concurrent
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = seeder
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    main.cpp \
+    ../tilefetcher.cpp \
+    ../downloadscheduler.cpp \
+    ../manifeststore.cpp \
+    ../mapmanagersettings.cpp \
+    ../tilepyramid.cpp \
+    ../tilerange.cpp \
+    ../tilebitmap.cpp \
+    ../geopolygon.cpp \
+    ../webmercator.cpp \
+    ../pyramidbuilder.cpp
+
+HEADERS += \
+    ../tilefetcher.h \
+    ../downloadscheduler.h \
+    ../manifeststore.h \
+    ../mapmanagersettings.h \
+    ../tilepyramid.h \
+    ../tilerange.h \
+    ../tilebitmap.h \
+    ../geopolygon.h \
+    ../webmercator.h \
+    ../tileid.h \
+    ../flathashmap.h \
+    ../pyramidbuilder.h
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
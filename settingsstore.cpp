@@ -0,0 +1,72 @@
+#include "settingsstore.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+
+SettingsStore::SettingsStore(const QString &path, QObject *parent)
+    : QObject(parent)
+    , m_path(path)
+{
+    // 编辑器保存往往是多次写入或删除后重建，合并为一次重载
+    m_debounce.setSingleShot(true);
+    m_debounce.setInterval(200);
+    connect(&m_debounce, &QTimer::timeout, this, &SettingsStore::reload);
+    connect(&m_watcher, &QFileSystemWatcher::fileChanged, &m_debounce, qOverload<>(&QTimer::start));
+    connect(&m_watcher, &QFileSystemWatcher::directoryChanged, &m_debounce, qOverload<>(&QTimer::start));
+
+    bool ok = false;
+    std::atomic_store(&m_current, Snapshot(std::make_shared<const MapManagerSettings>(MapManagerSettings::load(m_path, &ok))));
+    m_hasFile = ok;
+    QFile f(m_path);
+    if (f.open(QIODevice::ReadOnly)) m_lastBytes = f.readAll();
+    watch();
+}
+
+void SettingsStore::watch()
+{
+    // 替换式保存后原路径会从监视列表中移除，每次重载后重新加入；文件不存在时监视目录以发现新建
+    const QString dir = QFileInfo(m_path).absolutePath();
+    if (QFile::exists(m_path)) {
+        if (!m_watcher.files().contains(m_path)) m_watcher.addPath(m_path);
+        if (m_watcher.directories().contains(dir)) m_watcher.removePath(dir);
+    } else if (!m_watcher.directories().contains(dir)) {
+        m_watcher.addPath(dir);
+    }
+}
+
+void SettingsStore::reload()
+{
+    watch();
+    QFile f(m_path);
+    if (!f.open(QIODevice::ReadOnly)) return; // 文件被删除：沿用当前快照
+    const QByteArray data = f.readAll();
+    f.close();
+    if (data == m_lastBytes) return;
+    bool ok = false;
+    const MapManagerSettings s = MapManagerSettings::fromBytes(data, &ok);
+    if (!ok) {
+        qDebug() << "SettingsStore: ignoring invalid settings file" << m_path;
+        return;
+    }
+    m_lastBytes = data;
+    m_hasFile = true;
+    qDebug() << "SettingsStore: reloaded" << m_path;
+    publish(s);
+}
+
+bool SettingsStore::save(const MapManagerSettings &settings)
+{
+    if (!settings.save(m_path)) return false;
+    QFile f(m_path);
+    if (f.open(QIODevice::ReadOnly)) m_lastBytes = f.readAll();
+    m_hasFile = true;
+    watch();
+    publish(settings);
+    return true;
+}
+
+void SettingsStore::publish(const MapManagerSettings &settings)
+{
+    std::atomic_store(&m_current, Snapshot(std::make_shared<const MapManagerSettings>(settings)));
+    emit settingsChanged(settings);
+}
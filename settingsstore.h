@@ -0,0 +1,46 @@
+#ifndef SETTINGSSTORE_H
+#define SETTINGSSTORE_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QTimer>
+#include <QFileSystemWatcher>
+#include <memory>
+#include "mapmanagersettings.h"
+
+// 设置快照：settings.json 解析一次后以不可变对象保存在内存，热路径只做一次原子读取、不碰磁盘。
+// 文件被修改（含外部编辑器的替换式保存）时经 QFileSystemWatcher 去抖后重新解析，
+// 内容有变化才替换快照并发出 settingsChanged；解析失败时保留旧快照。
+class SettingsStore : public QObject
+{
+    Q_OBJECT
+public:
+    using Snapshot = std::shared_ptr<const MapManagerSettings>;
+
+    explicit SettingsStore(const QString &path, QObject *parent = nullptr);
+
+    Snapshot snapshot() const { return std::atomic_load(&m_current); }
+    bool hasFile() const { return m_hasFile; } // 快照是否来自文件（否则为默认值）
+    QString path() const { return m_path; }
+
+    // 写入文件并立即替换快照（随后的文件变更通知因内容相同被忽略）
+    bool save(const MapManagerSettings &settings);
+
+signals:
+    void settingsChanged(const MapManagerSettings &settings);
+
+private:
+    void reload();
+    void watch();
+    void publish(const MapManagerSettings &settings);
+
+    QString m_path;
+    Snapshot m_current;
+    QByteArray m_lastBytes; // 上次解析的文件内容
+    bool m_hasFile = false;
+    QFileSystemWatcher m_watcher;
+    QTimer m_debounce;
+};
+
+#endif // SETTINGSSTORE_H
@@ -0,0 +1,339 @@
+#include "tilebitmap.h"
+#include <algorithm>
+
+#if defined(__GNUC__) || defined(__clang__)
+static inline int popcount64(quint64 v) { return __builtin_popcountll(v); }
+static inline int ctz64(quint64 v) { return __builtin_ctzll(v); }
+#else
+static inline int popcount64(quint64 v) { int n = 0; while (v) { v &= v - 1; ++n; } return n; }
+static inline int ctz64(quint64 v) { int n = 0; while (!(v & 1)) { v >>= 1; ++n; } return n; }
+#endif
+
+int TileBitmap::findChunk(quint64 key) const
+{
+    auto it = std::lower_bound(m_chunks.cbegin(), m_chunks.cend(), key,
+                               [](const Chunk &c, quint64 k) { return c.key < k; });
+    return (it != m_chunks.cend() && it->key == key) ? int(it - m_chunks.cbegin()) : -1;
+}
+
+TileBitmap::Chunk &TileBitmap::chunkFor(quint64 key)
+{
+    auto it = std::lower_bound(m_chunks.begin(), m_chunks.end(), key,
+                               [](const Chunk &c, quint64 k) { return c.key < k; });
+    if (it != m_chunks.end() && it->key == key) return *it;
+    const int index = int(it - m_chunks.begin());
+    Chunk c;
+    c.key = key;
+    m_chunks.insert(index, c);
+    return m_chunks[index];
+}
+
+bool TileBitmap::chunkContains(const Chunk &c, quint16 low)
+{
+    switch (c.kind) {
+    case Full: return true;
+    case Bitmap: return (c.words[low >> 6] >> (low & 63)) & 1;
+    default: return std::binary_search(c.array.cbegin(), c.array.cend(), low);
+    }
+}
+
+quint32 TileBitmap::chunkRank(const Chunk &c, quint32 low)
+{
+    switch (c.kind) {
+    case Full: return low;
+    case Bitmap: {
+        quint32 r = 0;
+        const quint32 word = low >> 6;
+        for (quint32 w = 0; w < word; ++w) r += popcount64(c.words[w]);
+        if (low & 63) r += popcount64(c.words[word] & ((quint64(1) << (low & 63)) - 1));
+        return r;
+    }
+    default:
+        return quint32(std::lower_bound(c.array.cbegin(), c.array.cend(), low) - c.array.cbegin());
+    }
+}
+
+void TileBitmap::toBitmap(Chunk &c)
+{
+    QVector<quint64> words(kChunkBits / 64, c.kind == Full ? ~quint64(0) : 0);
+    if (c.kind == Array) {
+        for (quint16 v : c.array) words[v >> 6] |= quint64(1) << (v & 63);
+    }
+    c.words = words;
+    c.array = QVector<quint16>();
+    c.kind = Bitmap;
+}
+
+bool TileBitmap::contains(qint64 i) const
+{
+    if (i < 0) return false;
+    const int ci = findChunk(quint64(i) >> 16);
+    return ci >= 0 && chunkContains(m_chunks[ci], quint16(i & 0xFFFF));
+}
+
+bool TileBitmap::add(qint64 i)
+{
+    if (i < 0) return false;
+    Chunk &c = chunkFor(quint64(i) >> 16);
+    const quint16 low = quint16(i & 0xFFFF);
+    if (c.kind == Full) return false;
+    if (c.kind == Array) {
+        auto it = std::lower_bound(c.array.begin(), c.array.end(), low);
+        if (it != c.array.end() && *it == low) return false;
+        if (quint32(c.array.size()) < kArrayMax) {
+            c.array.insert(int(it - c.array.begin()), low);
+            ++c.card;
+            ++m_count;
+            return true;
+        }
+        toBitmap(c);
+    }
+    quint64 &w = c.words[low >> 6];
+    const quint64 bit = quint64(1) << (low & 63);
+    if (w & bit) return false;
+    w |= bit;
+    ++m_count;
+    if (++c.card == kChunkBits) {
+        c.words = QVector<quint64>();
+        c.kind = Full;
+    }
+    return true;
+}
+
+bool TileBitmap::remove(qint64 i)
+{
+    if (i < 0) return false;
+    const int ci = findChunk(quint64(i) >> 16);
+    if (ci < 0) return false;
+    Chunk &c = m_chunks[ci];
+    const quint16 low = quint16(i & 0xFFFF);
+    if (!chunkContains(c, low)) return false;
+    if (c.kind == Array) {
+        c.array.remove(int(std::lower_bound(c.array.begin(), c.array.end(), low) - c.array.begin()));
+    } else {
+        if (c.kind == Full) toBitmap(c);
+        c.words[low >> 6] &= ~(quint64(1) << (low & 63));
+    }
+    --m_count;
+    if (--c.card == 0) m_chunks.remove(ci);
+    return true;
+}
+
+qint64 TileBitmap::addRange(qint64 from, qint64 to)
+{
+    qint64 added = 0;
+    for (qint64 i = qMax<qint64>(0, from); i <= to; ++i) {
+        // 整块落在区间内时直接置满
+        if ((i & 0xFFFF) == 0 && to - i + 1 >= kChunkBits) {
+            Chunk &c = chunkFor(quint64(i) >> 16);
+            added += kChunkBits - c.card;
+            m_count += kChunkBits - c.card;
+            c.card = kChunkBits;
+            c.kind = Full;
+            c.array = QVector<quint16>();
+            c.words = QVector<quint64>();
+            i += kChunkBits - 1;
+            continue;
+        }
+        if (add(i)) ++added;
+    }
+    return added;
+}
+
+QVector<quint64> TileBitmap::chunkWords(const Chunk &c)
+{
+    if (c.kind == Bitmap) return c.words;
+    QVector<quint64> words(kChunkBits / 64, c.kind == Full ? ~quint64(0) : 0);
+    if (c.kind == Array) {
+        for (quint16 v : c.array) words[v >> 6] |= quint64(1) << (v & 63);
+    }
+    return words;
+}
+
+void TileBitmap::setChunkWords(int index, const QVector<quint64> &words)
+{
+    Chunk &c = m_chunks[index];
+    quint32 card = 0;
+    for (quint64 w : words) card += popcount64(w);
+    m_count += qint64(card) - qint64(c.card);
+    c.card = card;
+    c.array = QVector<quint16>();
+    c.words = QVector<quint64>();
+    if (card == 0) {
+        m_chunks.remove(index);
+    } else if (card == kChunkBits) {
+        c.kind = Full;
+    } else if (card <= kArrayMax) {
+        c.kind = Array;
+        c.array.reserve(int(card));
+        for (quint32 w = 0; w < kChunkBits / 64; ++w) {
+            for (quint64 bits = words[w]; bits; bits &= bits - 1) c.array.append(quint16((w << 6) + ctz64(bits)));
+        }
+    } else {
+        c.kind = Bitmap;
+        c.words = words;
+    }
+}
+
+void TileBitmap::unite(const TileBitmap &other)
+{
+    for (const Chunk &oc : other.m_chunks) {
+        Chunk &c = chunkFor(oc.key);
+        if (c.kind == Full) continue;
+        QVector<quint64> words = chunkWords(c);
+        const QVector<quint64> ow = chunkWords(oc);
+        for (quint32 w = 0; w < kChunkBits / 64; ++w) words[w] |= ow[w];
+        setChunkWords(findChunk(oc.key), words);
+    }
+}
+
+void TileBitmap::subtract(const TileBitmap &other)
+{
+    for (const Chunk &oc : other.m_chunks) {
+        const int ci = findChunk(oc.key);
+        if (ci < 0) continue;
+        QVector<quint64> words = chunkWords(m_chunks[ci]);
+        const QVector<quint64> ow = chunkWords(oc);
+        for (quint32 w = 0; w < kChunkBits / 64; ++w) words[w] &= ~ow[w];
+        setChunkWords(ci, words);
+    }
+}
+
+TileBitmap TileBitmap::slice(qint64 from, qint64 to) const
+{
+    TileBitmap out;
+    for (const Chunk &c : m_chunks) {
+        const qint64 base = qint64(c.key) << 16;
+        if (base + kChunkBits <= from || base >= to) continue;
+        if (base >= from && base + kChunkBits <= to) {
+            // 整块落在区间内直接复制
+            out.m_chunks.append(c);
+            out.m_count += c.card;
+            continue;
+        }
+        QVector<quint64> words = chunkWords(c);
+        for (quint32 i = 0; i < kChunkBits; ++i) {
+            if (base + i < from || base + i >= to) words[i >> 6] &= ~(quint64(1) << (i & 63));
+        }
+        Chunk nc;
+        nc.key = c.key;
+        out.m_chunks.append(nc);
+        out.setChunkWords(out.m_chunks.size() - 1, words);
+    }
+    return out;
+}
+
+void TileBitmap::clear()
+{
+    m_chunks.clear();
+    m_count = 0;
+}
+
+qint64 TileBitmap::rank(qint64 i) const
+{
+    if (i <= 0) return 0;
+    const quint64 key = quint64(i) >> 16;
+    qint64 r = 0;
+    for (const Chunk &c : m_chunks) {
+        if (c.key < key) r += c.card;
+        else if (c.key == key) r += chunkRank(c, quint32(i & 0xFFFF));
+        else break;
+    }
+    return r;
+}
+
+qint64 TileBitmap::nextClear(qint64 from) const
+{
+    qint64 i = qMax<qint64>(0, from);
+    for (;;) {
+        const int ci = findChunk(quint64(i) >> 16);
+        if (ci < 0) return i;
+        const Chunk &c = m_chunks[ci];
+        const qint64 base = qint64(c.key) << 16;
+        quint32 low = quint32(i - base);
+        if (c.kind == Array) {
+            // 数组有序：从 low 起逐个比对，遇到空档即返回
+            auto it = std::lower_bound(c.array.cbegin(), c.array.cend(), quint16(low));
+            while (it != c.array.cend() && *it == low && low < kChunkBits) { ++it; ++low; }
+        } else if (c.kind == Bitmap) {
+            quint32 w = low >> 6;
+            quint64 free = ~c.words[w] & (~quint64(0) << (low & 63));
+            while (!free && ++w < kChunkBits / 64) free = ~c.words[w];
+            low = free ? (w << 6) + quint32(ctz64(free)) : kChunkBits;
+        } else {
+            low = kChunkBits;
+        }
+        if (low < kChunkBits) return base + low;
+        i = base + kChunkBits; // 本块余下全部置位，进入下一块
+    }
+}
+
+// 序列化：'T''B''M''1' | u32 块数 | 每块 u64 key, u8 kind, u32 card, 数据（小端）
+static void putUInt(QByteArray &out, quint64 v, int bytes)
+{
+    for (int b = 0; b < bytes; ++b) out.append(char((v >> (8 * b)) & 0xFF));
+}
+
+static bool getUInt(const QByteArray &in, int &pos, int bytes, quint64 &v)
+{
+    if (pos + bytes > in.size()) return false;
+    v = 0;
+    for (int b = 0; b < bytes; ++b) v |= quint64(quint8(in[pos + b])) << (8 * b);
+    pos += bytes;
+    return true;
+}
+
+QByteArray TileBitmap::toBytes() const
+{
+    QByteArray out("TBM1");
+    putUInt(out, quint64(m_chunks.size()), 4);
+    for (const Chunk &c : m_chunks) {
+        putUInt(out, c.key, 8);
+        putUInt(out, c.kind, 1);
+        putUInt(out, c.card, 4);
+        if (c.kind == Array) for (quint16 v : c.array) putUInt(out, v, 2);
+        else if (c.kind == Bitmap) for (quint64 w : c.words) putUInt(out, w, 8);
+    }
+    return out;
+}
+
+TileBitmap TileBitmap::fromBytes(const QByteArray &data, bool *ok)
+{
+    TileBitmap bm;
+    if (ok) *ok = data.isEmpty();
+    if (data.isEmpty()) return bm;
+    if (!data.startsWith("TBM1")) return bm;
+    int pos = 4;
+    quint64 n = 0, key = 0, kind = 0, card = 0, v = 0;
+    if (!getUInt(data, pos, 4, n)) return bm;
+    for (quint64 k = 0; k < n; ++k) {
+        if (!getUInt(data, pos, 8, key) || !getUInt(data, pos, 1, kind) || !getUInt(data, pos, 4, card))
+            return TileBitmap();
+        if (card == 0 || card > kChunkBits) return TileBitmap();
+        if (!bm.m_chunks.isEmpty() && key <= bm.m_chunks.last().key) return TileBitmap();
+        Chunk c;
+        c.key = key;
+        c.kind = quint8(kind);
+        c.card = quint32(card);
+        if (kind == Array) {
+            if (card > kArrayMax) return TileBitmap();
+            c.array.reserve(int(card));
+            for (quint64 j = 0; j < card; ++j) {
+                if (!getUInt(data, pos, 2, v)) return TileBitmap();
+                c.array.append(quint16(v));
+            }
+        } else if (kind == Bitmap) {
+            c.words.reserve(kChunkBits / 64);
+            for (quint32 j = 0; j < kChunkBits / 64; ++j) {
+                if (!getUInt(data, pos, 8, v)) return TileBitmap();
+                c.words.append(v);
+            }
+        } else if (kind != Full || card != kChunkBits) {
+            return TileBitmap();
+        }
+        bm.m_count += c.card;
+        bm.m_chunks.append(c);
+    }
+    if (ok) *ok = true;
+    return bm;
+}
@@ -0,0 +1,57 @@
+#ifndef TILEBITMAP_H
+#define TILEBITMAP_H
+
+#include <QVector>
+#include <QByteArray>
+#include <QtGlobal>
+
+// 压缩位图（roaring 风格），按 TileRange 序号记录瓦片完成/失败状态。
+// 序号按高 48 位分块，每块 65536 位，按基数选择容器：
+//   稀疏 -> 有序 quint16 数组；稠密 -> 1024 个 64 位字；整块置满 -> 不存数据。
+// 区域按行优先遍历，完成序号基本连续，已完成的块都会收敛为“满块”，内存与序列化体积都很小。
+class TileBitmap
+{
+public:
+    bool contains(qint64 i) const;
+    bool add(qint64 i);    // 新置位返回 true
+    bool remove(qint64 i); // 原先置位返回 true
+    qint64 addRange(qint64 from, qint64 to); // [from, to] 含端点，返回新置位数
+    void unite(const TileBitmap &other);    // 并集
+    void subtract(const TileBitmap &other); // 差集
+    TileBitmap slice(qint64 from, qint64 to) const; // 只保留 [from, to) 内的置位
+    void clear();
+
+    qint64 count() const { return m_count; }
+    bool isEmpty() const { return m_count == 0; }
+    qint64 rank(qint64 i) const; // 小于 i 的置位数
+    qint64 countRange(qint64 from, qint64 to) const { return rank(to) - rank(from); } // [from, to)
+    qint64 nextClear(qint64 from) const; // >= from 的第一个未置位序号
+
+    QByteArray toBytes() const;
+    static TileBitmap fromBytes(const QByteArray &data, bool *ok = nullptr);
+
+private:
+    enum Kind : quint8 { Array = 0, Bitmap = 1, Full = 2 };
+    struct Chunk {
+        quint64 key = 0;
+        quint8 kind = Array;
+        quint32 card = 0;
+        QVector<quint16> array; // Array：有序低 16 位
+        QVector<quint64> words; // Bitmap：1024 字
+    };
+    static const quint32 kChunkBits = 65536;
+    static const quint32 kArrayMax = 4096; // 超过则转位图（数组与位图同为 8KB 的分界）
+
+    int findChunk(quint64 key) const; // 不存在返回 -1
+    Chunk &chunkFor(quint64 key);     // 不存在则按序插入空数组块
+    static bool chunkContains(const Chunk &c, quint16 low);
+    static quint32 chunkRank(const Chunk &c, quint32 low); // 块内小于 low 的置位数
+    static void toBitmap(Chunk &c);
+    static QVector<quint64> chunkWords(const Chunk &c);
+    void setChunkWords(int index, const QVector<quint64> &words); // 按位图重建块并修正计数
+
+    QVector<Chunk> m_chunks; // 按 key 升序
+    qint64 m_count = 0;
+};
+
+#endif // TILEBITMAP_H
@@ -0,0 +1,166 @@
+#include "tilefetcher.h"
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QSaveFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QtConcurrent>
+#include <QFutureWatcher>
+#include <QDebug>
+
+TileFetcher::TileFetcher(TilePyramid *pyramid, QObject *parent)
+    : QObject(parent)
+    , m_pyramid(pyramid)
+    , m_network(new QNetworkAccessManager(this))
+{
+    configure(MapManagerSettings());
+}
+
+void TileFetcher::configure(const MapManagerSettings &settings)
+{
+    if (!settings.tileUrlTemplate.isEmpty()) m_urlTemplate = settings.tileUrlTemplate;
+    if (!settings.servers.isEmpty()) setServerList(settings.servers);
+    if (!settings.cacheDir.isEmpty()) m_cacheDir = settings.cacheDir;
+    setRetryPolicy(settings.retryMax, settings.backoffInitialMs);
+}
+
+void TileFetcher::setRetryPolicy(int retryMax, int backoffInitialMs)
+{
+    m_retryMax = qMax(1, retryMax);
+    m_backoffInitialMs = qMax(0, backoffInitialMs);
+}
+
+QString TileFetcher::tileUrl(const TileId &id)
+{
+    QString url = m_urlTemplate;
+    url.replace("{x}", QString::number(id.x()));
+    url.replace("{y}", QString::number(id.y()));
+    url.replace("{z}", QString::number(id.z()));
+    if (url.contains("{server}") && !m_servers.isEmpty()) {
+        url.replace("{server}", m_servers[m_serverIndex % m_servers.size()]);
+        m_serverIndex = (m_serverIndex + 1) % m_servers.size();
+    }
+    return url;
+}
+
+void TileFetcher::fetch(const TileId &id)
+{
+    if (m_pyramid && m_pyramid->contains(id)) {
+        emit tileCached(id.x(), id.y(), id.z(), true);
+        return;
+    }
+    ++m_inflight;
+    startRequest(id, 0);
+}
+
+void TileFetcher::startRequest(const TileId &id, int attempt)
+{
+    QNetworkRequest request{QUrl(tileUrl(id))};
+    request.setRawHeader("User-Agent", "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36");
+    request.setRawHeader("Accept", "image/png,image/svg+xml,image/*;q=0.8,*/*;q=0.5");
+    request.setTransferTimeout(30000);
+    QNetworkReply *reply = m_network->get(request);
+    connect(reply, &QNetworkReply::finished, this, [this, reply, id, attempt]() {
+        onReplyFinished(reply, id, attempt);
+    });
+}
+
+void TileFetcher::onReplyFinished(QNetworkReply *reply, const TileId &id, int attempt)
+{
+    reply->deleteLater();
+    if (reply->error() != QNetworkReply::NoError) {
+        // 404 不重试；其它错误按指数退避重试
+        if (reply->error() != QNetworkReply::ContentNotFoundError && attempt + 1 < m_retryMax) {
+            const int backoff = m_backoffInitialMs * (1 << qMin(attempt, 10));
+            QTimer::singleShot(backoff, this, [this, id, attempt]() { startRequest(id, attempt + 1); });
+            return;
+        }
+        finish(id, false, reply->errorString());
+        return;
+    }
+    const QByteArray data = reply->readAll();
+    m_bytesReceived += data.size();
+    if (!data.startsWith(QByteArray::fromHex("89504e47"))) {
+        finish(id, false, data.isEmpty() ? QStringLiteral("Empty response") : QStringLiteral("Invalid PNG data"));
+        return;
+    }
+    QString error;
+    if (!writeTile(id, data, &error)) {
+        finish(id, false, error);
+        return;
+    }
+    if (m_detectUniform && id.z() >= m_uniformMinZoom) detectUniform(id, data);
+    emit tileFetched(id.x(), id.y(), id.z(), data);
+    finish(id, true);
+}
+
+void TileFetcher::detectUniform(const TileId &id, const QByteArray &data)
+{
+    // 解码与 uniform.txt 追加在线程池完成，覆盖索引只在本线程改
+    const QString cacheDir = m_cacheDir;
+    auto *watcher = new QFutureWatcher<quint64>(this);
+    connect(watcher, &QFutureWatcher<quint64>::finished, this, [this, watcher, id, cacheDir]() {
+        const quint64 r = watcher->result();
+        watcher->deleteLater();
+        if (r >> 32 && m_pyramid && cacheDir == m_cacheDir) m_pyramid->markUniform(id, quint32(r));
+    });
+    // 高 32 位为纯色标记，低 32 位为颜色
+    watcher->setFuture(QtConcurrent::run([id, data, cacheDir]() -> quint64 {
+        quint32 argb = 0;
+        if (!uniformColor(data, argb)) return 0;
+        TilePyramid::appendUniform(cacheDir, id, argb);
+        return (quint64(1) << 32) | argb;
+    }));
+}
+
+bool TileFetcher::uniformColor(const QByteArray &png, quint32 &argb)
+{
+    const QImage img = QImage::fromData(png).convertToFormat(QImage::Format_ARGB32);
+    if (img.isNull()) return false;
+    const quint32 first = reinterpret_cast<const quint32 *>(img.constScanLine(0))[0];
+    for (int y = 0; y < img.height(); ++y) {
+        const quint32 *row = reinterpret_cast<const quint32 *>(img.constScanLine(y));
+        for (int x = 0; x < img.width(); ++x) {
+            if (row[x] != first) return false;
+        }
+    }
+    argb = first;
+    return true;
+}
+
+bool TileFetcher::writeTile(const TileId &id, const QByteArray &data, QString *error)
+{
+    const QString path = tilePath(id);
+    QDir dir(QFileInfo(path).path());
+    if (!dir.exists() && !dir.mkpath(".")) {
+        *error = QStringLiteral("Failed to create directory");
+        return false;
+    }
+    // 先写临时文件再原子改名：多个种子进程可能同时写同一瓦片，读者不会看到半截文件
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        *error = f.errorString();
+        return false;
+    }
+    if (f.write(data) != data.size()) {
+        f.cancelWriting();
+        *error = QStringLiteral("Incomplete write");
+        return false;
+    }
+    if (!f.commit()) {
+        *error = f.errorString();
+        return false;
+    }
+    if (m_pyramid) m_pyramid->insert(id);
+    return true;
+}
+
+void TileFetcher::finish(const TileId &id, bool success, const QString &error)
+{
+    m_inflight = qMax(0, m_inflight - 1);
+    if (!success) qDebug() << "Tile fetch failed:" << id.z() << id.x() << id.y() << error;
+    emit tileCached(id.x(), id.y(), id.z(), success);
+}
@@ -0,0 +1,68 @@
+#ifndef TILEFETCHER_H
+#define TILEFETCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include "tileid.h"
+#include "tilepyramid.h"
+#include "mapmanagersettings.h"
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// 批量下载的抓取与落盘（QtCore + QtNetwork，纯色识别用 QImage 解码；GUI 与命令行共用）：
+// 按模板生成 URL 并轮转服务器，异步请求、指数退避重试，写入 cacheDir/z/x/y.png 并更新覆盖索引。
+// 并发与速率由调度器控制，这里只负责单个瓦片的完整生命周期。
+class TileFetcher : public QObject
+{
+    Q_OBJECT
+public:
+    // pyramid 由调用方持有（GUI 与视图共用同一份索引）
+    explicit TileFetcher(TilePyramid *pyramid, QObject *parent = nullptr);
+
+    void configure(const MapManagerSettings &settings);
+    void setTileSource(const QString &urlTemplate) { m_urlTemplate = urlTemplate; }
+    void setServerList(const QStringList &servers) { m_servers = servers; m_serverIndex = 0; }
+    void setCacheDir(const QString &dir) { m_cacheDir = dir; }
+    void setRetryPolicy(int retryMax, int backoffInitialMs);
+    // 开启后在线程池解码新下载的 z >= minZoom 瓦片，纯色时登记到覆盖索引与 uniform.txt
+    void setUniformDetection(bool enabled, int minZoom) { m_detectUniform = enabled; m_uniformMinZoom = minZoom; }
+    QString cacheDir() const { return m_cacheDir; }
+    const TilePyramid &pyramid() const { return *m_pyramid; }
+
+    // 已缓存时直接回报成功，否则发起下载
+    void fetch(const TileId &id);
+    int inflight() const { return m_inflight; }
+    qint64 bytesReceived() const { return m_bytesReceived; }
+
+signals:
+    void tileFetched(int x, int y, int z, const QByteArray &data); // 新下载并已写盘
+    void tileCached(int x, int y, int z, bool success);
+
+private:
+    QString tileUrl(const TileId &id);
+    QString tilePath(const TileId &id) const { return m_cacheDir + QLatin1Char('/') + id.relativePath(); }
+    void startRequest(const TileId &id, int attempt);
+    void onReplyFinished(QNetworkReply *reply, const TileId &id, int attempt);
+    bool writeTile(const TileId &id, const QByteArray &data, QString *error);
+    void detectUniform(const TileId &id, const QByteArray &data);
+    static bool uniformColor(const QByteArray &png, quint32 &argb); // 全部像素同色
+    void finish(const TileId &id, bool success, const QString &error = QString());
+
+    TilePyramid *m_pyramid;
+    QNetworkAccessManager *m_network;
+    QString m_urlTemplate;
+    QStringList m_servers;
+    int m_serverIndex = 0;
+    QString m_cacheDir;
+    int m_retryMax = 3;
+    int m_backoffInitialMs = 3000;
+    bool m_detectUniform = false;
+    int m_uniformMinZoom = 6;
+    int m_inflight = 0;
+    qint64 m_bytesReceived = 0;
+};
+
+#endif // TILEFETCHER_H
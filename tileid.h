@@ -0,0 +1,112 @@
+#ifndef TILEID_H
+#define TILEID_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QMetaType>
+#include <cstddef>
+
+// 瓦片键：64 位打包值，高 6 位为层级 z，低 58 位为 x/y 的 Morton（Z 序）交织，
+// x、y 各 29 位（最高支持 z=29）。
+// 按原始值比较即先按层级、再按 Z 序排序，遍历有序容器时天然保持空间局部性。
+struct TileId
+{
+    quint64 v = 0;
+
+    TileId() = default;
+    TileId(int x, int y, int z)
+        : v((quint64(z) << 58) | interleave(quint32(x)) | (interleave(quint32(y)) << 1)) {}
+
+    static TileId fromRaw(quint64 raw) { TileId id; id.v = raw; return id; }
+    quint64 raw() const { return v; }
+    quint64 morton() const { return v & kMortonMask; }
+
+    int z() const { return int(v >> 58); }
+    int x() const { return int(compact(v & kMortonMask)); }
+    int y() const { return int(compact((v & kMortonMask) >> 1)); }
+
+    // 层级内的邻接关系直接在 Morton 码上移位完成
+    TileId parent() const { return ancestor(1); }
+    TileId ancestor(int dz) const
+    {
+        if (dz <= 0) return *this;
+        return fromRaw((quint64(z() - dz) << 58) | (morton() >> (2 * dz)));
+    }
+    // i: 0=左上 1=右上 2=左下 3=右下
+    TileId child(int i) const
+    {
+        return fromRaw((quint64(z() + 1) << 58) | (morton() << 2) | quint64(i & 3));
+    }
+    // 本瓦片在 z+dz 层覆盖的后代 Morton 区间 [first, last]（连续）
+    TileId firstDescendant(int dz) const { return fromRaw((quint64(z() + dz) << 58) | (morton() << (2 * dz))); }
+    TileId lastDescendant(int dz) const
+    {
+        return fromRaw((quint64(z() + dz) << 58) | (morton() << (2 * dz)) | ((quint64(1) << (2 * dz)) - 1));
+    }
+    bool isAncestorOf(const TileId &other) const
+    {
+        const int dz = other.z() - z();
+        return dz > 0 && other.ancestor(dz) == *this;
+    }
+
+    bool isValid() const
+    {
+        if (z() > 29) return false;
+        const int n = 1 << z();
+        return x() < n && y() < n;
+    }
+
+    // 缓存相对路径 "z/x/y.png"
+    QString relativePath() const
+    {
+        return QString::number(z()) + QLatin1Char('/') + QString::number(x())
+               + QLatin1Char('/') + QString::number(y()) + QLatin1String(".png");
+    }
+
+    bool operator==(const TileId &o) const { return v == o.v; }
+    bool operator!=(const TileId &o) const { return v != o.v; }
+    bool operator<(const TileId &o) const { return v < o.v; }
+
+    static constexpr quint64 kMortonMask = (quint64(1) << 58) - 1;
+
+    // 把 32 位数的低 29 位展开到偶数位
+    static quint64 interleave(quint32 a)
+    {
+        quint64 x = a & 0x1FFFFFFFu;
+        x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+        x = (x | (x << 8))  & 0x00FF00FF00FF00FFull;
+        x = (x | (x << 4))  & 0x0F0F0F0F0F0F0F0Full;
+        x = (x | (x << 2))  & 0x3333333333333333ull;
+        x = (x | (x << 1))  & 0x5555555555555555ull;
+        return x;
+    }
+    static quint32 compact(quint64 x)
+    {
+        x &= 0x5555555555555555ull;
+        x = (x | (x >> 1))  & 0x3333333333333333ull;
+        x = (x | (x >> 2))  & 0x0F0F0F0F0F0F0F0Full;
+        x = (x | (x >> 4))  & 0x00FF00FF00FF00FFull;
+        x = (x | (x >> 8))  & 0x0000FFFF0000FFFFull;
+        x = (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+        return quint32(x);
+    }
+};
+Q_DECLARE_METATYPE(TileId)
+
+// 64 位混合（splitmix64 终结步），相邻 Morton 码也能均匀分散到桶
+inline size_t qHash(const TileId &id, size_t seed = 0) noexcept
+{
+    quint64 h = id.v + 0x9E3779B97F4A7C15ull + seed;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return size_t(h);
+}
+
+// 供 FlatHashMap 等非 Qt 容器使用
+struct TileIdHash
+{
+    size_t operator()(const TileId &id) const noexcept { return qHash(id); }
+};
+
+#endif // TILEID_H
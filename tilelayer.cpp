@@ -0,0 +1,294 @@
+#include "tilelayer.h"
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+#include <QElapsedTimer>
+#include <QDebug>
+#include <QVector>
+#include <QPair>
+#include <cmath>
+#include <algorithm>
+
+TileLayerItem::TileLayerItem(int tileSize, QGraphicsItem *parent)
+    : QGraphicsItem(parent)
+    , m_tileSize(tileSize)
+{
+    // 需要 exposedRect 才能只绘制暴露区域内的瓦片
+    setFlag(QGraphicsItem::ItemUsesExtendedStyleOption, true);
+    setAcceptedMouseButtons(Qt::NoButton);
+    setZValue(0);
+    m_clock.start();
+}
+
+QRectF TileLayerItem::boundingRect() const
+{
+    const qreal side = qreal(1 << m_zoom) * m_tileSize;
+    return QRectF(0, 0, side, side);
+}
+
+QRectF TileLayerItem::tileRect(int x, int y) const
+{
+    return QRectF(qreal(x) * m_tileSize, qreal(y) * m_tileSize, m_tileSize, m_tileSize);
+}
+
+void TileLayerItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(widget);
+    QElapsedTimer t;
+    t.start();
+
+    const QRectF exposed = option->exposedRect.intersected(boundingRect());
+    if (exposed.isEmpty()) return;
+    painter->save(); // 整个图层只保存一次画笔状态
+
+    // 暴露区域 -> 瓦片索引范围
+    const int n = 1 << m_zoom;
+    const int x0 = qMax(0, int(std::floor(exposed.left() / m_tileSize)));
+    const int y0 = qMax(0, int(std::floor(exposed.top() / m_tileSize)));
+    const int x1 = qMin(n - 1, int(std::ceil(exposed.right() / m_tileSize)) - 1);
+    const int y1 = qMin(n - 1, int(std::ceil(exposed.bottom() / m_tileSize)) - 1);
+
+    int drawn = 0;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const TileId id = key(x, y);
+            const QPixmap *pm = m_tiles.find(id);
+            if (!pm) {
+                if (!m_fallback.isEmpty() && paintFallback(painter, x, y)) drawn++;
+                continue;
+            }
+            const qint64 *fade = m_fadeStart.isEmpty() ? nullptr : m_fadeStart.find(id);
+            if (fade) {
+                const qreal a = qreal(m_clock.elapsed() - *fade) / qMax(1, m_fadeMs);
+                if (a < 1.0) {
+                    // 先画占位，再以渐增不透明度叠加新瓦片
+                    paintFallback(painter, x, y);
+                    const qreal oldOpacity = painter->opacity();
+                    painter->setOpacity(oldOpacity * qMax<qreal>(0.0, a));
+                    painter->drawPixmap(QPointF(qreal(x) * m_tileSize, qreal(y) * m_tileSize), *pm);
+                    painter->setOpacity(oldOpacity);
+                    drawn++;
+                    continue;
+                }
+                m_fadeStart.remove(id);
+            }
+            painter->drawPixmap(QPointF(qreal(x) * m_tileSize, qreal(y) * m_tileSize), *pm);
+            drawn++;
+        }
+    }
+    painter->restore();
+
+    const qint64 ns = t.nsecsElapsed();
+    m_stats.frames++;
+    m_stats.totalNs += ns;
+    m_stats.maxNs = qMax(m_stats.maxNs, ns);
+    m_stats.tilesDrawn += drawn;
+    if (m_statsLogging && m_stats.frames % 120 == 0) {
+        qDebug() << "TileLayer paint: frames" << m_stats.frames
+                 << "avg(ms)" << (m_stats.totalNs / 1e6) / m_stats.frames
+                 << "max(ms)" << m_stats.maxNs / 1e6
+                 << "tiles/frame" << double(m_stats.tilesDrawn) / m_stats.frames;
+    }
+}
+
+bool TileLayerItem::paintFallback(QPainter *painter, int x, int y) const
+{
+    const QRectF target = tileRect(x, y);
+
+    // 最近祖先：裁剪对应子区域并放大
+    for (int dz = 1; dz <= kMaxFallbackLevels && dz <= m_zoom; ++dz) {
+        const QPixmap *anc = m_fallback.find(TileId(x, y, m_zoom).ancestor(dz));
+        if (!anc) continue;
+        const QPixmap &pm = *anc;
+        const qreal sub = qreal(pm.width()) / (1 << dz);
+        const int mask = (1 << dz) - 1;
+        const QRectF source((x & mask) * sub, (y & mask) * sub, sub, sub);
+        painter->drawPixmap(target, pm, source);
+        return true;
+    }
+
+    // 缩小时：用下一级的四个子瓦片拼合
+    bool any = false;
+    const qreal half = m_tileSize / 2.0;
+    for (int i = 0; i < 4; ++i) {
+        const int cx = 2 * x + (i & 1);
+        const int cy = 2 * y + (i >> 1);
+        const QPixmap *child = m_fallback.find(TileId(cx, cy, m_zoom + 1));
+        if (!child) continue;
+        const QRectF quarter(target.left() + (i & 1) * half, target.top() + (i >> 1) * half, half, half);
+        painter->drawPixmap(quarter, *child, child->rect());
+        any = true;
+    }
+    return any;
+}
+
+void TileLayerItem::setZoom(int zoom)
+{
+    if (zoom == m_zoom) return;
+    prepareGeometryChange();
+    // 旧层级瓦片转入占位缓存，作为新层级的祖先/子瓦片
+    m_tiles.forEach([this](const TileId &id, const QPixmap &pm) { m_fallback.insert(id, pm); });
+    // 可见范围换算到新层级，供占位裁剪按距离判断
+    if (!m_visibleRange.isEmpty()) {
+        const QRect r = m_visibleRange;
+        m_visibleRange = zoom > m_zoom
+            ? QRect(QPoint(r.left() << (zoom - m_zoom), r.top() << (zoom - m_zoom)),
+                    QPoint(((r.right() + 1) << (zoom - m_zoom)) - 1, ((r.bottom() + 1) << (zoom - m_zoom)) - 1))
+            : QRect(QPoint(r.left() >> (m_zoom - zoom), r.top() >> (m_zoom - zoom)),
+                    QPoint(r.right() >> (m_zoom - zoom), r.bottom() >> (m_zoom - zoom)));
+    }
+    m_zoom = zoom;
+    m_tiles.clear();
+    m_fadeStart.clear();
+    m_synthetic.clear();
+    pruneFallback();
+    // 预载瓦片换入后从旧层级占位上淡入
+    m_staged.forEach([this](const TileId &id, const QPixmap &pm) {
+        if (id.z() == m_zoom) setTile(id.x(), id.y(), pm, false);
+    });
+    m_staged.clear();
+    update();
+}
+
+void TileLayerItem::setStagedTile(int z, int x, int y, const QPixmap &pixmap)
+{
+    if (z == m_zoom || pixmap.isNull()) return;
+    m_staged.insert(TileId(x, y, z), pixmap);
+}
+
+void TileLayerItem::setFallbackTile(int z, int x, int y, const QPixmap &pixmap)
+{
+    if (z == m_zoom || pixmap.isNull()) return;
+    m_fallback.insert(TileId(x, y, z), pixmap);
+    pruneFallback();
+    // 失效该占位在当前层级覆盖的区域
+    if (z < m_zoom) {
+        const int dz = m_zoom - z;
+        const qreal side = qreal(m_tileSize) * (1 << dz);
+        update(QRectF(x * side, y * side, side, side));
+    } else {
+        const int dz = z - m_zoom;
+        const qreal side = qreal(m_tileSize) / (1 << dz);
+        update(QRectF(x * side, y * side, side, side));
+    }
+}
+
+bool TileLayerItem::hasFallbackFor(int x, int y) const
+{
+    for (int dz = 1; dz <= kMaxFallbackLevels && dz <= m_zoom; ++dz) {
+        if (m_fallback.contains(TileId(x, y, m_zoom).ancestor(dz))) return true;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (m_fallback.contains(TileId(x, y, m_zoom).child(i))) return true;
+    }
+    return false;
+}
+
+bool TileLayerItem::advanceFade()
+{
+    const qint64 now = m_clock.elapsed();
+    // 失效仍在淡入的区域；超时的直接移除，避免残留
+    m_fadeStart.removeIf([this, now](const TileId &id, qint64 start) {
+        update(tileRect(id.x(), id.y()));
+        return now - start > m_fadeMs + 100;
+    });
+    return !m_fadeStart.isEmpty();
+}
+
+void TileLayerItem::clearFallback()
+{
+    if (m_fallback.isEmpty()) return;
+    m_fallback.clear();
+    update();
+}
+
+void TileLayerItem::pruneFallback()
+{
+    // 只保留当前层级可用的：祖先不超过 kMaxFallbackLevels 层，子瓦片仅下一级
+    m_fallback.removeIf([this](const TileId &id, const QPixmap &) {
+        const int z = id.z();
+        return !((z < m_zoom && m_zoom - z <= kMaxFallbackLevels) || z == m_zoom + 1);
+    });
+    // 超出上限时优先丢弃离当前层级远的；相邻层级（父/子）是最有用的占位，不整体清空
+    for (int dz = kMaxFallbackLevels; dz >= 2 && int(m_fallback.size()) > kMaxFallbackTiles; --dz) {
+        m_fallback.removeIf([this, dz](const TileId &id, const QPixmap &) {
+            return qAbs(id.z() - m_zoom) >= dz;
+        });
+    }
+    if (int(m_fallback.size()) <= kMaxFallbackTiles) return;
+
+    // 仍超限：按覆盖区域到可见范围的距离（当前层级瓦片数）丢弃最远的
+    QRect range = m_visibleRange;
+    if (range.isEmpty()) {
+        m_tiles.forEach([&range](const TileId &id, const QPixmap &) { range |= QRect(id.x(), id.y(), 1, 1); });
+    }
+    QVector<QPair<int, TileId>> byDistance;
+    byDistance.reserve(int(m_fallback.size()));
+    m_fallback.forEach([&](const TileId &id, const QPixmap &) {
+        const QRect covered = id.z() < m_zoom ? QRect(id.x() << 1, id.y() << 1, 2, 2)
+                                              : QRect(id.x() >> 1, id.y() >> 1, 1, 1);
+        int d = 0;
+        if (!range.isEmpty()) {
+            const int gx = qMax(range.left() - covered.right(), covered.left() - range.right());
+            const int gy = qMax(range.top() - covered.bottom(), covered.top() - range.bottom());
+            d = qMax(0, qMax(gx, gy));
+        }
+        byDistance.append(qMakePair(d, id));
+    });
+    const int excess = int(byDistance.size()) - kMaxFallbackTiles;
+    std::nth_element(byDistance.begin(), byDistance.begin() + excess, byDistance.end(),
+                     [](const QPair<int, TileId> &a, const QPair<int, TileId> &b) { return a.first > b.first; });
+    for (int i = 0; i < excess; ++i) m_fallback.remove(byDistance[i].second);
+}
+
+void TileLayerItem::setTile(int x, int y, const QPixmap &pixmap, bool invalidate, bool synthetic)
+{
+    m_tiles.insert(key(x, y), pixmap);
+    if (synthetic) m_synthetic.insert(key(x, y), true);
+    else if (!m_synthetic.isEmpty()) m_synthetic.remove(key(x, y));
+    // 有占位可见时做淡入，层级切换不出现硬切
+    if (m_fadeMs > 0 && !m_fallback.isEmpty() && hasFallbackFor(x, y)) {
+        m_fadeStart.insert(key(x, y), m_clock.elapsed());
+    }
+    // 只失效该瓦片区域，而不是整个场景
+    if (invalidate) update(tileRect(x, y));
+}
+
+void TileLayerItem::removeTilesOutside(int minX, int minY, int maxX, int maxY)
+{
+    m_visibleRange = QRect(QPoint(minX, minY), QPoint(maxX, maxY));
+    m_tiles.removeIf([&](const TileId &id, const QPixmap &) {
+        const int x = id.x();
+        const int y = id.y();
+        if (x >= minX && x <= maxX && y >= minY && y <= maxY) return false;
+        update(tileRect(x, y));
+        m_fadeStart.remove(id);
+        m_synthetic.remove(id);
+        return true;
+    });
+    // 占位瓦片：换算到当前层级后不与范围相交的一并移除
+    m_fallback.removeIf([&](const TileId &id, const QPixmap &) {
+        const int z = id.z();
+        int x0, y0, x1, y1;
+        if (z < m_zoom) {
+            const int dz = m_zoom - z;
+            x0 = id.x() << dz; y0 = id.y() << dz;
+            x1 = ((id.x() + 1) << dz) - 1; y1 = ((id.y() + 1) << dz) - 1;
+        } else {
+            const int dz = z - m_zoom;
+            x0 = x1 = id.x() >> dz; y0 = y1 = id.y() >> dz;
+        }
+        return x1 < minX || x0 > maxX || y1 < minY || y0 > maxY;
+    });
+}
+
+void TileLayerItem::clearTiles()
+{
+    if (m_tiles.isEmpty() && m_fallback.isEmpty() && m_staged.isEmpty()) return;
+    m_tiles.clear();
+    m_fallback.clear();
+    m_fadeStart.clear();
+    m_synthetic.clear();
+    m_staged.clear();
+    m_visibleRange = QRect();
+    update();
+}
@@ -0,0 +1,88 @@
+#ifndef TILELAYER_H
+#define TILELAYER_H
+
+#include <QGraphicsItem>
+#include <QPixmap>
+#include <QElapsedTimer>
+#include <QRect>
+#include "tileid.h"
+#include "flathashmap.h"
+
+// 瓦片图层：用一个图形项持有当前层级的全部瓦片，
+// paint() 只绘制与暴露区域相交的瓦片，插入单张瓦片时只失效该瓦片的矩形。
+// 替代“每张瓦片一个 QGraphicsPixmapItem”，避免场景 BSP 索引随插入/移除/setPos 抖动。
+class TileLayerItem : public QGraphicsItem
+{
+public:
+    explicit TileLayerItem(int tileSize = 256, QGraphicsItem *parent = nullptr);
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
+
+    // 切换层级：清空当前瓦片并按新层级调整边界；已预载的新层级瓦片转为当前瓦片并开始淡入
+    void setZoom(int zoom);
+    int zoom() const { return m_zoom; }
+
+    // invalidate=false 时由调用方统一 update() 合并后的区域；
+    // synthetic 标记由祖先放大合成的瓦片（超出缓存层级），真实瓦片到达时覆盖
+    void setTile(int x, int y, const QPixmap &pixmap, bool invalidate = true, bool synthetic = false);
+    bool hasTile(int x, int y) const { return m_tiles.contains(key(x, y)); }
+    bool isSynthetic(int x, int y) const { return !m_synthetic.isEmpty() && m_synthetic.contains(key(x, y)); }
+    // 移除给定瓦片范围之外的瓦片（闭区间）
+    void removeTilesOutside(int minX, int minY, int maxX, int maxY);
+    void clearTiles();
+    int tileCount() const { return int(m_tiles.size()); }
+
+    // 占位：缺失瓦片用最近的祖先裁剪放大、或用下一级四个子瓦片缩小填充。
+    // 切换层级时旧层级瓦片转入占位缓存；真实瓦片到达后自然覆盖。
+    void setFallbackTile(int z, int x, int y, const QPixmap &pixmap);
+    bool hasFallbackFor(int x, int y) const;
+    void clearFallback();
+    int fallbackCount() const { return int(m_fallback.size()); }
+
+    // 预载：缩放切换前先收集目标层级的瓦片，不参与绘制，setZoom 到该层级时一次换入
+    void setStagedTile(int z, int x, int y, const QPixmap &pixmap);
+    bool hasStagedTile(int z, int x, int y) const { return m_staged.contains(TileId(x, y, z)); }
+    void clearStaged() { m_staged.clear(); }
+
+    // 淡入：盖在占位上的新瓦片在 fadeMs 内从透明过渡到不透明（0 关闭）
+    void setFadeDuration(int ms) { m_fadeMs = ms; }
+    bool isFading() const { return !m_fadeStart.isEmpty(); }
+    // 失效仍在淡入的瓦片区域，返回是否还有淡入中的瓦片
+    bool advanceFade();
+    QRectF tileRect(int x, int y) const;
+
+    // 帧耗时统计：paint() 累计耗时与绘制瓦片数，用于与逐瓦片 item 方案对比
+    struct PaintStats {
+        int frames = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+        qint64 tilesDrawn = 0;
+    };
+    PaintStats paintStats() const { return m_stats; }
+    void resetPaintStats() { m_stats = PaintStats(); }
+    void setStatsLogging(bool enabled) { m_statsLogging = enabled; }
+
+private:
+    TileId key(int x, int y) const { return TileId(x, y, m_zoom); }
+    bool paintFallback(QPainter *painter, int x, int y) const;
+    void pruneFallback();
+
+    static constexpr int kMaxFallbackLevels = 4; // 祖先最多向上查找的层数
+    static constexpr int kMaxFallbackTiles = 512;
+
+    int m_tileSize;
+    int m_zoom = 0;
+    FlatHashMap<TileId, QPixmap, TileIdHash> m_tiles;
+    FlatHashMap<TileId, QPixmap, TileIdHash> m_fallback; // 其他层级的瓦片
+    FlatHashMap<TileId, qint64, TileIdHash> m_fadeStart; // 瓦片 -> 淡入起始时刻
+    FlatHashMap<TileId, bool, TileIdHash> m_synthetic;   // 合成瓦片
+    FlatHashMap<TileId, QPixmap, TileIdHash> m_staged;   // 待切换层级的预载瓦片
+    QRect m_visibleRange; // 最近一次保留的瓦片范围（当前层级，闭区间）
+    QElapsedTimer m_clock;
+    int m_fadeMs = 150;
+    PaintStats m_stats;
+    bool m_statsLogging = false;
+};
+
+#endif // TILELAYER_H
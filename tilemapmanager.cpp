@@ -1,64 +1,149 @@
 #include "tilemapmanager.h"
-#include <QGraphicsPixmapItem>
+#include "tilelayer.h"
+#include "webmercator.h"
+#include "tilefetcher.h"
+#include "pyramidbuilder.h"
+#include "asynclogger.h"
 #include <QGraphicsScene>
+#include <QElapsedTimer>
+#include <QColor>
+#include <QtConcurrent>
+#include <algorithm>
 
-void TileMapManager::enqueueInsert(int x, int y, int z, const QPixmap &pixmap)
+void TileMapManager::enqueueInsert(int x, int y, int z, const QPixmap &pixmap, bool synthetic)
 {
+    // 非当前层级或后台模式直接丢弃，不进入队列（预载层级转交图层暂存）
+    if (m_background) {
+        m_refreshOnRestore = true;
+        return;
+    }
+    if (z != m_zoom) {
+        if (z == m_stageZoom) stageTile(x, y, z, pixmap);
+        return;
+    }
     PendingInsert pi;
     pi.x = x;
     pi.y = y;
     pi.z = z;
     pi.pixmap = pixmap;
-    m_pendingInsert.enqueue(pi);
+    pi.synthetic = synthetic;
+    pushPendingInsert(pi);
+    if (!m_insertTimer->isActive()) {
+        m_insertTimer->start();
+    }
+}
+
+void TileMapManager::enqueueInsertBytes(int x, int y, int z, const QByteArray &data)
+{
+    // 解码推迟到插入时，过期层级的数据不再解码；后台模式下瓦片已落盘，还原后从本地加载
+    if (m_background) {
+        m_refreshOnRestore = true;
+        return;
+    }
+    if (z != m_zoom) {
+        if (z == m_stageZoom) {
+            QPixmap pixmap;
+            if (pixmap.loadFromData(data)) stageTile(x, y, z, pixmap);
+        }
+        return;
+    }
+    PendingInsert pi;
+    pi.x = x;
+    pi.y = y;
+    pi.z = z;
+    pi.data = data;
+    pushPendingInsert(pi);
     if (!m_insertTimer->isActive()) {
         m_insertTimer->start();
     }
 }
 
+static bool fartherInsert(const TileMapManager::PendingInsert &a, const TileMapManager::PendingInsert &b)
+{
+    return a.dist > b.dist;
+}
+
+void TileMapManager::pushPendingInsert(PendingInsert &pi)
+{
+    const int dx = pi.x - m_insertCenter.x();
+    const int dy = pi.y - m_insertCenter.y();
+    pi.dist = dx * dx + dy * dy;
+    m_pendingInsert.append(pi);
+    std::push_heap(m_pendingInsert.begin(), m_pendingInsert.end(), fartherInsert);
+}
+
 void TileMapManager::flushPendingInserts()
 {
-    if (!m_scene) {
+    if (!m_scene || !m_tileLayer) {
         m_pendingInsert.clear();
         return;
     }
-    int batch = 0;
+    if (m_background) return;
+    syncLayerZoom();
+
+    QElapsedTimer budget;
+    budget.start();
+
+    // 中心优先：队列是按到中心瓦片距离的堆，中心瓦片变化时才重算距离并重建
+    int centerX, centerY;
+    latLonToTile(m_centerLat, m_centerLon, m_zoom, centerX, centerY);
+    if (QPoint(centerX, centerY) != m_insertCenter) {
+        m_insertCenter = QPoint(centerX, centerY);
+        for (PendingInsert &pi : m_pendingInsert) {
+            const int dx = pi.x - centerX;
+            const int dy = pi.y - centerY;
+            pi.dist = dx * dx + dy * dy;
+        }
+        std::make_heap(m_pendingInsert.begin(), m_pendingInsert.end(), fartherInsert);
+    }
+
     int inserted = 0;
-    const int kMaxPerBatch = 24; // 限制单批量，减小抖动
-    while (!m_pendingInsert.isEmpty() && batch < kMaxPerBatch) {
-        PendingInsert pi = m_pendingInsert.dequeue();
-        // 仅插入当前缩放级别
-        if (pi.z != m_zoom) continue;
-        QGraphicsPixmapItem *item = nullptr;
-        if (!m_itemPool.isEmpty()) {
-            item = m_itemPool.dequeue();
-            item->setPixmap(pi.pixmap);
-            if (item->scene() != m_scene) {
-                m_scene->addItem(item);
+    int dropped = 0;
+    QRectF dirty;
+    const qint64 budgetNs = qint64(m_insertBudgetMs) * 1000000;
+    // 至少插入一张，避免预算过小时饿死
+    while (!m_pendingInsert.isEmpty() && (inserted == 0 || budget.nsecsElapsed() < budgetNs)) {
+        std::pop_heap(m_pendingInsert.begin(), m_pendingInsert.end(), fartherInsert);
+        PendingInsert pi = m_pendingInsert.takeLast();
+        // 仅插入当前缩放级别，且在解码前丢弃；合成瓦片可被真实瓦片覆盖，反之不行
+        if (pi.z != m_zoom || (m_tileLayer->hasTile(pi.x, pi.y)
+                               && (pi.synthetic || !m_tileLayer->isSynthetic(pi.x, pi.y)))) {
+            dropped++;
+            continue;
+        }
+        if (pi.pixmap.isNull() && !pi.data.isEmpty()) {
+            if (!pi.pixmap.loadFromData(pi.data) || pi.pixmap.isNull()) {
+                qCWarning(lcTile) << "Decoded pixmap is null for tile:" << pi.x << pi.y << pi.z;
+                continue;
             }
-            item->setVisible(true);
-            item->setOpacity(1.0);
-        } else {
-            item = m_scene->addPixmap(pi.pixmap);
         }
-        double tileXScene = pi.x * m_tileSize;
-        double tileYScene = pi.y * m_tileSize;
-        item->setPos(tileXScene, tileYScene);
-        TileKey key = {pi.x, pi.y, pi.z};
-        m_tileItems[key] = item;
-        batch++;
+        if (pi.pixmap.isNull()) continue;
+        m_tileLayer->setTile(pi.x, pi.y, pi.pixmap, false, pi.synthetic);
+        dirty |= m_tileLayer->tileRect(pi.x, pi.y);
         inserted++;
     }
+    // 只失效本批插入瓦片矩形的并集
+    if (!dirty.isEmpty()) {
+        m_tileLayer->update(dirty);
+    }
+    if (m_verboseLogging) {
+        TILE_DEBUG() << "Insert flush: inserted" << inserted << "dropped" << dropped
+                 << "remaining" << m_pendingInsert.size()
+                 << "elapsed(ms)" << budget.nsecsElapsed() / 1e6;
+    }
     if (!m_pendingInsert.isEmpty()) {
-        // 继续下一批
+        // 继续下一帧
         m_insertTimer->start();
     }
-    // 强制刷新视图和状态栏（在途数量可能变化）
-    if (m_scene) m_scene->update();
-    emit viewportActivity(m_pendingTiles.size() + m_currentRequests, inserted, true);
+    if (m_tileLayer->isFading() && !m_fadeTimer->isActive()) {
+        m_fadeTimer->start();
+    }
+    // 刷新状态栏（在途数量可能变化）
+    emit viewportActivity(pendingTileCount() + m_currentRequests, inserted, true);
 }
+
 #include "tileworker.h"
 #include <QGraphicsScene>
-#include <QGraphicsPixmapItem>
 #include <QNetworkRequest>
 #include <QUrl>
 #include <QFile>
@@ -78,40 +163,14 @@ void TileMapManager::flushPendingInserts()
 #include <QTextStream>
 #include <QMutex>
 
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
-// 为TileKey提供hash函数
-uint qHash(const TileKey &key, uint /*seed*/)
-{
-    return qHash(key.x) ^ qHash(key.y) ^ qHash(key.z);
-}
-
-// 日志记录函数（懒打开、线程安全、复用文件句柄）
+// 日志记录函数：写入异步日志缓冲，由后台线程落盘
 void logMessage(const QString &message)
 {
-    static QMutex logMutex;
-    QMutexLocker locker(&logMutex);
-    static QFile *logFile = nullptr;
-    static QTextStream *logStream = nullptr;
-    if (!logFile) {
-        logFile = new QFile("tilemap_debug.log");
-        if (logFile->open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
-            logStream = new QTextStream(logFile);
-        } else {
-            delete logFile; logFile = nullptr;
-        }
-    }
-    if (logStream) {
-        (*logStream) << QDateTime::currentDateTime().toString("yyyy-MM-dd hh:mm:ss.zzz")
-                     << " - " << message << "\n";
-        logStream->flush();
-    }
-    qDebug() << "[TileMapManager]" << message;
+    AsyncLogger::log(QStringLiteral("tilemap_debug.log"), message);
+    qCInfo(lcTile) << "[TileMapManager]" << message;
 }
 
-TileMapManager::TileMapManager(QObject *parent)
+TileMapManager::TileMapManager(const QString &cacheDir, QObject *parent)
     : QObject(parent)
     , m_scene(nullptr)
     , m_networkManager(new QNetworkAccessManager(this))
@@ -125,14 +184,11 @@ TileMapManager::TileMapManager(QObject *parent)
     , m_viewportTilesY(5)
     , m_viewWidth(800)   // 默认视图宽度
     , m_viewHeight(600)  // 默认视图高度
-    , m_regionDownloadTotal(0)
-    , m_regionDownloadCurrent(0)
     , m_workerThread(nullptr)
     , m_worker(nullptr)
     , m_processTimer(new QTimer(this))
     , m_insertTimer(new QTimer(this))
     , m_isProcessing(false)
-    , m_downloadFinishedEmitted(false)
     , m_maxConcurrentRequests(10)  // 增加同时处理的请求数量到5，提高下载效率
     , m_currentRequests(0)
 {
@@ -141,7 +197,7 @@ TileMapManager::TileMapManager(QObject *parent)
     // 注册元类型
     qRegisterMetaType<QPixmap>("QPixmap");
     qRegisterMetaType<QString>("QString");
-    qRegisterMetaType<TileInfo>("TileInfo");
+    qRegisterMetaType<TileId>("TileId");
     
     // 创建缓存目录 - 使用项目根目录下的tilemap文件夹
     // 获取项目根目录（从当前工作目录向上查找，直到找到.pro文件）
@@ -154,7 +210,8 @@ TileMapManager::TileMapManager(QObject *parent)
         projectRoot = dir.absolutePath();
     }
     
-    m_cacheDir = projectRoot + "/tilemap";
+    // 配置中指定了缓存目录时直接使用，避免先扫描默认目录再重建
+    m_cacheDir = cacheDir.isEmpty() ? projectRoot + "/tilemap" : cacheDir;
     if (m_verboseLogging) {
         logMessage(QString("Current working directory: %1").arg(QDir::currentPath()));
         logMessage(QString("Project root directory: %1").arg(projectRoot));
@@ -174,6 +231,27 @@ TileMapManager::TileMapManager(QObject *parent)
         if (m_verboseLogging) logMessage("Cache directory already exists");
     }
     
+    // 在线程池构建缓存覆盖索引，之后的存在性/最大层级/祖先查询不再遍历目录
+    rebuildIndex();
+    
+    // 批量下载抓取器：与视图共用缓存目录和覆盖索引，新下载的当前层级瓦片直接排队显示
+    m_fetcher = new TileFetcher(&m_pyramid, this);
+    m_fetcher->setTileSource(m_tileUrlTemplate);
+    m_fetcher->setServerList(m_servers);
+    m_fetcher->setCacheDir(m_cacheDir);
+    connect(m_fetcher, &TileFetcher::tileFetched, this, [this](int x, int y, int z, const QByteArray &data) {
+        if (m_scene && z == m_zoom) enqueueInsertBytes(x, y, z, data);
+    });
+
+    // 本地生成的低层级瓦片写入同一缓存；完成后刷新视图以显示当前层级新出现的瓦片
+    m_pyramidBuilder = new PyramidBuilder(&m_pyramid, this);
+    m_pyramidBuilder->setCacheDir(m_cacheDir);
+    connect(m_pyramidBuilder, &PyramidBuilder::finished, this, [this]() {
+        if (m_scene) loadTiles();
+    });
+
+    m_netClock.start();
+
     // 设置处理定时器
     m_processTimer->setSingleShot(true);
     connect(m_processTimer, &QTimer::timeout, this, &TileMapManager::processNextBatch);
@@ -181,6 +259,11 @@ TileMapManager::TileMapManager(QObject *parent)
     m_insertTimer->setSingleShot(true);
     m_insertTimer->setInterval(16); // ~60fps 合并
     connect(m_insertTimer, &QTimer::timeout, this, &TileMapManager::flushPendingInserts);
+    m_fadeTimer = new QTimer(this);
+    m_fadeTimer->setInterval(16);
+    connect(m_fadeTimer, &QTimer::timeout, this, [this]() {
+        if (!m_scene || !m_tileLayer || !m_tileLayer->advanceFade()) m_fadeTimer->stop();
+    });
     
     // 启动工作线程
     startWorkerThread();
@@ -198,11 +281,11 @@ TileMapManager::~TileMapManager()
     }
     
     // 等待所有下载任务完成后再停止工作线程
-    if (m_isProcessing && (m_currentRequests > 0 || !m_pendingTiles.isEmpty())) {
+    if (m_isProcessing && (m_currentRequests > 0 || hasPendingTiles())) {
         qDebug() << "Waiting for downloads to complete before stopping worker thread";
         // 等待最多30秒让下载任务完成
         QTime waitTime = QTime::currentTime().addSecs(30);
-        while ((m_currentRequests > 0 || !m_pendingTiles.isEmpty()) && QTime::currentTime() < waitTime) {
+        while ((m_currentRequests > 0 || hasPendingTiles()) && QTime::currentTime() < waitTime) {
             QCoreApplication::processEvents(QEventLoop::AllEvents, 100);
         }
     }
@@ -210,8 +293,8 @@ TileMapManager::~TileMapManager()
     // 停止工作线程
     stopWorkerThread();
     
-    // 清理资源
-    cleanupTiles();
+    // 清理资源（图层项归场景所有，随场景销毁）
+    m_pendingInsert.clear();
 }
 
 void TileMapManager::startWorkerThread()
@@ -228,17 +311,22 @@ void TileMapManager::startWorkerThread()
             connect(this, &TileMapManager::requestDownloadTile, m_worker, &TileWorker::downloadAsync);
             // 将重试参数传给 worker
             QMetaObject::invokeMethod(m_worker, "configureNetworkRetries", Qt::QueuedConnection,
-                                      Q_ARG(int,  qMax(1, 3)),
-                                      Q_ARG(int, 3000));
+                                      Q_ARG(int, m_retryMax),
+                                      Q_ARG(int, m_backoffInitialMs));
         } else {
             connect(this, &TileMapManager::requestDownloadTile, m_worker, &TileWorker::downloadAndSaveTile);
         }
         connect(this, &TileMapManager::requestLoadTile, m_worker, &TileWorker::loadTileFromFile);
         connect(m_worker, &TileWorker::tileDownloaded, this, &TileMapManager::onTileDownloaded);
+        connect(m_worker, &TileWorker::downloadStarted, this, [this](int x, int y, int z) {
+            noteDownloadStarted(TileId(x, y, z));
+        });
         // 为避免跨线程 QPixmap 风险，优先使用字节流处理；保留旧信号以兼容。
         // connect(m_worker, &TileWorker::tileLoaded, this, &TileMapManager::onTileLoaded);
         // 新增：使用字节流跨线程传递，再在主线程构建 QPixmap
         connect(m_worker, &TileWorker::tileLoadedBytes, this, &TileMapManager::onTileLoadedBytes);
+        connect(this, &TileMapManager::requestSynthesizeTile, m_worker, &TileWorker::synthesizeTile);
+        connect(m_worker, &TileWorker::tileSynthesized, this, &TileMapManager::onTileSynthesized);
         
         m_workerThread->start();
         qDebug() << "Worker thread started";
@@ -249,7 +337,7 @@ void TileMapManager::stopWorkerThread()
 {
     if (m_workerThread) {
         qDebug() << "Stopping worker thread, current requests:" << m_currentRequests 
-                 << "pending tiles:" << m_pendingTiles.size();
+                 << "pending tiles:" << pendingTileCount();
         m_workerThread->quit();
         // 等待线程结束，最多等待5秒
         if (!m_workerThread->wait(5000)) {
@@ -266,6 +354,99 @@ void TileMapManager::stopWorkerThread()
 void TileMapManager::initScene(QGraphicsScene *scene)
 {
     m_scene = scene;
+    if (!m_scene) return;
+    m_tileLayer = new TileLayerItem(m_tileSize);
+    m_tileLayer->setZoom(m_zoom);
+    m_tileLayer->setStatsLogging(m_verboseLogging);
+    m_scene->addItem(m_tileLayer);
+}
+
+void TileMapManager::setVerboseLogging(bool enable)
+{
+    m_verboseLogging = enable;
+    // 逐瓦片调试输出（TILE_DEBUG）随详细日志开关；只改本分类，不覆盖 QT_LOGGING_RULES 等其它规则
+    lcTile().setEnabled(QtDebugMsg, enable);
+    // 详细日志时同时输出图层绘制耗时统计
+    if (m_tileLayer) m_tileLayer->setStatsLogging(enable);
+    // 首次开启时输出一次批量投影的精度与耗时
+    static bool projectionChecked = false;
+    if (enable && !projectionChecked) {
+        projectionChecked = true;
+        const WebMercator::BenchResult b = WebMercator::benchmark();
+        logMessage(QString("WebMercator batch: simd=%1 points=%2 maxErr=%3 scalar=%4ns batch=%5ns")
+                   .arg(b.simd).arg(b.points).arg(b.maxError, 0, 'g', 3)
+                   .arg(b.scalarNsPerPoint, 0, 'f', 1).arg(b.batchNsPerPoint, 0, 'f', 1));
+    }
+}
+
+void TileMapManager::syncLayerZoom()
+{
+    if (m_scene && m_tileLayer && m_tileLayer->zoom() != m_zoom) {
+        m_tileLayer->setZoom(m_zoom);
+        m_synthRequested.clear();
+        m_stageZoom = -1;
+    }
+}
+
+void TileMapManager::stageZoom(int zoom)
+{
+    if (zoom == m_stageZoom) return;
+    cancelStagedZoom();
+    if (!m_tileLayer || zoom == m_zoom || zoom < qMax(3, getDynamicMinZoom()) || zoom > getMaxZoom()) return;
+    m_stageZoom = zoom;
+    // 切换时视图残差约为 ∓0.5 层，可见范围约为视口的 √2 倍
+    int cx, cy;
+    latLonToTile(m_centerLat, m_centerLon, zoom, cx, cy);
+    const int hx = int(std::ceil(m_viewWidth * std::sqrt(2.0) / (2.0 * m_tileSize)));
+    const int hy = int(std::ceil(m_viewHeight * std::sqrt(2.0) / (2.0 * m_tileSize)));
+    const int maxTile = (1 << zoom) - 1;
+    m_stageRange = QRect(QPoint(qMax(0, cx - hx), qMax(0, cy - hy)),
+                         QPoint(qMin(maxTile, cx + hx), qMin(maxTile, cy + hy)));
+    for (int y = m_stageRange.top(); y <= m_stageRange.bottom(); ++y) {
+        for (int x = m_stageRange.left(); x <= m_stageRange.right(); ++x) {
+            if (!tileExists(x, y, zoom)) continue; // 未缓存的瓦片不等待，切换后照常下载/合成
+            m_stageExpected++;
+            m_currentRequests++;
+            emit requestLoadTile(x, y, zoom, getTilePath(x, y, zoom));
+        }
+    }
+    TILE_DEBUG() << "Staging zoom" << zoom << "range" << m_stageRange << "cached tiles" << m_stageExpected;
+    checkStageReady(); // 无可读入的瓦片时立即就绪
+}
+
+void TileMapManager::cancelStagedZoom()
+{
+    m_stageZoom = -1;
+    m_stageExpected = 0;
+    m_stageReadySent = false;
+    if (m_tileLayer) m_tileLayer->clearStaged();
+}
+
+double TileMapManager::stagedFraction() const
+{
+    if (m_stageZoom < 0 || !m_tileLayer) return 0.0;
+    if (m_stageExpected == 0) return 1.0;
+    int staged = 0;
+    for (int y = m_stageRange.top(); y <= m_stageRange.bottom(); ++y) {
+        for (int x = m_stageRange.left(); x <= m_stageRange.right(); ++x) {
+            if (m_tileLayer->hasStagedTile(m_stageZoom, x, y)) staged++;
+        }
+    }
+    return double(staged) / m_stageExpected;
+}
+
+void TileMapManager::stageTile(int x, int y, int z, const QPixmap &pixmap)
+{
+    if (!m_tileLayer || z != m_stageZoom) return;
+    m_tileLayer->setStagedTile(z, x, y, pixmap);
+    checkStageReady();
+}
+
+void TileMapManager::checkStageReady()
+{
+    if (m_stageZoom < 0 || m_stageReadySent || stagedFraction() < m_zoomHoldThreshold) return;
+    m_stageReadySent = true;
+    emit zoomStageReady(m_stageZoom);
 }
 
 void TileMapManager::setCenter(double lat, double lon)
@@ -285,7 +466,7 @@ void TileMapManager::setZoomAtMousePosition(int zoom, double sceneX, double scen
     if (!m_scene) return;
     
     int oldZoom = m_zoom;
-    int newZoom = qBound(qMax(3, getDynamicMinZoom()), zoom, 10);
+    int newZoom = qBound(qMax(3, getDynamicMinZoom()), zoom, getMaxZoom());
     
     if (m_verboseLogging) logMessage(QString("=== ZOOM %1->%2 === Mouse:(%3,%4) Viewport:%5x%6")
         .arg(oldZoom).arg(newZoom).arg(mouseViewportX).arg(mouseViewportY).arg(viewportWidth).arg(viewportHeight));
@@ -301,15 +482,11 @@ void TileMapManager::setZoomAtMousePosition(int zoom, double sceneX, double scen
     // mouseTile_new = mouseTile_old * 2^(newZoom - oldZoom)
     // centerTile_new = mouseTile_new - offset (偏移保持不变，因为视口大小不变)
     
-    // 步骤1：获取旧缩放级别的中心瓦片
-    int centerTileX_old, centerTileY_old;
-    latLonToTile(m_centerLat, m_centerLon, oldZoom, centerTileX_old, centerTileY_old);
-    
-    // 加上小数部分（高精度）
+    // 步骤1：获取旧缩放级别的中心瓦片（浮点，高精度）
     int n_old = 1 << oldZoom;
-    double centerTileX_old_precise = (m_centerLon + 180.0) / 360.0 * n_old;
-    double lat_rad_old = m_centerLat * M_PI / 180.0;
-    double centerTileY_old_precise = (1.0 - log(tan(lat_rad_old) + 1.0 / cos(lat_rad_old)) / M_PI) / 2.0 * n_old;
+    const QPointF centerTile_old = WebMercator::project(m_centerLon, m_centerLat, n_old);
+    double centerTileX_old_precise = centerTile_old.x();
+    double centerTileY_old_precise = centerTile_old.y();
     
     // 步骤2：计算鼠标相对于视口中心的偏移（瓦片单位）
     double mouseOffsetX_pixels = mouseViewportX - viewportWidth / 2.0;
@@ -322,9 +499,8 @@ void TileMapManager::setZoomAtMousePosition(int zoom, double sceneX, double scen
     double mouseTileY_old = centerTileY_old_precise + mouseOffsetY_tiles;
     
     // 转换为地理坐标（验证用）
-    double mouseLon_old = mouseTileX_old / n_old * 360.0 - 180.0;
-    double lat_rad = atan(sinh(M_PI * (1.0 - 2.0 * mouseTileY_old / n_old)));
-    double mouseLat_old = lat_rad * 180.0 / M_PI;
+    double mouseLon_old = WebMercator::xToLon(mouseTileX_old / n_old);
+    double mouseLat_old = WebMercator::yToLat(mouseTileY_old / n_old);
     
     // 步骤4：缩放瓦片坐标
     m_zoom = newZoom;
@@ -340,9 +516,8 @@ void TileMapManager::setZoomAtMousePosition(int zoom, double sceneX, double scen
     
     // 步骤6：转换为地理坐标
     int n_new = 1 << newZoom;
-    m_centerLon = centerTileX_new / n_new * 360.0 - 180.0;
-    double lat_rad_new = atan(sinh(M_PI * (1.0 - 2.0 * centerTileY_new / n_new)));
-    m_centerLat = lat_rad_new * 180.0 / M_PI;
+    m_centerLon = WebMercator::xToLon(centerTileX_new / n_new);
+    m_centerLat = WebMercator::yToLat(centerTileY_new / n_new);
     
     if (m_verboseLogging) logMessage(QString("  Offset:(%1,%2) MouseGEO:(%3,%4) -> NewCenter:(%5,%6)")
         .arg(mouseOffsetX_tiles, 0, 'f', 3)
@@ -372,20 +547,17 @@ void TileMapManager::panByPixels(double deltaViewportX, double deltaViewportY)
 
     // 当前中心的瓦片小数坐标
     int n = 1 << m_zoom;
-    double centerTileX = (m_centerLon + 180.0) / 360.0 * n;
-    double lat_rad = m_centerLat * M_PI / 180.0;
-    double centerTileY = (1.0 - log(tan(lat_rad) + 1.0 / cos(lat_rad)) / M_PI) / 2.0 * n;
+    const QPointF centerTile = WebMercator::project(m_centerLon, m_centerLat, n);
 
     // 平移后中心
-    double newTileX = centerTileX + deltaTilesX;
-    double newTileY = centerTileY + deltaTilesY;
+    double newTileX = centerTile.x() + deltaTilesX;
+    double newTileY = centerTile.y() + deltaTilesY;
     newTileX = qBound(0.0, newTileX, (double)(n - 1));
     newTileY = qBound(0.0, newTileY, (double)(n - 1));
 
     // 转回经纬度
-    m_centerLon = newTileX / n * 360.0 - 180.0;
-    double lat_rad_new = atan(sinh(M_PI * (1.0 - 2.0 * newTileY / n)));
-    m_centerLat = lat_rad_new * 180.0 / M_PI;
+    m_centerLon = WebMercator::xToLon(newTileX / n);
+    m_centerLat = WebMercator::yToLat(newTileY / n);
 
     // 立即重排并按新中心计算可见瓦片
     repositionTiles();
@@ -413,10 +585,9 @@ void TileMapManager::sceneToLatLon(double sceneX, double sceneY, int zoom, doubl
     tileY = qBound(0.0, tileY, (double)maxTile);
     
     // 将瓦片坐标（小数）转换为经纬度
-    int n = 1 << zoom;
-    lon = tileX / n * 360.0 - 180.0;
-    double latRad = atan(sinh(M_PI * (1 - 2 * tileY / n)));
-    lat = latRad * 180.0 / M_PI;
+    const QPointF ll = WebMercator::unproject(tileX, tileY, maxTilesAtZoom);
+    lon = ll.x();
+    lat = ll.y();
     
     if (m_verboseLogging) logMessage(QString("sceneToLatLon(abs): scene(%1,%2) -> tile(%3,%4) -> geo(%5,%6)")
                .arg(sceneX, 0, 'f', 2).arg(sceneY, 0, 'f', 2)
@@ -441,11 +612,11 @@ void TileMapManager::updateTilesForView(double sceneX, double sceneY)
     // 根据缩放级别动态调整阈值，高缩放级别需要更小的阈值
     double threshold = 1.0 / (1 << m_zoom);  // 优化阈值计算
     if (latDiff < threshold && lonDiff < threshold) {
-        qDebug() << "Movement within preloaded area, skipping update. Diff:" << latDiff << "," << lonDiff << "Threshold:" << threshold;
+        TILE_DEBUG() << "Movement within preloaded area, skipping update. Diff:" << latDiff << "," << lonDiff << "Threshold:" << threshold;
         return;
     }
     
-    qDebug() << "Movement exceeded threshold, loading new tiles. Diff:" << latDiff << "," << lonDiff;
+    TILE_DEBUG() << "Movement exceeded threshold, loading new tiles. Diff:" << latDiff << "," << lonDiff;
     
     // 更新中心点（使用最新视图几何来刷新布局缓存）
     m_centerLat = newLat;
@@ -454,7 +625,7 @@ void TileMapManager::updateTilesForView(double sceneX, double sceneY)
         m_generationId++;
     }
     
-    qDebug() << "Updating tiles for new center:" << m_centerLat << "," << m_centerLon;
+    TILE_DEBUG() << "Updating tiles for new center:" << m_centerLat << "," << m_centerLon;
     
     // 仅计算并加载可见瓦片（绝对定位无需重排，减少拖拽抖动）
     calculateVisibleTiles();
@@ -536,7 +707,7 @@ int TileMapManager::getDynamicMinZoom() const
 void TileMapManager::setZoom(int zoom)
 {
     int oldZoom = m_zoom;
-    m_zoom = qBound(qMax(3, getDynamicMinZoom()), zoom, 10);  // 限制为3-10
+    m_zoom = qBound(qMax(3, getDynamicMinZoom()), zoom, getMaxZoom());
     
     // 在设置新的缩放级别后，先清理不需要的瓦片
     cleanupTiles();
@@ -554,16 +725,17 @@ void TileMapManager::setZoom(int zoom)
     
     // 重新加载瓦片
     loadTiles();
-    
-    // 重置区域下载计数器，因为缩放级别改变后之前的区域下载任务已无效
-    m_regionDownloadTotal = 0;
-    m_regionDownloadCurrent = 0;
-    m_downloadFinishedEmitted = false;
 }
 
 void TileMapManager::loadTiles()
 {
     if (!m_scene) return;
+    // 后台模式不做同步读盘与请求，还原时统一补算
+    if (m_background) {
+        m_refreshOnRestore = true;
+        m_refreshAllowDownload = true;
+        return;
+    }
     
     // 先根据当前中心重新定位已存在的瓦片，避免拖拽后旧瓦片位置错误
     repositionTiles();
@@ -572,114 +744,25 @@ void TileMapManager::loadTiles()
     calculateVisibleTiles();
 }
 
-void TileMapManager::downloadRegion(double minLat, double maxLat, double minLon, double maxLon, int minZoom, int maxZoom)
-{
-    logMessage("TileMapManager::downloadRegion called");
-    logMessage(QString("Starting region download:"));
-    logMessage(QString("  Lat range: %1 to %2").arg(minLat).arg(maxLat));
-    logMessage(QString("  Lon range: %1 to %2").arg(minLon).arg(maxLon));
-    logMessage(QString("  Zoom range: %1 to %2").arg(minZoom).arg(maxZoom));
-    
-    // 清空之前的下载队列
-    m_pendingTiles.clear();
-    
-    // 重置计数器
-    m_regionDownloadTotal = 0;
-    m_regionDownloadCurrent = 0;
-    m_downloadFinishedEmitted = false;
-    m_currentRequests = 0;
-    
-    // 计算所有层级的瓦片并添加到下载队列
-    for (int zoom = minZoom; zoom <= maxZoom; zoom++) {
-        int minTileX, minTileY, maxTileX, maxTileY;
-        latLonToTile(maxLat, minLon, zoom, minTileX, minTileY); // 注意：maxLat对应minTileY
-        latLonToTile(minLat, maxLon, zoom, maxTileX, maxTileY); // 注意：minLat对应maxTileY
-        
-        // 确保坐标顺序正确
-        if (minTileX > maxTileX) qSwap(minTileX, maxTileX);
-        if (minTileY > maxTileY) qSwap(minTileY, maxTileY);
-        
-        // 限制瓦片范围
-        int maxTile = (1 << zoom) - 1;
-        minTileX = qMax(0, minTileX);
-        minTileY = qMax(0, minTileY);
-        maxTileX = qMin(maxTile, maxTileX);
-        maxTileY = qMin(maxTile, maxTileY);
-        
-        int totalTileCount = (maxTileX - minTileX + 1) * (maxTileY - minTileY + 1);
-        int downloadTileCount = 0; // 需要下载的瓦片数量
-        int existingTileCount = 0; // 已存在的瓦片数量
-        
-        // 优化：只将需要下载的瓦片添加到队列，已存在的瓦片直接计入进度
-        for (int x = minTileX; x <= maxTileX; x++) {
-            for (int y = minTileY; y <= maxTileY; y++) {
-                // 检查瓦片是否已存在
-                if (!tileExists(x, y, zoom)) {
-                    // 瓦片不存在，添加到下载队列
-                    TileInfo info;
-                    info.x = x;
-                    info.y = y;
-                    info.z = zoom;
-                    info.url = getTileUrl(x, y, zoom);
-                    info.filePath = getTilePath(x, y, zoom);
-                    m_pendingTiles.enqueue(info);
-                    downloadTileCount++;
-                } else {
-                    // 瓦片已存在，直接计入完成进度
-                    existingTileCount++;
-                    m_regionDownloadCurrent++;  // 已存在的瓦片直接计为已完成
-                }
-            }
-        }
-        
-        // 计算所有需要处理的瓦片（包括已存在的和需要下载的）
-        m_regionDownloadTotal += totalTileCount;
-        logMessage(QString("  Zoom %1: tiles from (%2,%3) to (%4,%5), total %6, existing %7 (skipped), need download %8").arg(zoom).arg(minTileX).arg(minTileY).arg(maxTileX).arg(maxTileY).arg(totalTileCount).arg(existingTileCount).arg(downloadTileCount));
-    }
-    
-    logMessage(QString("Total tiles to process: %1, already completed: %2, need download: %3")
-               .arg(m_regionDownloadTotal)
-               .arg(m_regionDownloadCurrent)
-               .arg(m_pendingTiles.size()));
-    
-    // 发送初始进度（显示已存在的瓦片进度）
-    if (m_regionDownloadCurrent > 0) {
-        emit regionDownloadProgress(m_regionDownloadCurrent, m_regionDownloadTotal, minZoom);
-    }
-    
-    if (m_pendingTiles.isEmpty()) {
-        logMessage("All tiles already exist locally, emitting downloadFinished");
-        m_downloadFinishedEmitted = true;
-        emit downloadFinished();
-        return;
-    }
-    
-    // 开始处理过程
-    logMessage("Starting download process");
-    m_isProcessing = true;
-    m_processTimer->start(0); // 立即开始处理
-}
-
 void TileMapManager::processNextBatch()
 {
-    qDebug() << "processNextBatch called, isProcessing:" << m_isProcessing 
-             << "pendingTiles:" << m_pendingTiles.size() 
+    TILE_DEBUG() << "processNextBatch called, isProcessing:" << m_isProcessing 
+             << "pendingTiles:" << pendingTileCount() 
              << "currentRequests:" << m_currentRequests;
     
-    if (!m_isProcessing && m_pendingTiles.isEmpty()) {
+    if (!m_isProcessing && !hasPendingTiles()) {
         return;
     }
     
     // 检查是否所有瓦片都已处理完毕
-    if (m_pendingTiles.isEmpty() && m_currentRequests == 0) {
-        qDebug() << "All tiles processed, calling checkAndEmitDownloadFinished";
-        checkAndEmitDownloadFinished();
+    if (!hasPendingTiles() && m_currentRequests == 0) {
+        checkDownloadsIdle();
         return;
     }
     
     // 检查是否达到最大并发请求数
     if (m_currentRequests >= m_maxConcurrentRequests) {
-        qDebug() << "Max concurrent requests reached, waiting";
+        TILE_DEBUG() << "Max concurrent requests reached, waiting";
         // 确保定时器不会重复启动
         if (!m_processTimer->isActive()) {
             m_processTimer->start(100); // 缩短等待时间到100ms
@@ -687,25 +770,32 @@ void TileMapManager::processNextBatch()
         return;
     }
     
-    // 处理一个瓦片（队列中只包含需要下载的瓦片）
-    if (!m_pendingTiles.isEmpty() && m_currentRequests < m_maxConcurrentRequests) {
-        TileInfo info = m_pendingTiles.dequeue();
+    // 队列已空，等待在途请求回调
+    if (!hasPendingTiles()) {
+        if (!m_processTimer->isActive()) m_processTimer->start(100);
+        return;
+    }
+    
+    // 处理一个瓦片（队列中只包含需要下载的瓦片）；低层级覆盖瓦片的队列优先
+    if (hasPendingTiles() && m_currentRequests < m_maxConcurrentRequests) {
+        const TileId id = !m_coarsePending.isEmpty() ? m_coarsePending.dequeue() : m_pendingTiles.dequeue();
+        // URL/路径在出队时生成，队列只保存 8 字节键
+        const QString url = getTileUrl(id);
         
-        qDebug() << "Processing tile:" << info.x << info.y << info.z << "URL:" << info.url;
-        qDebug() << "Remaining tiles in queue:" << m_pendingTiles.size();
+        TILE_DEBUG() << "Processing tile:" << id.x() << id.y() << id.z() << "URL:" << url;
+        TILE_DEBUG() << "Remaining tiles in queue:" << pendingTileCount();
         
         // 队列中的瓦片都是需要下载的，直接下载
-        qDebug() << "Downloading tile:" << info.x << info.y << info.z;
         m_currentRequests++;
-        emit requestDownloadTile(info.x, info.y, info.z, info.url, info.filePath);
+        emit requestDownloadTile(id.x(), id.y(), id.z(), url, getTilePath(id));
         // 立刻通报视口下载状态（剩余待下 + 在途）
-        emit viewportActivity(m_pendingTiles.size() + m_currentRequests, /*loaded*/0, /*downloading*/ true);
+        emit viewportActivity(pendingTileCount() + m_currentRequests, /*loaded*/0, /*downloading*/ true);
         
         // 继续处理下一个批次
-        if (!m_pendingTiles.isEmpty() || m_currentRequests > 0) {
+        if (hasPendingTiles() || m_currentRequests > 0) {
             // 确保定时器不会重复启动
             if (!m_processTimer->isActive()) {
-                qDebug() << "Starting process timer for next batch";
+                TILE_DEBUG() << "Starting process timer for next batch";
                 m_processTimer->start(100); // 缩短间隔到100ms，提高响应速度
             }
         }
@@ -715,85 +805,54 @@ void TileMapManager::processNextBatch()
 void TileMapManager::onTileDownloaded(int x, int y, int z, const QByteArray &data, bool success, const QString &errorString)
 {
     QElapsedTimer t; if (m_verboseLogging) t.start();
-    qDebug() << "TileMapManager::onTileDownloaded called for tile:" << x << y << z << "success:" << success;
+    TILE_DEBUG() << "TileMapManager::onTileDownloaded called for tile:" << x << y << z << "success:" << success;
     
     QMutexLocker locker(&m_mutex);
     
     // 减少当前请求数（确保不会小于0）
     m_currentRequests = qMax(0, m_currentRequests - 1);
-    
-    // 只有在区域下载模式下才更新进度计数器
-    bool isRegionDownloadMode = (m_regionDownloadTotal > 0);
-    if (isRegionDownloadMode) {
-        // 只有实际下载成功时才更新进度计数器（本地加载不计数）
-        if (success) {
-            m_regionDownloadCurrent++;
-            qDebug() << "Updated process count (download):" << m_regionDownloadCurrent << "/" << m_regionDownloadTotal;
-        } else {
-            qDebug() << "Download failed, not updating progress count";
-        }
-    }
+    const TileId id(x, y, z);
+    const bool timed = m_downloadStart.contains(id);
+    const qint64 startedAt = m_downloadStart.take(id);
+    const bool coarse = m_coarseRequested.remove(id);
     
     if (success) {
-        qDebug() << "Tile downloaded successfully, saving data size:" << data.size();
+        TILE_DEBUG() << "Tile downloaded successfully, saving data size:" << data.size();
+        // 单瓦片耗时（自 worker 真正发出请求起，不含排队）计入滑动平均，供渐进加载估算
+        if (timed) {
+            const double ms = double(m_netClock.elapsed() - startedAt);
+            m_downloadEwmaMs = m_downloadEwmaMs > 0.0 ? 0.8 * m_downloadEwmaMs + 0.2 * ms : ms;
+        }
         // 保存瓦片到本地
         saveTile(x, y, z, data);
         emit tileCached(x, y, z, true);
         
-        // 下载完成后，若与当前视图层级一致则立即显示
+        // 下载完成后，若与当前视图层级一致则排队显示（插入时再解码）
         if (m_scene && z == m_zoom) {
+            enqueueInsertBytes(x, y, z, data);
+        } else if (coarse && m_tileLayer && !m_background && z < m_zoom && m_zoom - z <= kProgressiveLevels) {
+            // 低层级覆盖瓦片：放大作占位，细化瓦片到达后覆盖
             QPixmap pixmap;
-            pixmap.loadFromData(data);
-            if (!pixmap.isNull()) {
-                enqueueInsert(x, y, z, pixmap);
-            }
+            if (pixmap.loadFromData(data)) m_tileLayer->setFallbackTile(z, x, y, pixmap);
         }
     } else {
-        qDebug() << "Tile download failed:" << errorString;
+        qCWarning(lcTile) << "Tile download failed:" << errorString;
         emit tileCached(x, y, z, false);
     }
     
-    // 只有在区域下载模式下才发送进度信号
-    if (isRegionDownloadMode) {
-        // 发送区域处理进度信号
-        qDebug() << "Emitting regionDownloadProgress signal:" << m_regionDownloadCurrent << "/" << m_regionDownloadTotal << "zoom:" << z;
-        emit regionDownloadProgress(m_regionDownloadCurrent, m_regionDownloadTotal, z);
-        
-        // 检查是否所有任务都已完成
-        if (m_regionDownloadTotal > 0 && m_regionDownloadCurrent >= m_regionDownloadTotal && m_currentRequests == 0) {
-            if (!m_downloadFinishedEmitted) {
-                m_downloadFinishedEmitted = true;
-                m_isProcessing = false;
-                emit downloadFinished();
-            }
-        } else {
-            // 维持处理流程
-            if (m_isProcessing && (m_pendingTiles.size() > 0 || m_currentRequests > 0)) {
-                // 确保定时器不会重复启动
-                if (!m_processTimer->isActive()) {
-                    qDebug() << "Starting process timer after tile download";
-                    m_processTimer->start(100);
-                }
-            } else if (m_pendingTiles.isEmpty() && m_currentRequests == 0) {
-                // 所有任务完成，发送完成信号
-                if (!m_downloadFinishedEmitted) {
-                    m_downloadFinishedEmitted = true;
-                    m_isProcessing = false;
-                    emit downloadFinished();
-                }
-            }
-    // 非区域下载：也通报下载状态（剩余待下 + 在途），便于状态栏刷新
-    if (!isRegionDownloadMode) {
-        emit viewportActivity(m_pendingTiles.size() + m_currentRequests, /*loaded*/0, /*downloading*/ true);
-    }
-        }
+    // 维持处理流程并通报剩余待下 + 在途；全部完成时停止并刷新状态栏
+    if (m_isProcessing && hasPendingTiles() && !m_processTimer->isActive()) m_processTimer->start(100);
+    if (hasPendingTiles() || m_currentRequests > 0) {
+        emit viewportActivity(pendingTileCount() + m_currentRequests, /*loaded*/0, /*downloading*/ true);
+    } else {
+        checkDownloadsIdle();
     }
-    if (m_verboseLogging) qDebug() << "onTileDownloaded elapsed(ms)=" << t.elapsed();
+    if (m_verboseLogging) TILE_DEBUG() << "onTileDownloaded elapsed(ms)=" << t.elapsed();
 }
 
 void TileMapManager::onTileLoaded(int x, int y, int z, const QPixmap &pixmap, bool success, const QString &errorString)
 {
-    qDebug() << "onTileLoaded called for tile:" << x << y << z << "success:" << success;
+    TILE_DEBUG() << "onTileLoaded called for tile:" << x << y << z << "success:" << success;
     
     QMutexLocker locker(&m_mutex);
     
@@ -801,7 +860,7 @@ void TileMapManager::onTileLoaded(int x, int y, int z, const QPixmap &pixmap, bo
     m_currentRequests = qMax(0, m_currentRequests - 1);
     
     if (success && !pixmap.isNull()) {
-        qDebug() << "Tile loaded successfully from local file";
+        TILE_DEBUG() << "Tile loaded successfully from local file";
         // 创建图片项（仅在场景存在时添加）
         if (m_scene) {
             enqueueInsert(x, y, z, pixmap);
@@ -809,7 +868,7 @@ void TileMapManager::onTileLoaded(int x, int y, int z, const QPixmap &pixmap, bo
         // 本地加载也视为已缓存，通知调度层更新进度
         emit tileCached(x, y, z, true);
     } else {
-        qDebug() << "Tile load failed:" << errorString;
+        qCWarning(lcTile) << "Tile load failed:" << errorString;
         emit tileCached(x, y, z, false);
     }
     
@@ -820,128 +879,111 @@ void TileMapManager::onTileLoaded(int x, int y, int z, const QPixmap &pixmap, bo
 void TileMapManager::onTileLoadedBytes(int x, int y, int z, const QByteArray &data, bool success, const QString &errorString)
 {
     QElapsedTimer t; if (m_verboseLogging) t.start();
-    qDebug() << "onTileLoadedBytes called for tile:" << x << y << z << "success:" << success;
+    TILE_DEBUG() << "onTileLoadedBytes called for tile:" << x << y << z << "success:" << success;
     QMutexLocker locker(&m_mutex);
     m_currentRequests = qMax(0, m_currentRequests - 1);
     if (success && !data.isEmpty()) {
-        // 主线程中构建 QPixmap
-        QPixmap pixmap;
-        bool ok = pixmap.loadFromData(data);
-        if (!ok || pixmap.isNull()) {
-            qDebug() << "Decoded pixmap is null for tile:" << x << y << z;
-            emit tileCached(x, y, z, false);
-        } else {
-            if (m_scene) {
-                enqueueInsert(x, y, z, pixmap);
-            }
-            emit tileCached(x, y, z, true);
+        // 主线程按帧预算解码插入；非当前层级不解码
+        if (m_scene) {
+            enqueueInsertBytes(x, y, z, data);
         }
+        emit tileCached(x, y, z, true);
     } else {
-        qDebug() << "Tile load bytes failed:" << errorString;
+        qCWarning(lcTile) << "Tile load bytes failed:" << errorString;
         emit tileCached(x, y, z, false);
     }
-    if (m_verboseLogging) qDebug() << "onTileLoadedBytes elapsed(ms)=" << t.elapsed();
+    if (m_verboseLogging) TILE_DEBUG() << "onTileLoadedBytes elapsed(ms)=" << t.elapsed();
 }
 
-void TileMapManager::checkAndEmitDownloadFinished()
+void TileMapManager::checkDownloadsIdle()
 {
-    // 添加额外的安全检查，防止死循环
-    if (m_currentRequests < 0) {
-        m_currentRequests = 0;  // 修正计数器
-    }
-    
-    // 检查是否所有任务都已完成
-    if (m_regionDownloadTotal > 0 && m_regionDownloadCurrent >= m_regionDownloadTotal && m_currentRequests == 0) {
-        if (!m_downloadFinishedEmitted) {
-            m_downloadFinishedEmitted = true;
-            m_isProcessing = false;
-            emit downloadFinished();
-        }
-    } else if (m_downloadFinishedEmitted && m_currentRequests == 0 && m_pendingTiles.isEmpty()) {
-        // 确保所有任务完成
+    // 视口下载的队列与在途请求都已清空：停止批处理并把状态栏归零
+    if (m_currentRequests == 0 && !hasPendingTiles()) {
         m_isProcessing = false;
-    } else if (m_regionDownloadTotal > 0 && m_regionDownloadCurrent >= m_regionDownloadTotal && m_currentRequests > 0) {
-        // 如果所有瓦片都已处理但还有请求在进行中，设置一个超时保护
-        static int timeoutCounter = 0;
-        timeoutCounter++;
-        if (timeoutCounter > 50) {  // 增加超时次数到50次
-            m_currentRequests = 0;
-            m_isProcessing = false;
-            if (!m_downloadFinishedEmitted) {
-                m_downloadFinishedEmitted = true;
-                emit downloadFinished();
-            }
-            timeoutCounter = 0;
-        } else {
-            // 继续等待
-            if (!m_processTimer->isActive()) {
-                m_processTimer->start(500);
-            }
-        }
-    } else if (m_isProcessing && m_pendingTiles.isEmpty() && m_currentRequests > 0) {
-        // 特殊情况：队列为空但还有请求在进行中
-        static int emptyQueueCounter = 0;
-        emptyQueueCounter++;
-        if (emptyQueueCounter > 30) {  // 增加等待次数到30次
-            m_currentRequests = 0;
-            m_isProcessing = false;
-            if (!m_downloadFinishedEmitted) {
-                m_downloadFinishedEmitted = true;
-                emit downloadFinished();
-            }
-            emptyQueueCounter = 0;
-        } else {
-            if (!m_processTimer->isActive()) {
-                m_processTimer->start(500);
-            }
-        }
-    } else if (m_isProcessing && m_regionDownloadTotal > 0) {
-        // 正常处理过程中，继续检查
-        // 确保定时器会继续处理
-        if (!m_processTimer->isActive()) {
-            m_processTimer->start(300);
-        }
-    }
-    
-    // 添加额外的安全检查，确保在任何情况下都能继续处理
-    if (m_isProcessing && (m_pendingTiles.size() > 0 || m_currentRequests > 0)) {
-        if (!m_processTimer->isActive()) {
-            m_processTimer->start(200);
-        }
-    }
-    
-    // 特殊情况处理：如果处理已完成但信号未发出
-    if (!m_isProcessing && m_regionDownloadTotal > 0 && m_regionDownloadCurrent >= m_regionDownloadTotal && !m_downloadFinishedEmitted) {
-        m_downloadFinishedEmitted = true;
-        emit downloadFinished();
-    }
-    // 若所有下载任务完成（包括非区域下载），刷新状态栏为 0
-    if (!m_isProcessing && m_currentRequests == 0 && m_pendingTiles.isEmpty()) {
         emit viewportActivity(0, 0, true);
+    } else if (m_isProcessing && !m_processTimer->isActive()) {
+        m_processTimer->start(200);
     }
 }
 
 void TileMapManager::setTileSource(const QString &urlTemplate)
 {
     m_tileUrlTemplate = urlTemplate;
+    m_fetcher->setTileSource(urlTemplate);
+}
+
+void TileMapManager::setCacheDir(const QString &dir)
+{
+    if (dir == m_cacheDir) return;
+    m_cacheDir = dir;
+    QDir().mkpath(dir);
+    m_fetcher->setCacheDir(dir);
+    m_pyramidBuilder->cancel();
+    m_pyramidBuilder->setCacheDir(dir);
+
+    // 旧目录的索引、占位与已显示瓦片全部作废
+    m_pyramid.clear();
+    m_placeholderTried.clear();
+    m_synthRequested.clear();
+    m_coarseRequested.clear();
+    m_pendingInsert.clear();
+    if (m_tileLayer) m_tileLayer->clearTiles();
+    cancelStagedZoom();
+
+    rebuildIndex();
+}
+
+void TileMapManager::rebuildIndex()
+{
+    // 目录扫描放到线程池；重建期间新落盘的瓦片记在 m_pyramid 中，完成后并入
+    m_indexing = true;
+    if (!m_indexWatcher) {
+        m_indexWatcher = new QFutureWatcher<TilePyramid>(this);
+        connect(m_indexWatcher, &QFutureWatcher<TilePyramid>::finished, this, &TileMapManager::onIndexRebuilt);
+    }
+    const QString dir = m_cacheDir;
+    m_indexClock.start();
+    m_indexWatcher->setFuture(QtConcurrent::run([dir]() {
+        TilePyramid p;
+        p.buildFromCache(dir);
+        return p;
+    }));
+}
+
+void TileMapManager::onIndexRebuilt()
+{
+    // setFuture 换新任务后旧任务不再通知，这里的结果总对应当前目录
+    TilePyramid built = m_indexWatcher->result();
+    built.unite(m_pyramid);
+    m_pyramid = built;
+    m_indexing = false;
+    m_placeholderTried.clear();
+    logMessage(QString("Tile pyramid built for %1: %2 tiles, max zoom %3, %4 ms")
+               .arg(m_cacheDir).arg(m_pyramid.tileCount()).arg(m_pyramid.maxLevel()).arg(m_indexClock.elapsed()));
+    if (m_scene) loadTiles();
+}
+
+void TileMapManager::setServerList(const QStringList &servers)
+{
+    m_servers = servers;
+    m_serverIndex = 0;
+    m_fetcher->setServerList(servers);
+}
+
+void TileMapManager::syncCenterToScene(double sceneX, double sceneY)
+{
+    sceneToLatLon(sceneX, sceneY, m_zoom, m_centerLat, m_centerLon);
 }
 
 QPointF TileMapManager::getCenterScenePos() const
 {
-    int n = 1 << m_zoom;
-    double tileX = (m_centerLon + 180.0) / 360.0 * n;
-    double lat_rad = m_centerLat * M_PI / 180.0;
-    double tileY = (1.0 - log(tan(lat_rad) + 1.0 / cos(lat_rad)) / M_PI) / 2.0 * n;
-    return QPointF(tileX * m_tileSize, tileY * m_tileSize);
+    return WebMercator::project(m_centerLon, m_centerLat, double(1 << m_zoom) * m_tileSize);
 }
 
 void TileMapManager::latLonToTile(double lat, double lon, int zoom, int &tileX, int &tileY)
 {
     // 将经纬度转换为瓦片坐标
-    double latRad = lat * M_PI / 180.0;
-    int n = 1 << zoom;
-    tileX = (int)((lon + 180.0) / 360.0 * n);
-    tileY = (int)((1.0 - log(tan(latRad) + (1.0 / cos(latRad))) / M_PI) / 2.0 * n);
+    WebMercator::lonLatToTile(lon, lat, zoom, tileX, tileY);
     
     // 添加调试信息（可选）
     if (m_verboseLogging) logMessage(QString("latLonToTile: lat=%1, lon=%2, zoom=%3 -> tileX=%4, tileY=%5").arg(lat).arg(lon).arg(zoom).arg(tileX).arg(tileY));
@@ -950,37 +992,46 @@ void TileMapManager::latLonToTile(double lat, double lon, int zoom, int &tileX,
 void TileMapManager::tileToLatLon(int tileX, int tileY, int zoom, double &lat, double &lon)
 {
     // 将瓦片坐标转换为经纬度
-    int n = 1 << zoom;
-    lon = tileX / (double)n * 360.0 - 180.0;
-    double latRad = atan(sinh(M_PI * (1 - 2 * tileY / (double)n)));
-    lat = latRad * 180.0 / M_PI;
+    const QPointF ll = WebMercator::unproject(tileX, tileY, double(1 << zoom));
+    lon = ll.x();
+    lat = ll.y();
 }
 
 QString TileMapManager::getTilePath(int x, int y, int z)
 {
     // 生成瓦片文件的本地路径
-    return QString("%1/%2/%3/%4.png").arg(m_cacheDir).arg(z).arg(x).arg(y);
+    return getTilePath(TileId(x, y, z));
+}
+
+QPixmap TileMapManager::solidTile(quint32 argb)
+{
+    auto it = m_solidTiles.constFind(argb);
+    if (it != m_solidTiles.constEnd()) return it.value();
+    QPixmap pm(m_tileSize, m_tileSize);
+    pm.fill(QColor::fromRgba(argb));
+    m_solidTiles.insert(argb, pm);
+    return pm;
 }
 
 bool TileMapManager::tileExists(int x, int y, int z)
 {
-    // 检查瓦片是否已存在于本地
-    QFile file(getTilePath(x, y, z));
-    return file.exists();
+    // 检查瓦片是否已存在于本地（查内存索引；索引重建中回退到磁盘）
+    if (m_pyramid.contains(TileId(x, y, z))) return true;
+    return m_indexing && QFile::exists(getTilePath(x, y, z));
 }
 
 void TileMapManager::saveTile(int x, int y, int z, const QByteArray &data)
 {
     // 保存瓦片到本地缓存
     QString tilePath = getTilePath(x, y, z);
-    if (m_verboseLogging) qDebug() << "Saving tile to:" << tilePath;
+    if (m_verboseLogging) TILE_DEBUG() << "Saving tile to:" << tilePath;
     
     // 创建目录
     QDir dir(QFileInfo(tilePath).path());
     if (!dir.exists()) {
-        if (m_verboseLogging) qDebug() << "Creating directory:" << QFileInfo(tilePath).path();
+        if (m_verboseLogging) TILE_DEBUG() << "Creating directory:" << QFileInfo(tilePath).path();
         if (!dir.mkpath(".")) {
-            if (m_verboseLogging) qDebug() << "Failed to create directory for tile!";
+            if (m_verboseLogging) TILE_DEBUG() << "Failed to create directory for tile!";
             return;
         }
     }
@@ -990,17 +1041,123 @@ void TileMapManager::saveTile(int x, int y, int z, const QByteArray &data)
     if (file.open(QIODevice::WriteOnly)) {
         qint64 written = file.write(data);
         file.close();
-        if (m_verboseLogging) qDebug() << "Saved tile, bytes written:" << written;
+        if (m_verboseLogging) TILE_DEBUG() << "Saved tile, bytes written:" << written;
+        if (written == data.size()) {
+            m_pyramid.insert(TileId(x, y, z));
+            m_placeholderTried.remove(TileId(x, y, z)); // 重新写入后可再作占位
+        }
         
         // 验证文件是否成功写入
         if (written != data.size()) {
-            if (m_verboseLogging) qDebug() << "Warning: Written bytes" << written << "not equal to data size" << data.size();
+            if (m_verboseLogging) TILE_DEBUG() << "Warning: Written bytes" << written << "not equal to data size" << data.size();
         }
     } else {
-        if (m_verboseLogging) qDebug() << "Failed to save tile:" << file.errorString() << "Path:" << tilePath;
+        if (m_verboseLogging) TILE_DEBUG() << "Failed to save tile:" << file.errorString() << "Path:" << tilePath;
     }
 }
 
+bool TileMapManager::ensurePlaceholder(int x, int y)
+{
+    if (!m_tileLayer || m_tileLayer->hasFallbackFor(x, y)) return false;
+    // 内存中没有可用占位：按覆盖索引找最近的已缓存祖先（读取失败的祖先不再重试）
+    TileId anc;
+    if (!m_pyramid.nearestAncestor(TileId(x, y, m_zoom), anc, 4)) return false;
+    if (m_placeholderTried.contains(anc)) return false;
+    QPixmap pixmap = loadTile(anc.x(), anc.y(), anc.z());
+    if (pixmap.isNull()) {
+        if (m_placeholderTried.size() > 4096) m_placeholderTried.clear();
+        m_placeholderTried.insert(anc);
+        return false;
+    }
+    m_tileLayer->setFallbackTile(anc.z(), anc.x(), anc.y(), pixmap);
+    return true;
+}
+
+void TileMapManager::setRetryPolicy(int retryMax, int backoffInitialMs)
+{
+    m_retryMax = qMax(1, retryMax);
+    m_backoffInitialMs = qMax(0, backoffInitialMs);
+    if (m_worker) {
+        QMetaObject::invokeMethod(m_worker, "configureNetworkRetries", Qt::QueuedConnection,
+                                  Q_ARG(int, m_retryMax),
+                                  Q_ARG(int, m_backoffInitialMs));
+    }
+}
+
+void TileMapManager::setBackgroundMode(bool background)
+{
+    if (m_background == background) return;
+    m_background = background;
+    if (background) {
+        m_insertTimer->stop();
+        m_fadeTimer->stop();
+        return;
+    }
+    // 后台期间合成结果被丢弃，对应记录一并清除，允许重新合成
+    m_synthRequested.clear();
+    if (!m_pendingInsert.isEmpty()) {
+        m_insertTimer->start();
+    }
+    if (m_refreshOnRestore) {
+        const bool allowDownload = m_refreshAllowDownload;
+        m_refreshOnRestore = false;
+        m_refreshAllowDownload = false;
+        repositionTiles();
+        calculateVisibleTiles(allowDownload);
+    }
+}
+
+qint64 TileMapManager::estimateDownloadMs(int tiles) const
+{
+    // 尚无样本时不估算，避免冷启动即进入渐进模式
+    if (m_downloadEwmaMs <= 0.0) return 0;
+    // 同步下载模式下 worker 逐个请求，实际并发为 1
+    const int concurrency = m_useAsyncNetwork ? qMax(1, m_maxConcurrentRequests) : 1;
+    return qint64(m_downloadEwmaMs * tiles / concurrency);
+}
+
+void TileMapManager::requestCoarseTiles(int startX, int startY, int endX, int endY)
+{
+    const int cz = m_zoom - kProgressiveLevels;
+    if (cz < 0) return;
+    if (m_coarseRequested.size() > 4096) m_coarseRequested.clear();
+    for (int cx = startX >> kProgressiveLevels; cx <= endX >> kProgressiveLevels; ++cx) {
+        for (int cy = startY >> kProgressiveLevels; cy <= endY >> kProgressiveLevels; ++cy) {
+            const TileId c(cx, cy, cz);
+            // 已缓存的祖先由 ensurePlaceholder 读盘占位
+            if (m_pyramid.contains(c) || m_coarseRequested.contains(c)) continue;
+            m_coarseRequested.insert(c);
+            downloadTile(cx, cy, cz);
+        }
+    }
+}
+
+bool TileMapManager::requestSynthesize(int x, int y)
+{
+    // 逐瓦片判断：本瓦片未缓存且 kMaxOverzoom 级内有已缓存祖先时合成，真实瓦片到达后覆盖
+    if (!m_workerThread) return false;
+    const TileId id(x, y, m_zoom);
+    if (m_synthRequested.contains(id) || m_pyramid.contains(id)) return false;
+    TileId anc;
+    if (!m_pyramid.nearestAncestor(id, anc, kMaxOverzoom)) return false;
+    // 与 m_coarseRequested 一样设上限，防止异常情况下无限增长
+    if (m_synthRequested.size() > 4096) m_synthRequested.clear();
+    m_synthRequested.insert(id);
+    emit requestSynthesizeTile(x, y, m_zoom, getTilePath(anc.x(), anc.y(), anc.z()), m_zoom - anc.z(), m_tileSize);
+    return true;
+}
+
+void TileMapManager::onTileSynthesized(int x, int y, int z, const QImage &image)
+{
+    // 合成失败时移除记录，允许之后重试（跨层级的记录在切换层级时已整体清空）
+    if (image.isNull()) {
+        if (z == m_zoom) m_synthRequested.remove(TileId(x, y, z));
+        return;
+    }
+    if (z != m_zoom) return;
+    enqueueInsert(x, y, z, QPixmap::fromImage(image), true);
+}
+
 QPixmap TileMapManager::loadTile(int x, int y, int z)
 {
     // 从本地加载瓦片
@@ -1034,11 +1191,11 @@ QString TileMapManager::getTileUrl(int x, int y, int z)
 
 void TileMapManager::downloadTile(int x, int y, int z)
 {
-    if (m_verboseLogging) qDebug() << "TileMapManager::downloadTile called for tile:" << x << y << z;
+    if (m_verboseLogging) TILE_DEBUG() << "TileMapManager::downloadTile called for tile:" << x << y << z;
     
     // 检查瓦片是否已存在
     if (tileExists(x, y, z)) {
-        if (m_verboseLogging) qDebug() << "Tile already exists locally, count as completed:" << x << "," << y << "," << z;
+        if (m_verboseLogging) TILE_DEBUG() << "Tile already exists locally, count as completed:" << x << "," << y << "," << z;
         // 对于批量下载/调度场景：本地已存在则直接记为完成，不再加载
         emit tileCached(x, y, z, true);
         return;
@@ -1046,14 +1203,13 @@ void TileMapManager::downloadTile(int x, int y, int z)
     
     // 并发门限：若已达到上限，入队等待，让 processNextBatch 统一调度
     if (m_currentRequests >= m_maxConcurrentRequests) {
-        TileInfo info;
-        info.x = x; info.y = y; info.z = z;
-        info.url = getTileUrl(x, y, z);
-        info.filePath = getTilePath(x, y, z);
-        m_pendingTiles.enqueue(info);
+        // 低层级覆盖瓦片进优先队列，排在此前各次计算积压的细瓦片之前
+        const TileId id(x, y, z);
+        if (m_coarseRequested.contains(id)) m_coarsePending.enqueue(id);
+        else m_pendingTiles.enqueue(id);
         m_isProcessing = true; // 浏览模式下也驱动批处理
         if (!m_processTimer->isActive()) m_processTimer->start(50);
-        if (m_verboseLogging) qDebug() << "Concurrent limit reached, enqueue tile:" << x << y << z;
+        if (m_verboseLogging) TILE_DEBUG() << "Concurrent limit reached, enqueue tile:" << x << y << z;
         return;
     }
 
@@ -1061,7 +1217,7 @@ void TileMapManager::downloadTile(int x, int y, int z)
     QString url = getTileUrl(x, y, z);
     QString filePath = getTilePath(x, y, z);
     m_currentRequests++;
-    if (m_verboseLogging) qDebug() << "Emitting requestDownloadTile for tile:" << x << y << z << "URL:" << url;
+    if (m_verboseLogging) TILE_DEBUG() << "Emitting requestDownloadTile for tile:" << x << y << z << "URL:" << url;
     emit requestDownloadTile(x, y, z, url, filePath);
 }
 
@@ -1071,6 +1227,11 @@ void TileMapManager::calculateVisibleTiles(bool allowDownload)
     if (m_verboseLogging) qDebug() << "calculateVisibleTiles: scene is null";
         return;
     }
+    if (m_background) {
+        m_refreshOnRestore = true;
+        m_refreshAllowDownload = m_refreshAllowDownload || allowDownload;
+        return;
+    }
     
     if (m_verboseLogging) {
         qDebug() << "=== calculateVisibleTiles ===";
@@ -1174,16 +1335,32 @@ void TileMapManager::calculateVisibleTiles(bool allowDownload)
     m_lastZoomForLayout = m_zoom;
     m_layoutValid = true;
 
+    syncLayerZoom();
+    int placeholderBudget = kMaxPlaceholderLoads;
+    QVector<TileId> toDownload;
+
     // 加载或下载瓦片
     for (int x = startX; x <= endX; x++) {
         for (int y = startY; y <= endY; y++) {
-            TileKey key = {x, y, m_zoom};
-            
-            // 如果瓦片已经加载，跳过
-            if (m_tileItems.contains(key)) {
+            // 如果瓦片已经加载，跳过（合成瓦片仍继续请求真实数据）
+            const bool synthetic = m_tileLayer && m_tileLayer->isSynthetic(x, y);
+            if (m_tileLayer && m_tileLayer->hasTile(x, y) && !synthetic) {
                 tilesLoaded++;
                 continue;
             }
+            // 纯色祖先之下的缺失瓦片：直接以纯色块显示，不读盘也不下载
+            const TileId tid(x, y, m_zoom);
+            TileId uniformTile;
+            quint32 argb = 0;
+            if (m_skipUniformTiles && !m_pyramid.contains(tid) && m_pyramid.uniformAncestor(tid, uniformTile, argb)) {
+                enqueueInsert(x, y, m_zoom, solidTile(argb));
+                tilesLoaded++;
+                continue;
+            }
+            // 缺失瓦片先用祖先占位，真实瓦片到达后覆盖
+            if (!synthetic && placeholderBudget > 0 && ensurePlaceholder(x, y)) {
+                placeholderBudget--;
+            }
             
             // 检查本地是否存在瓦片
             if (tileExists(x, y, m_zoom)) {
@@ -1192,16 +1369,38 @@ void TileMapManager::calculateVisibleTiles(bool allowDownload)
                 m_currentRequests++;
                 emit requestLoadTile(x, y, m_zoom, filePath);
                 tilesLoaded++;
-            } else if (allowDownload) {
-                // 允许下载时统一走 downloadTile（内部决定本地/网络）
+                continue;
+            }
+            // 本瓦片未缓存：在工作线程由最近的已缓存祖先裁剪放大出临时瓦片
+            if (!synthetic) requestSynthesize(x, y);
+            if (allowDownload) {
+                // 允许下载时统一走 downloadTile（内部决定本地/网络），循环结束后按屏幕位置排序发起
                 tilesToDownload++;
-                downloadTile(x, y, m_zoom);
+                toDownload.append(tid);
             } else {
                 // 拖拽中：跳过下载，避免大量异步回调插队导致抖动/崩溃
             }
         }
     }
     
+    if (!toDownload.isEmpty()) {
+        // 链路慢时先请求覆盖视口的低层级瓦片（排在细化瓦片之前），尽快铺满画面
+        const qint64 estimateMs = estimateDownloadMs(toDownload.size());
+        if (m_progressiveThresholdMs > 0 && estimateMs > m_progressiveThresholdMs) {
+            if (m_verboseLogging) qDebug() << "Progressive loading: estimated" << estimateMs << "ms for" << toDownload.size() << "tiles";
+            requestCoarseTiles(startX, startY, endX, endY);
+        }
+        // 细化由视口中心向外
+        int centerX, centerY;
+        latLonToTile(m_centerLat, m_centerLon, m_zoom, centerX, centerY);
+        std::sort(toDownload.begin(), toDownload.end(), [centerX, centerY](const TileId &a, const TileId &b) {
+            const int da = (a.x() - centerX) * (a.x() - centerX) + (a.y() - centerY) * (a.y() - centerY);
+            const int db = (b.x() - centerX) * (b.x() - centerX) + (b.y() - centerY) * (b.y() - centerY);
+            return da < db;
+        });
+        for (const TileId &id : toDownload) downloadTile(id.x(), id.y(), id.z());
+    }
+    
     if (m_verboseLogging) {
         qDebug() << "Total tiles to download:" << tilesToDownload;
         qDebug() << "Total tiles loaded:" << tilesLoaded;
@@ -1210,17 +1409,15 @@ void TileMapManager::calculateVisibleTiles(bool allowDownload)
     
     // 无论是否区域下载模式，都向上报视口活动，便于 UI 提示“正在下载/空白占位”
     emit viewportActivity(tilesToDownload, tilesLoaded, /*downloadingEnabled*/ allowDownload);
-    // 区域下载模式下保留旧信号
-    if (m_regionDownloadTotal > 0) emit downloadProgress(tilesLoaded, tilesLoaded + tilesToDownload);
 }
 
 void TileMapManager::cleanupTiles()
 {
-    if (!m_scene) return;
+    if (!m_scene || !m_tileLayer) return;
     if (m_isDragging) return; // 拖拽期间不清理，减少抖动
     
-    // 清理视图范围外的瓦片，包括不同缩放级别的瓦片
-    QList<TileKey> keysToRemove;
+    // 不同缩放级别的瓦片：切换图层层级即整体清空
+    syncLayerZoom();
     
     // 计算中心点的瓦片坐标
     int centerTileX, centerTileY;
@@ -1232,102 +1429,28 @@ void TileMapManager::cleanupTiles()
     int endX = centerTileX + m_viewportTilesX / 2 + 2;
     int endY = centerTileY + m_viewportTilesY / 2 + 2;
     
-    // 检查哪些瓦片需要移除
-    for (auto it = m_tileItems.begin(); it != m_tileItems.end(); ++it) {
-        const TileKey &key = it.key();
-        // 只移除不同缩放级别的瓦片，保留当前缩放级别的瓦片
-        if (key.z != m_zoom) {
-            keysToRemove.append(key);
-        }
-        // 对于当前缩放级别，只移除距离中心太远的瓦片
-        else if (key.x < startX || key.x > endX || key.y < startY || key.y > endY) {
-            keysToRemove.append(key);
-        }
+    // 对于当前缩放级别，只移除距离中心太远的瓦片
+    int before = m_tileLayer->tileCount();
+    m_tileLayer->removeTilesOutside(startX, startY, endX, endY);
+    // 移出范围的合成记录一并清除，回到视野时可重新合成
+    for (auto it = m_synthRequested.begin(); it != m_synthRequested.end();) {
+        const int x = it->x();
+        const int y = it->y();
+        if (x < startX || x > endX || y < startY || y > endY) it = m_synthRequested.erase(it);
+        else ++it;
     }
     
-    if (m_verboseLogging) qDebug() << "Cleanup: removing" << keysToRemove.size() << "tiles, keeping" << m_tileItems.size() - keysToRemove.size();
-    
-    // 移除瓦片（批量操作，减少单个删除的开销）
-    for (const TileKey &key : keysToRemove) {
-        QGraphicsPixmapItem *item = m_tileItems.take(key);
-        if (item) {
-            // 回收到池：从场景移除但不销毁
-            if (item->scene() == m_scene) {
-                m_scene->removeItem(item);
-            }
-            item->setPixmap(QPixmap());
-            item->setPos(-100000, -100000); // 放到视口外以避免误闪烁
-            item->setVisible(false);
-            item->setOpacity(1.0);
-            m_itemPool.enqueue(item);
-        }
-    }
-    
-    if (m_verboseLogging) qDebug() << "Cleanup complete. Remaining tiles:" << m_tileItems.size();
+    if (m_verboseLogging) qDebug() << "Cleanup: removed" << before - m_tileLayer->tileCount() << "tiles, remaining" << m_tileLayer->tileCount();
 }
 
 void TileMapManager::repositionTiles()
 {
     if (!m_scene) return;
     
-    if (m_verboseLogging) qDebug() << "Repositioning tiles for zoom:" << m_zoom;
-    
-    // 使用与 calculateVisibleTiles 和 sceneToLatLon 完全相同的逻辑
-    int maxTilesAtZoom = (1 << m_zoom);
-    int centerTileX, centerTileY;
-    latLonToTile(m_centerLat, m_centerLon, m_zoom, centerTileX, centerTileY);
-    
-    int startX, startY, endX, endY;
-    
-    if (maxTilesAtZoom <= m_viewportTilesX || maxTilesAtZoom <= m_viewportTilesY) {
-        // 小地图模式：加载所有瓦片，确保整图完整显示
-        startX = 0;
-        startY = 0;
-        endX = maxTilesAtZoom - 1;
-        endY = maxTilesAtZoom - 1;
-    } else {
-        // 正常模式
-        startX = centerTileX - m_viewportTilesX / 2;
-        startY = centerTileY - m_viewportTilesY / 2;
-        endX = centerTileX + m_viewportTilesX / 2;
-        endY = centerTileY + m_viewportTilesY / 2;
-        
-        int maxTile = maxTilesAtZoom - 1;
-        startX = qMax(0, startX);
-        startY = qMax(0, startY);
-        endX = qMin(maxTile, endX);
-        endY = qMin(maxTile, endY);
-    }
-    
-    // 计算偏移量
-    int totalTilesX = endX - startX + 1;
-    int totalTilesY = endY - startY + 1;
-    double offsetX = (m_viewportTilesX - totalTilesX) * m_tileSize / 2.0;
-    double offsetY = (m_viewportTilesY - totalTilesY) * m_tileSize / 2.0;
-    
-    if (maxTilesAtZoom <= m_viewportTilesX || maxTilesAtZoom <= m_viewportTilesY) {
-        // 以视图中心为基准将整图居中显示
-        offsetX = (m_viewWidth - maxTilesAtZoom * m_tileSize) / 2.0;
-        offsetY = (m_viewHeight - maxTilesAtZoom * m_tileSize) / 2.0;
-        offsetX = qMax(0.0, offsetX);
-        offsetY = qMax(0.0, offsetY);
-    }
-    
-    // 绝对定位：无需随中心变化调整偏移
-    for (auto it = m_tileItems.begin(); it != m_tileItems.end(); ++it) {
-        const TileKey &key = it.key();
-        if (key.z == m_zoom) {
-            QGraphicsPixmapItem *item = it.value();
-            if (item) {
-                double tileX = key.x * m_tileSize;
-                double tileY = key.y * m_tileSize;
-                item->setPos(tileX, tileY);
-                if (m_verboseLogging) qDebug() << "Repositioned tile (" << key.x << "," << key.y << ") to scene(" << tileX << "," << tileY << ")";
-            }
-        }
-    }
+    // 绝对定位：图层按瓦片坐标直接绘制，无需逐项重排，只需保证图层层级正确
+    syncLayerZoom();
     
-    if (m_verboseLogging) qDebug() << "Reposition complete (absolute).";
+    if (m_verboseLogging) qDebug() << "Reposition complete (absolute, layer zoom:" << m_zoom << ")";
 }
 
 void TileMapManager::checkLocalTiles()
@@ -1431,14 +1554,13 @@ int TileMapManager::loadLocalTiles()
     }
     
     int tilesLoaded = 0;
+    syncLayerZoom();
     
     // 加载本地瓦片
     for (int x = startX; x <= endX; x++) {
         for (int y = startY; y <= endY; y++) {
-            TileKey key = {x, y, m_zoom};
-            
             // 如果瓦片已经加载，跳过
-            if (m_tileItems.contains(key)) {
+            if (m_tileLayer && m_tileLayer->hasTile(x, y)) {
                 tilesLoaded++;
                 continue;
             }
@@ -1447,15 +1569,9 @@ int TileMapManager::loadLocalTiles()
             if (tileExists(x, y, m_zoom)) {
                 // 直接从文件加载
                 QPixmap pixmap = loadTile(x, y, m_zoom);
-                if (!pixmap.isNull()) {
-                    QGraphicsPixmapItem *item = m_scene->addPixmap(pixmap);
-                    
-            // 绝对定位
-            double tileX = x * m_tileSize;
-            double tileY = y * m_tileSize;
-                    item->setPos(tileX, tileY);
-                    
-                    m_tileItems[key] = item;
+                if (!pixmap.isNull() && m_tileLayer) {
+                    // 绝对定位：由图层按瓦片坐标绘制
+                    m_tileLayer->setTile(x, y, pixmap);
                     tilesLoaded++;
                     
                     // logMessage(QString("Loaded local tile (%1,%2) at scene(%3,%4)").arg(x).arg(y).arg(tileX).arg(tileY));
@@ -1531,50 +1647,15 @@ void TileMapManager::getLocalTilesInfo()
     logMessage(QString("Zoom levels: %1").arg(zoomKeys.join(", ")));
 }
 
+int TileMapManager::getMaxZoom() const
+{
+    return qMin(TilePyramid::kMaxLevel, qMax(kBaseMaxZoom, m_pyramid.maxLevel()) + kMaxOverzoom);
+}
+
 int TileMapManager::getMaxAvailableZoom() const
 {
-    // 检查缓存目录是否存在
-    QDir cacheDir(m_cacheDir);
-    if (!cacheDir.exists()) {
-        return 0; // 没有缓存目录，返回0
-    }
-    
-    // 查找可用的缩放级别
-    QStringList zoomLevels = cacheDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-    if (zoomLevels.isEmpty()) {
-        return 0; // 没有缩放级别，返回0
-    }
-    
-    int maxZoom = 0;
-    for (const QString &zoomStr : zoomLevels) {
-        bool ok;
-        int zoom = zoomStr.toInt(&ok);
-        if (ok && zoom > maxZoom) {
-            // 检查这个缩放级别是否有瓦片
-            QDir zoomDir(cacheDir.absoluteFilePath(zoomStr));
-            QStringList xDirs = zoomDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
-            if (!xDirs.isEmpty()) {
-                // 检查是否有实际的瓦片文件
-                bool hasTiles = false;
-                for (const QString &xStr : xDirs) {
-                    bool xOk;
-                    int x = xStr.toInt(&xOk);
-                    if (xOk) {
-                        QDir xDir(zoomDir.absoluteFilePath(xStr));
-                        QStringList yFiles = xDir.entryList(QStringList() << "*.png", QDir::Files);
-                        if (!yFiles.isEmpty()) {
-                            hasTiles = true;
-                            break;
-                        }
-                    }
-                }
-                if (hasTiles) {
-                    maxZoom = zoom;
-                }
-            }
-        }
-    }
-    
+    // 由缓存覆盖索引直接给出
+    int maxZoom = m_pyramid.maxLevel();
     qDebug() << "Max available zoom level:" << maxZoom;
     return maxZoom;
 }
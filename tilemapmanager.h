@@ -5,39 +5,33 @@
 #include <QGraphicsScene>
 #include <QNetworkAccessManager>
 #include <QPixmap>
+#include <QImage>
 #include <QMutex>
 #include <QQueue>
 #include <QSet>
+#include <QHash>
 #include <QTimer>
 #include <QPointF>
+#include <QPoint>
+#include <QVector>
+#include <QRect>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include "tileid.h"
+#include "tilepyramid.h"
 
 class TileWorker;
-
-// 瓦片键值结构
-struct TileKey {
-    int x, y, z;
-    
-    bool operator==(const TileKey &other) const {
-        return x == other.x && y == other.y && z == other.z;
-    }
-};
-
-// 为TileKey提供hash函数声明
-uint qHash(const TileKey &key, uint seed = 0);
-
-// 瓦片信息结构
-struct TileInfo {
-    int x, y, z;
-    QString url;
-    QString filePath;
-};
+class TileFetcher;
+class PyramidBuilder;
+class TileLayerItem;
 
 class TileMapManager : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit TileMapManager(QObject *parent = nullptr);
+    explicit TileMapManager(const QString &cacheDir = QString(), QObject *parent = nullptr);
     ~TileMapManager();
 
     void initScene(QGraphicsScene *scene);
@@ -54,21 +48,41 @@ public:
     void panByPixels(double deltaViewportX, double deltaViewportY); // 依据视口像素位移平移中心
     void setDragging(bool dragging) { m_isDragging = dragging; }
     QPointF getCenterScenePos() const; // 获取当前中心的场景像素坐标
+    void syncCenterToScene(double sceneX, double sceneY); // 仅同步中心，不触发加载（连续缩放用）
+    // 缩放预载：切换层级前先读入目标层级可见范围内已缓存的瓦片，已到达比例达到阈值时发 zoomStageReady；
+    // 无可读入的瓦片时比例视为 1。setZoom 到该层级时预载瓦片一次换入并淡入
+    void stageZoom(int zoom);
+    void cancelStagedZoom();
+    double stagedFraction() const;
+    void setZoomHoldThreshold(double fraction) { m_zoomHoldThreshold = qBound(0.0, fraction, 1.0); }
+    double zoomHoldThreshold() const { return m_zoomHoldThreshold; }
     int getTileSize() const { return m_tileSize; }
+    TileLayerItem *tileLayer() const { return m_tileLayer; }
+    const TilePyramid &pyramid() const { return m_pyramid; } // 缓存覆盖索引
+    TileFetcher *fetcher() const { return m_fetcher; } // 批量下载用的抓取器（共用缓存目录与覆盖索引）
+    PyramidBuilder *pyramidBuilder() const { return m_pyramidBuilder; } // 由高层级缓存本地生成低层级
     QString getCacheDir() const { return m_cacheDir; }
     // 运行期设置
-    void setCacheDir(const QString &dir) { m_cacheDir = dir; }
+    void setCacheDir(const QString &dir);
     void setMaxConcurrentRequests(int n) { m_maxConcurrentRequests = qMax(1, n); }
-    void setServerList(const QStringList &servers) { m_servers = servers; m_serverIndex = 0; }
+    // 渐进加载：视口预计下载耗时超过阈值（毫秒，0 关闭）时先取低 2 级的覆盖瓦片作占位，再由中心向外细化
+    void setProgressiveThresholdMs(int ms) { m_progressiveThresholdMs = qMax(0, ms); }
+    double downloadEwmaMs() const { return m_downloadEwmaMs; }
+    // 后台模式（窗口最小化）：不再解码/插入瓦片，下载结果只落盘；退出时续上排队的插入
+    void setBackgroundMode(bool background);
+    bool isBackgroundMode() const { return m_background; }
+    void setServerList(const QStringList &servers);
     void setUseAsyncNetwork(bool enabled) { m_useAsyncNetwork = enabled; }
+    void setRetryPolicy(int retryMax, int backoffInitialMs); // 同步给工作线程
     // 日志控制
-    void setVerboseLogging(bool enable) { m_verboseLogging = enable; }
+    void setVerboseLogging(bool enable);
+    // 每帧瓦片插入的时间预算（毫秒）
+    void setInsertBudgetMs(int ms) { m_insertBudgetMs = qMax(1, ms); }
+    int insertBudgetMs() const { return m_insertBudgetMs; }
     // 可开关设置
     void setEnableGenerationDiscard(bool enabled) { m_enableGenerationDiscard = enabled; }
     void setPrefetchRing(int ring) { m_prefetchRing = ring; }
-    
-    // 下载指定区域的瓦片地图
-    void downloadRegion(double minLat, double maxLat, double minLon, double maxLon, int minZoom, int maxZoom);
+    void setSkipUniformTiles(bool enabled) { m_skipUniformTiles = enabled; } // 关闭时不以纯色块代替缺失瓦片
     
     // 检查并加载本地瓦片
     void checkLocalTiles();
@@ -78,15 +92,22 @@ public:
     
     // 获取当前可用的最大缩放级别
     int getMaxAvailableZoom() const;
+    // 允许缩放到的最大级别：最深缓存层级（至少 kBaseMaxZoom）之上再放大 kMaxOverzoom 级
+    int getMaxZoom() const;
+    static constexpr int kBaseMaxZoom = 10;
+    static constexpr int kMaxOverzoom = 4;
 
 private:
-    QGraphicsScene *m_scene;
+    QPointer<QGraphicsScene> m_scene;
     QNetworkAccessManager *m_networkManager;
     double m_centerLat, m_centerLon;
     int m_zoom;
     int m_tileSize;
     QString m_tileUrlTemplate;
     QString m_cacheDir;
+    TilePyramid m_pyramid; // 缓存目录的内存索引（启动时扫描，保存时增量更新）
+    TileFetcher *m_fetcher = nullptr;
+    PyramidBuilder *m_pyramidBuilder = nullptr;
     QStringList m_servers = {"a","b","c"};
     int m_serverIndex = 0;
     
@@ -96,26 +117,20 @@ private:
     int m_viewWidth;   // 视图宽度（像素）
     int m_viewHeight;  // 视图高度（像素）
     
-    // 瓦片管理
-    QHash<TileKey, QGraphicsPixmapItem*> m_tileItems;
-    // item 复用池：避免频繁创建/销毁
-    QQueue<QGraphicsPixmapItem*> m_itemPool;
+    // 瓦片管理：单一图层项持有当前层级的全部瓦片（由场景拥有）
+    TileLayerItem *m_tileLayer = nullptr;
     QMutex m_mutex;
     
-    // 区域下载相关
-    int m_regionDownloadTotal;
-    int m_regionDownloadCurrent;
-    
     // 工作线程
     QThread *m_workerThread;
     TileWorker *m_worker;
     
-    // 下载队列和处理相关
-    QQueue<TileInfo> m_pendingTiles;
+    // 视口下载队列（超出并发上限的瓦片）；区域批量下载统一走 DownloadScheduler + TileFetcher
+    QQueue<TileId> m_pendingTiles;
+    QQueue<TileId> m_coarsePending; // 渐进加载的低层级覆盖瓦片，先于 m_pendingTiles 出队
     QTimer *m_processTimer;
     QTimer *m_dragUpdateTimer = nullptr; // 拖拽节流（由MyForm控制，备用）
     bool m_isProcessing;
-    bool m_downloadFinishedEmitted;
     
     // 限制同时处理的请求数量
     int m_maxConcurrentRequests;
@@ -127,6 +142,7 @@ private:
     int m_generationId = 0;
     int m_prefetchRing = 0; // 0=关闭，1=一圈，2=两圈
     bool m_useAsyncNetwork = false;
+    bool m_skipUniformTiles = false;
 
     // 最近一次布局参数（用于准确的 scene<->tile 变换）
     int m_lastStartX = 0;
@@ -143,11 +159,17 @@ private:
     void tileToLatLon(int tileX, int tileY, int zoom, double &lat, double &lon);
     void sceneToLatLon(double sceneX, double sceneY, int zoom, double &lat, double &lon);
     int getDynamicMinZoom() const; // 动态最小缩放级别，确保地图不小于视口
+    void syncLayerZoom(); // 图层层级与 m_zoom 保持一致
     QString getTilePath(int x, int y, int z);
+    QString getTilePath(const TileId &id) const { return m_cacheDir + QLatin1Char('/') + id.relativePath(); }
     bool tileExists(int x, int y, int z);
     void saveTile(int x, int y, int z, const QByteArray &data);
     QPixmap loadTile(int x, int y, int z);
+    bool ensurePlaceholder(int x, int y); // 从磁盘加载最近祖先作为占位
+    QPixmap solidTile(quint32 argb); // 纯色虚拟瓦片（按颜色缓存）
+    QHash<quint32, QPixmap> m_solidTiles;
     QString getTileUrl(int x, int y, int z);
+    QString getTileUrl(const TileId &id) { return getTileUrl(id.x(), id.y(), id.z()); }
     void downloadTile(int x, int y, int z);
 public:
     // 供调度层最小对接：显式入队某个瓦片
@@ -159,19 +181,63 @@ public:
     int loadLocalTiles();
     void startWorkerThread();
     void stopWorkerThread();
-    void checkAndEmitDownloadFinished();
+    void checkDownloadsIdle(); // 队列与在途请求清空时停止批处理
     void flushPendingInserts();
-    void enqueueInsert(int x, int y, int z, const QPixmap &pixmap);
+    void enqueueInsert(int x, int y, int z, const QPixmap &pixmap, bool synthetic = false);
+    void enqueueInsertBytes(int x, int y, int z, const QByteArray &data);
     bool shouldUpdateForSceneDelta(double sceneX, double sceneY) const; // 跨瓦片阈值判断
+    bool hasPendingTiles() const { return !m_pendingTiles.isEmpty() || !m_coarsePending.isEmpty(); }
+    int pendingTileCount() const { return m_pendingTiles.size() + m_coarsePending.size(); }
 
     struct PendingInsert {
         int x;
         int y;
         int z;
         QPixmap pixmap;
+        QByteArray data; // 未解码数据，插入时再解码
+        bool synthetic = false; // 祖先放大合成，不覆盖真实瓦片
+        int dist = 0; // 到 m_insertCenter 的距离平方（堆键）
     };
-    QQueue<PendingInsert> m_pendingInsert;
+    // 按到中心瓦片距离组织的小顶堆：入队/出队 O(log n)，中心变化时才整体重建
+    QVector<PendingInsert> m_pendingInsert;
+    QPoint m_insertCenter;
+    void pushPendingInsert(PendingInsert &pi);
     QTimer *m_insertTimer = nullptr;
+    QTimer *m_fadeTimer = nullptr; // 驱动图层淡入
+    int m_insertBudgetMs = 4; // 每帧插入耗时预算
+    bool m_background = false;
+    bool m_refreshOnRestore = false; // 后台期间跳过了可见瓦片计算或丢弃了插入，还原时补算
+    bool m_refreshAllowDownload = false;
+    // 切换缓存目录后在线程池重建覆盖索引；完成前存在性查询回退到磁盘
+    QFutureWatcher<TilePyramid> *m_indexWatcher = nullptr;
+    bool m_indexing = false;
+    QElapsedTimer m_indexClock;
+    void rebuildIndex();
+    void onIndexRebuilt();
+    int m_retryMax = 3;
+    int m_backoffInitialMs = 3000;
+    QSet<TileId> m_placeholderTried; // 读取失败的占位祖先（重新写入时移除）
+    static constexpr int kMaxPlaceholderLoads = 4; // 每次计算最多同步读取的祖先数
+    QSet<TileId> m_synthRequested; // 已提交合成的瓦片（切换层级时清空）
+    bool requestSynthesize(int x, int y);
+    // 渐进加载
+    void requestCoarseTiles(int startX, int startY, int endX, int endY);
+    qint64 estimateDownloadMs(int tiles) const;
+    void noteDownloadStarted(const TileId &id) { m_downloadStart.insert(id, m_netClock.elapsed()); }
+    static constexpr int kProgressiveLevels = 2;
+    QElapsedTimer m_netClock;
+    QHash<TileId, qint64> m_downloadStart; // 在途下载 -> 发起时刻
+    double m_downloadEwmaMs = 0.0;        // 单瓦片下载耗时的指数滑动平均
+    int m_progressiveThresholdMs = 2000;
+    QSet<TileId> m_coarseRequested;        // 已请求的低层级覆盖瓦片，到达后转为占位
+    // 缩放预载
+    int m_stageZoom = -1;          // 正在预载的层级，-1 表示无
+    QRect m_stageRange;            // 预载层级的可见瓦片范围
+    int m_stageExpected = 0;       // 已发起读取的预载瓦片数
+    bool m_stageReadySent = false;
+    double m_zoomHoldThreshold = 0.8;
+    void stageTile(int x, int y, int z, const QPixmap &pixmap);
+    void checkStageReady();
     mutable double m_lastUpdateSceneX = -1;
     mutable double m_lastUpdateSceneY = -1;
     bool m_verboseLogging = false; // 详细日志开关
@@ -182,11 +248,10 @@ private slots:
     void onTileLoaded(int x, int y, int z, const QPixmap &pixmap, bool success, const QString &errorString);
     void onTileLoadedBytes(int x, int y, int z, const QByteArray &data, bool success, const QString &errorString);
     void onDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
+    void onTileSynthesized(int x, int y, int z, const QImage &image);
 
 signals:
     void downloadProgress(int current, int total);
-    void regionDownloadProgress(int current, int total, int zoom);
-    void downloadFinished();
     void localTilesFound(int zoomLevel, int tileCount);
     void noLocalTilesFound();
     // 视口活动：告知当前可视范围需要下载/已从本地加载的数量，以及是否允许下载
@@ -195,7 +260,9 @@ signals:
     void tileCached(int x, int y, int z, bool success);
     void requestDownloadTile(int x, int y, int z, const QString &url, const QString &filePath);
     void requestLoadTile(int x, int y, int z, const QString &filePath);
+    void requestSynthesizeTile(int x, int y, int z, const QString &ancestorPath, int dz, int tileSize);
     void zoomChanged(int oldZoom, int newZoom, double mouseLat, double mouseLon);  // 缩放完成，传递鼠标地理坐标
+    void zoomStageReady(int zoom); // 预载层级的已到达比例达到阈值
 };
 
 #endif // TILEMAPMANAGER_H
\ No newline at end of file
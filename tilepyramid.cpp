@@ -0,0 +1,206 @@
+#include "tilepyramid.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFile>
+
+void TilePyramid::clear()
+{
+    for (auto &level : m_counts) level.clear();
+    m_total = 0;
+    m_uniform.clear();
+}
+
+qint64 TilePyramid::buildFromCache(const QString &cacheDir)
+{
+    clear();
+    QDir root(cacheDir);
+    const QStringList zDirs = root.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &zStr : zDirs) {
+        bool okZ = false;
+        const int z = zStr.toInt(&okZ);
+        if (!okZ || z < 0 || z > kMaxLevel) continue;
+        QDir zDir(root.absoluteFilePath(zStr));
+        const QStringList xDirs = zDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &xStr : xDirs) {
+            bool okX = false;
+            const int x = xStr.toInt(&okX);
+            if (!okX) continue;
+            QDirIterator it(zDir.absoluteFilePath(xStr), QStringList() << "*.png", QDir::Files);
+            while (it.hasNext()) {
+                it.next();
+                bool okY = false;
+                const int y = it.fileInfo().completeBaseName().toInt(&okY);
+                if (!okY) continue;
+                const TileId id(x, y, z);
+                if (id.isValid()) insert(id);
+            }
+        }
+    }
+    loadUniform(cacheDir);
+    return m_total;
+}
+
+void TilePyramid::accumulate(const TileId &id, int delta)
+{
+    auto &level = m_counts[id.z()];
+    // 自身及每个祖先的计数
+    for (int dz = 0; dz <= id.z(); ++dz) {
+        const TileId node = id.ancestor(dz);
+        quint32 &c = level[node];
+        c = quint32(qint64(c) + delta);
+        if (c == 0) level.remove(node);
+    }
+    m_total += delta;
+}
+
+void TilePyramid::insert(const TileId &id)
+{
+    if (id.z() > kMaxLevel || contains(id)) return;
+    accumulate(id, +1);
+}
+
+void TilePyramid::unite(const TilePyramid &other)
+{
+    // 每层计数表中键为自身的条目即该层瓦片
+    for (int z = 0; z <= kMaxLevel; ++z) {
+        other.m_counts[z].forEach([this, z](const TileId &id, quint32) {
+            if (id.z() == z) insert(id);
+        });
+    }
+    other.m_uniform.forEach([this](const TileId &id, quint32 argb) { markUniform(id, argb); });
+}
+
+void TilePyramid::remove(const TileId &id)
+{
+    if (id.z() > kMaxLevel || !contains(id)) return;
+    accumulate(id, -1);
+}
+
+bool TilePyramid::contains(const TileId &id) const
+{
+    if (id.z() > kMaxLevel) return false;
+    return m_counts[id.z()].contains(id);
+}
+
+quint32 TilePyramid::count(const TileId &node, int level) const
+{
+    if (level < node.z() || level > kMaxLevel) return 0;
+    return m_counts[level].value(node, 0);
+}
+
+bool TilePyramid::nearestAncestor(const TileId &id, TileId &out, int maxUp) const
+{
+    for (int dz = 1; dz <= maxUp && dz <= id.z(); ++dz) {
+        const TileId a = id.ancestor(dz);
+        if (contains(a)) {
+            out = a;
+            return true;
+        }
+    }
+    return false;
+}
+
+qint64 TilePyramid::countRect(const TileId &node, int z, int minX, int minY, int maxX, int maxY) const
+{
+    const quint32 c = count(node, z);
+    if (c == 0) return 0;
+    // node 在 z 层覆盖的范围
+    const int d = z - node.z();
+    const qint64 x0 = qint64(node.x()) << d;
+    const qint64 y0 = qint64(node.y()) << d;
+    const qint64 x1 = ((qint64(node.x()) + 1) << d) - 1;
+    const qint64 y1 = ((qint64(node.y()) + 1) << d) - 1;
+    if (x1 < minX || x0 > maxX || y1 < minY || y0 > maxY) return 0;
+    if (x0 >= minX && x1 <= maxX && y0 >= minY && y1 <= maxY) return c;
+    // 部分相交：继续分解（d>0，z 层节点必然整包含或不相交）
+    qint64 sum = 0;
+    for (int i = 0; i < 4; ++i) sum += countRect(node.child(i), z, minX, minY, maxX, maxY);
+    return sum;
+}
+
+qint64 TilePyramid::countInRange(int z, int minX, int minY, int maxX, int maxY) const
+{
+    if (z < 0 || z > kMaxLevel || minX > maxX || minY > maxY) return 0;
+    return countRect(TileId(0, 0, 0), z, minX, minY, maxX, maxY);
+}
+
+double TilePyramid::coverageRatio(int z, int minX, int minY, int maxX, int maxY) const
+{
+    const int n = 1 << z;
+    minX = qMax(0, minX); minY = qMax(0, minY);
+    maxX = qMin(n - 1, maxX); maxY = qMin(n - 1, maxY);
+    if (minX > maxX || minY > maxY) return 0.0;
+    const double area = double(maxX - minX + 1) * double(maxY - minY + 1);
+    return double(countInRange(z, minX, minY, maxX, maxY)) / area;
+}
+
+int TilePyramid::maxLevel() const
+{
+    for (int z = kMaxLevel; z > 0; --z) {
+        if (!m_counts[z].isEmpty()) return z;
+    }
+    return 0;
+}
+
+int TilePyramid::maxLevelUnder(const TileId &node) const
+{
+    for (int z = kMaxLevel; z >= node.z(); --z) {
+        if (count(node, z) > 0) return z;
+    }
+    return -1;
+}
+
+QVector<TileId> TilePyramid::completeParents(int z) const
+{
+    QVector<TileId> out;
+    if (z < 0 || z >= kMaxLevel) return out;
+    // z+1 层的计数表中，z 层键的计数即其已缓存子瓦片数
+    m_counts[z + 1].forEach([&](const TileId &node, quint32 n) {
+        if (n == 4 && node.z() == z && !contains(node)) out.append(node);
+    });
+    return out;
+}
+
+void TilePyramid::markUniform(const TileId &id, quint32 argb)
+{
+    if (id.isValid()) m_uniform.insert(id, argb);
+}
+
+bool TilePyramid::uniformAncestor(const TileId &id, TileId &out, quint32 &argb) const
+{
+    if (m_uniform.isEmpty()) return false;
+    for (int up = 0; up <= id.z(); ++up) {
+        const TileId a = id.ancestor(up);
+        if (const quint32 *c = m_uniform.find(a)) {
+            out = a;
+            argb = *c;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TilePyramid::appendUniform(const QString &cacheDir, const TileId &id, quint32 argb)
+{
+    // 单行一次写入（O_APPEND），多个种子进程同时追加不会交错
+    QFile f(cacheDir + "/uniform.txt");
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Append)) return false;
+    const QByteArray line = QString("%1 %2 %3 %4\n").arg(id.z()).arg(id.x()).arg(id.y())
+                                .arg(argb, 8, 16, QLatin1Char('0')).toLatin1();
+    return f.write(line) == line.size();
+}
+
+void TilePyramid::loadUniform(const QString &cacheDir)
+{
+    QFile f(cacheDir + "/uniform.txt");
+    if (!f.open(QIODevice::ReadOnly)) return;
+    while (!f.atEnd()) {
+        const QList<QByteArray> v = f.readLine().trimmed().split(' ');
+        if (v.size() != 4) continue;
+        bool ok[4];
+        const TileId id(v[1].toInt(&ok[0]), v[2].toInt(&ok[1]), v[0].toInt(&ok[2]));
+        const quint32 argb = v[3].toUInt(&ok[3], 16);
+        if (ok[0] && ok[1] && ok[2] && ok[3]) markUniform(id, argb);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef TILEPYRAMID_H
+#define TILEPYRAMID_H
+
+#include <QString>
+#include <QVector>
+#include "tileid.h"
+#include "flathashmap.h"
+
+// 缓存覆盖金字塔（隐式四叉树）：对每个目标层级 L，记录各祖先节点下 L 层已缓存瓦片数。
+// - contains / count：O(1)
+// - nearestAncestor：逐层向上查找，O(z)
+// - countInRange / coverageRatio：把矩形分解为对齐的四叉树块，只访问边界节点，O(k)
+// 由缓存目录扫描构建，保存/删除瓦片时增量更新；渲染、调度与管理对话框共用。
+class TilePyramid
+{
+public:
+    static constexpr int kMaxLevel = 22;
+
+    TilePyramid() : m_counts(kMaxLevel + 1) {}
+
+    void clear();
+    // 扫描 cacheDir/z/x/y.png 构建，返回瓦片总数
+    qint64 buildFromCache(const QString &cacheDir);
+
+    void insert(const TileId &id);
+    void remove(const TileId &id);
+    void unite(const TilePyramid &other); // 并入 other 的瓦片与纯色标记
+
+    bool contains(const TileId &id) const;
+    // node 覆盖范围内 level 层已缓存的瓦片数（level >= node.z()）
+    quint32 count(const TileId &node, int level) const;
+    // 最近的已缓存祖先（最多向上 maxUp 层）
+    bool nearestAncestor(const TileId &id, TileId &out, int maxUp = kMaxLevel) const;
+
+    // z 层瓦片矩形 [minX,maxX]x[minY,maxY] 内的已缓存数量 / 覆盖率
+    qint64 countInRange(int z, int minX, int minY, int maxX, int maxY) const;
+    double coverageRatio(int z, int minX, int minY, int maxX, int maxY) const;
+
+    int maxLevel() const;                        // 有瓦片的最深层级，无则 0
+    int maxLevelUnder(const TileId &node) const; // node 之下有瓦片的最深层级，无则 -1
+    QVector<TileId> completeParents(int z) const; // z 层未缓存、但四个子瓦片均已缓存的节点
+    qint64 tileCount() const { return m_total; }
+
+    // 纯色瓦片：整棵子树视为同色虚拟瓦片（不落盘），清单为 cacheDir/uniform.txt，每行 "z x y AARRGGBB"
+    void markUniform(const TileId &id, quint32 argb);
+    bool uniformAncestor(const TileId &id, TileId &out, quint32 &argb) const; // 含自身，O(z)
+    static bool appendUniform(const QString &cacheDir, const TileId &id, quint32 argb); // 追加写，多进程安全
+
+private:
+    void accumulate(const TileId &id, int delta);
+    qint64 countRect(const TileId &node, int z, int minX, int minY, int maxX, int maxY) const;
+
+    // 下标为目标层级；键为任意祖先（含自身）
+    QVector<FlatHashMap<TileId, quint32, TileIdHash>> m_counts;
+    qint64 m_total = 0;
+    FlatHashMap<TileId, quint32, TileIdHash> m_uniform; // 纯色瓦片 -> ARGB
+    void loadUniform(const QString &cacheDir);
+};
+
+#endif // TILEPYRAMID_H
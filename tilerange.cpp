@@ -0,0 +1,351 @@
+#include "tilerange.h"
+#include "geopolygon.h"
+#include "webmercator.h"
+#include <QtMath>
+#include <QtConcurrent/QtConcurrent>
+#include <algorithm>
+#include <cmath>
+
+qint64 TileRange::Level::count() const
+{
+    if (masked) return spanPrefix.isEmpty() ? 0 : spanPrefix.last();
+    if (maxX < minX || maxY < minY) return 0;
+    return qint64(maxX - minX + 1) * qint64(maxY - minY + 1);
+}
+
+// 区间前缀和与外包范围
+static void finalizeSpans(TileRange::Level &lv)
+{
+    lv.spanPrefix.resize(lv.spans.size() + 1);
+    lv.spanPrefix[0] = 0;
+    for (int i = 0; i < lv.spans.size(); ++i) {
+        const TileRange::Span &s = lv.spans[i];
+        lv.spanPrefix[i + 1] = lv.spanPrefix[i] + (s.x1 - s.x0 + 1);
+    }
+    if (lv.spans.isEmpty()) {
+        lv.minX = lv.minY = 0;
+        lv.maxX = lv.maxY = -1;
+        return;
+    }
+    lv.minY = lv.spans.first().y;
+    lv.maxY = lv.spans.last().y;
+    lv.minX = lv.spans.first().x0;
+    lv.maxX = lv.spans.first().x1;
+    for (const TileRange::Span &s : lv.spans) {
+        lv.minX = qMin(lv.minX, s.x0);
+        lv.maxX = qMax(lv.maxX, s.x1);
+    }
+}
+
+TileRange TileRange::fromBBox(double minLat, double maxLat, double minLon, double maxLon,
+                              int minZoom, int maxZoom)
+{
+    TileRange r;
+    for (int z = minZoom; z <= maxZoom; ++z) {
+        const int n = 1 << z;
+        int x0, y0, x1, y1;
+        WebMercator::lonLatToTile(minLon, maxLat, z, x0, y0); // 注意：Y 轴向下
+        WebMercator::lonLatToTile(maxLon, minLat, z, x1, y1);
+        Level lv;
+        lv.z = z;
+        lv.minX = qBound(0, x0, n - 1);
+        lv.maxX = qBound(0, x1, n - 1);
+        lv.minY = qBound(0, y0, n - 1);
+        lv.maxY = qBound(0, y1, n - 1);
+        r.addLevel(lv);
+    }
+    return r;
+}
+
+TileRange TileRange::fromPolygon(const GeoPolygon &polygon, int minZoom, int maxZoom)
+{
+    QVector<int> zooms;
+    for (int z = minZoom; z <= maxZoom; ++z) zooms.append(z);
+    // 各层互相独立，线程池并行栅格化
+    const QList<Level> levels = QtConcurrent::blockingMapped<QList<Level>>(zooms, [&polygon](int z) {
+        return rasterizePolygon(polygon, z);
+    });
+    TileRange r;
+    for (const Level &lv : levels) r.addLevel(lv);
+    return r;
+}
+
+// 瓦片坐标下的环（奇偶规则）栅格化为未合并的行区间：
+// 边界经过的瓦片 + 中心落在内部的瓦片，即与多边形相交的全部瓦片
+static void rasterizeRings(const QVector<QVector<QPointF>> &rings, int n, QVector<TileRange::Span> &spans)
+{
+    struct Edge { double x0, y0, x1, y1; }; // y0 <= y1
+    QVector<Edge> edges;
+    for (const auto &ring : rings) {
+        for (int i = 0; i < ring.size(); ++i) {
+            QPointF a = ring[i];
+            QPointF b = ring[(i + 1) % ring.size()];
+            if (a.y() > b.y()) std::swap(a, b);
+            edges.append({a.x(), a.y(), b.x(), b.y()});
+        }
+    }
+    if (edges.isEmpty()) return;
+
+    auto clampCell = [n](double v) { return qBound(0, int(std::floor(v)), n - 1); };
+    // 区间右端恰为整数时不含下一格（仅接触边界）
+    auto lastCell = [n](double lo, double hi) {
+        const int c = (hi > lo && hi == std::floor(hi)) ? int(hi) - 1 : int(std::floor(hi));
+        return qBound(0, c, n - 1);
+    };
+    auto xAt = [](const Edge &e, double y) { return e.x0 + (y - e.y0) * (e.x1 - e.x0) / (e.y1 - e.y0); };
+
+    // 1) 边界经过的瓦片：每条边按行裁剪，取该行内的 x 范围
+    for (const Edge &e : edges) {
+        const int r0 = clampCell(e.y0);
+        const int r1 = lastCell(e.y0, e.y1);
+        for (int r = r0; r <= r1; ++r) {
+            double xa = e.x0, xb = e.x1;
+            if (e.y1 > e.y0) {
+                xa = xAt(e, qMax(e.y0, double(r)));
+                xb = xAt(e, qMin(e.y1, double(r + 1)));
+            }
+            if (xa > xb) std::swap(xa, xb);
+            const int c0 = clampCell(xa);
+            const int c1 = lastCell(xa, xb);
+            if (c0 <= c1) spans.append({r, c0, c1});
+        }
+    }
+
+    // 2) 内部瓦片：扫描线取行中心 y+0.5，奇偶规则求交点对，中心落在区间内的瓦片
+    std::sort(edges.begin(), edges.end(), [](const Edge &a, const Edge &b) { return a.y0 < b.y0; });
+    double maxY = edges.first().y1;
+    for (const Edge &e : edges) maxY = qMax(maxY, e.y1);
+    const int rowBegin = clampCell(edges.first().y0);
+    const int rowEnd = clampCell(maxY);
+    QVector<int> active;
+    QVector<double> xs;
+    int nextEdge = 0;
+    for (int r = rowBegin; r <= rowEnd; ++r) {
+        const double yc = r + 0.5;
+        while (nextEdge < edges.size() && edges[nextEdge].y0 <= yc) active.append(nextEdge++);
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [&](int i) { return edges[i].y1 <= yc; }),
+                     active.end());
+        xs.clear();
+        for (int i : active) {
+            const Edge &e = edges[i];
+            if (e.y0 <= yc && e.y1 > yc) xs.append(xAt(e, yc));
+        }
+        std::sort(xs.begin(), xs.end());
+        for (int i = 0; i + 1 < xs.size(); i += 2) {
+            const int c0 = qMax(0, int(std::ceil(xs[i] - 0.5)));
+            const int c1 = qMin(n - 1, int(std::floor(xs[i + 1] - 0.5)));
+            if (c0 <= c1) spans.append({r, c0, c1});
+        }
+    }
+}
+
+// 排序并合并同行重叠/相邻区间，得到 masked 层
+static TileRange::Level mergeSpans(int z, QVector<TileRange::Span> &spans)
+{
+    TileRange::Level lv;
+    lv.z = z;
+    lv.masked = true;
+    std::sort(spans.begin(), spans.end(), [](const TileRange::Span &a, const TileRange::Span &b) {
+        return a.y != b.y ? a.y < b.y : a.x0 < b.x0;
+    });
+    for (const TileRange::Span &s : spans) {
+        if (!lv.spans.isEmpty()) {
+            TileRange::Span &last = lv.spans.last();
+            if (last.y == s.y && s.x0 <= last.x1 + 1) {
+                last.x1 = qMax(last.x1, s.x1);
+                continue;
+            }
+        }
+        lv.spans.append(s);
+    }
+    finalizeSpans(lv);
+    return lv;
+}
+
+TileRange::Level TileRange::rasterizePolygon(const GeoPolygon &polygon, int z)
+{
+    const int n = 1 << z;
+    QVector<QVector<QPointF>> rings;
+    for (const auto &ring : polygon.rings) rings.append(WebMercator::projectBatch(ring, n));
+    QVector<Span> spans;
+    rasterizeRings(rings, n, spans);
+    return mergeSpans(z, spans);
+}
+
+TileRange TileRange::fromCorridor(const QVector<QPointF> &route, double bufferMeters, int minZoom, int maxZoom)
+{
+    QVector<int> zooms;
+    for (int z = minZoom; z <= maxZoom; ++z) zooms.append(z);
+    const QList<Level> levels = QtConcurrent::blockingMapped<QList<Level>>(zooms, [&route, bufferMeters](int z) {
+        return rasterizeCorridor(route, bufferMeters, z);
+    });
+    TileRange r;
+    for (const Level &lv : levels) r.addLevel(lv);
+    return r;
+}
+
+TileRange::Level TileRange::rasterizeCorridor(const QVector<QPointF> &route, double bufferMeters, int z)
+{
+    const int n = 1 << z;
+    const double kEarthCircumference = 40075016.686; // 赤道周长（米）
+    // 每段半圆用 kArc 段折线外切逼近，保证覆盖真实圆弧
+    const int kArc = 8;
+    const double step = M_PI / kArc;
+    const double grow = 1.0 / std::cos(step / 2.0);
+
+    // 路线顶点一次性批量投影到瓦片坐标
+    const QVector<QPointF> projected = WebMercator::projectBatch(route, n);
+    QVector<Span> spans;
+    QVector<QVector<QPointF>> capsule(1);
+    // 逐段生成胶囊形（线段 + 两端半圆）；单点路线退化为圆
+    const int segments = route.size() == 1 ? 1 : route.size() - 1;
+    for (int i = 0; i < segments; ++i) {
+        const QPointF &ga = route[i];
+        const int j = qMin(i + 1, int(route.size()) - 1);
+        const QPointF &gb = route[j];
+        const QPointF a = projected[i];
+        const QPointF b = projected[j];
+        // 米 -> 瓦片：按两端中纬度较高者换算（墨卡托在高纬放大，取大值不漏瓦片）
+        const double lat = qMin(WebMercator::kMaxLatitude, qMax(qAbs(ga.y()), qAbs(gb.y())));
+        const double r = bufferMeters * n / (kEarthCircumference * std::cos(qDegreesToRadians(lat))) * grow;
+
+        const double dx = b.x() - a.x(), dy = b.y() - a.y();
+        const double len = std::sqrt(dx * dx + dy * dy);
+        const double theta = len > 0 ? std::atan2(dy, dx) : 0.0;
+        QVector<QPointF> &ring = capsule[0];
+        ring.clear();
+        // b 端半圆：theta-90° -> theta+90°；a 端半圆：theta+90° -> theta+270°
+        for (int k = 0; k <= kArc; ++k) {
+            const double t = theta - M_PI / 2 + k * step;
+            ring.append(QPointF(b.x() + r * std::cos(t), b.y() + r * std::sin(t)));
+        }
+        for (int k = 0; k <= kArc; ++k) {
+            const double t = theta + M_PI / 2 + k * step;
+            ring.append(QPointF(a.x() + r * std::cos(t), a.y() + r * std::sin(t)));
+        }
+        rasterizeRings(capsule, n, spans);
+    }
+    return mergeSpans(z, spans);
+}
+
+void TileRange::addLevel(Level level)
+{
+    if (level.masked && level.spanPrefix.size() != level.spans.size() + 1) finalizeSpans(level);
+    if (level.count() <= 0) return;
+    if (m_prefix.isEmpty()) m_prefix.append(0);
+    m_levels.append(level);
+    m_total += m_levels.last().count();
+    m_prefix.append(m_total);
+    seek(m_pos);
+}
+
+qint64 TileRange::levelTotal(int z) const
+{
+    for (const Level &lv : m_levels) {
+        if (lv.z == z) return lv.count();
+    }
+    return 0;
+}
+
+void TileRange::enterLevel(int index)
+{
+    m_level = index;
+    m_span = 0;
+    if (index >= m_levels.size()) return;
+    const Level &lv = m_levels[index];
+    if (lv.masked) {
+        m_x = lv.spans.first().x0;
+        m_y = lv.spans.first().y;
+    } else {
+        m_x = lv.minX;
+        m_y = lv.minY;
+    }
+}
+
+void TileRange::seek(qint64 ordinal)
+{
+    m_pos = qBound<qint64>(0, ordinal, m_total);
+    if (m_pos >= m_total) {
+        enterLevel(m_levels.size());
+        return;
+    }
+    // 前缀和二分定位层级
+    auto it = std::upper_bound(m_prefix.cbegin(), m_prefix.cend(), m_pos);
+    m_level = int(it - m_prefix.cbegin()) - 1;
+    const Level &lv = m_levels[m_level];
+    const qint64 local = m_pos - m_prefix[m_level];
+    if (lv.masked) {
+        auto sit = std::upper_bound(lv.spanPrefix.cbegin(), lv.spanPrefix.cend(), local);
+        m_span = int(sit - lv.spanPrefix.cbegin()) - 1;
+        const Span &s = lv.spans[m_span];
+        m_y = s.y;
+        m_x = s.x0 + int(local - lv.spanPrefix[m_span]);
+        return;
+    }
+    const qint64 width = lv.maxX - lv.minX + 1;
+    m_y = lv.minY + int(local / width);
+    m_x = lv.minX + int(local % width);
+}
+
+bool TileRange::next(TileId &out)
+{
+    if (m_pos >= m_total) return false;
+    const Level &lv = m_levels[m_level];
+    out = TileId(m_x, m_y, lv.z);
+    ++m_pos;
+    // 推进：区间/行内 -> 下一区间/行 -> 下一层
+    if (lv.masked) {
+        if (++m_x > lv.spans[m_span].x1) {
+            if (++m_span < lv.spans.size()) {
+                m_x = lv.spans[m_span].x0;
+                m_y = lv.spans[m_span].y;
+            } else {
+                enterLevel(m_level + 1);
+            }
+        }
+        return true;
+    }
+    if (++m_x > lv.maxX) {
+        m_x = lv.minX;
+        if (++m_y > lv.maxY) enterLevel(m_level + 1);
+    }
+    return true;
+}
+
+TileId TileRange::at(qint64 ordinal) const
+{
+    TileRange tmp;
+    tmp.m_levels = m_levels;
+    tmp.m_prefix = m_prefix;
+    tmp.m_total = m_total;
+    tmp.seek(ordinal);
+    TileId id;
+    tmp.next(id);
+    return id;
+}
+
+qint64 TileRange::ordinalOf(const TileId &id) const
+{
+    for (int i = 0; i < m_levels.size(); ++i) {
+        const Level &lv = m_levels[i];
+        if (lv.z != id.z()) continue;
+        const int x = id.x(), y = id.y();
+        if (x < lv.minX || x > lv.maxX || y < lv.minY || y > lv.maxY) return -1;
+        if (lv.masked) {
+            // 最后一个起点不大于 (y, x) 的区间
+            const Span key{y, x, x};
+            auto it = std::upper_bound(lv.spans.cbegin(), lv.spans.cend(), key, [](const Span &a, const Span &b) {
+                return a.y != b.y ? a.y < b.y : a.x0 < b.x0;
+            });
+            if (it == lv.spans.cbegin()) return -1;
+            --it;
+            if (it->y != y || x > it->x1) return -1;
+            const int s = int(it - lv.spans.cbegin());
+            return m_prefix[i] + lv.spanPrefix[s] + (x - it->x0);
+        }
+        const qint64 width = lv.maxX - lv.minX + 1;
+        return m_prefix[i] + qint64(y - lv.minY) * width + (x - lv.minX);
+    }
+    return -1;
+}
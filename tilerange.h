@@ -0,0 +1,78 @@
+#ifndef TILERANGE_H
+#define TILERANGE_H
+
+#include <QVector>
+#include <QPointF>
+#include "tileid.h"
+
+struct GeoPolygon;
+
+// 区域瓦片的惰性游标：按层级、行优先逐个产出瓦片，只保存 (层级下标, 区间下标, x, y)。
+// 总数与序号换算用各层数量的前缀和算术得出，不展开任何瓦片列表，规模无上限。
+// 层级可以是整矩形，也可以是按行排列的 x 区间（多边形栅格化结果）。
+class TileRange
+{
+public:
+    struct Span {
+        int y = 0;
+        int x0 = 0, x1 = -1; // 含端点
+    };
+
+    struct Level {
+        int z = 0;
+        int minX = 0, maxX = -1;
+        int minY = 0, maxY = -1;
+        // masked 时只覆盖 spans（按 y、x0 排序且互不重叠），否则覆盖整矩形
+        bool masked = false;
+        QVector<Span> spans;
+        QVector<qint64> spanPrefix; // spanPrefix[i] = 前 i 个区间的瓦片数（addLevel 填充）
+
+        qint64 count() const;
+    };
+
+    TileRange() = default;
+    // 经纬度范围 + 层级区间（含端点），各层范围裁剪到有效瓦片
+    static TileRange fromBBox(double minLat, double maxLat, double minLon, double maxLon,
+                              int minZoom, int maxZoom);
+    // 多边形精确覆盖：与多边形相交的瓦片；各层并行栅格化
+    static TileRange fromPolygon(const GeoPolygon &polygon, int minZoom, int maxZoom);
+    // 单层扫描线栅格化（墨卡托瓦片坐标）
+    static Level rasterizePolygon(const GeoPolygon &polygon, int z);
+    // 沿线缓冲区：折线（x=经度, y=纬度）两侧各 bufferMeters 米，逐段胶囊形栅格化后合并
+    static TileRange fromCorridor(const QVector<QPointF> &route, double bufferMeters, int minZoom, int maxZoom);
+    static Level rasterizeCorridor(const QVector<QPointF> &route, double bufferMeters, int z);
+
+    void addLevel(Level level);
+    const QVector<Level> &levels() const { return m_levels; }
+
+    qint64 total() const { return m_total; }
+    qint64 levelTotal(int z) const;
+    qint64 levelStart(int index) const { return m_prefix.value(index); } // 第 index 层首个瓦片的序号
+
+    // 游标
+    bool next(TileId &out);
+    bool atEnd() const { return m_pos >= m_total; }
+    qint64 position() const { return m_pos; }
+    void seek(qint64 ordinal);
+    void reset() { seek(0); }
+
+    // 序号 <-> 瓦片（不移动游标）
+    TileId at(qint64 ordinal) const;
+    qint64 ordinalOf(const TileId &id) const; // 不在范围内返回 -1
+
+private:
+    void enterLevel(int index);
+
+    QVector<Level> m_levels;
+    QVector<qint64> m_prefix; // m_prefix[i] = 前 i 层瓦片总数
+    qint64 m_total = 0;
+
+    // 游标状态
+    qint64 m_pos = 0;
+    int m_level = 0;
+    int m_span = 0; // 仅 masked 层使用
+    int m_x = 0;
+    int m_y = 0;
+};
+
+#endif // TILERANGE_H
@@ -1,4 +1,5 @@
 #include "tileworker.h"
+#include "asynclogger.h"
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
 #include <QNetworkReply>
@@ -30,7 +31,7 @@ QNetworkAccessManager* TileWorker::networkManager()
 
 void TileWorker::loadTileFromFile(int x, int y, int z, const QString &filePath)
 {
-    qDebug() << "TileWorker::loadTileFromFile called for tile:" << x << y << z << "filePath:" << filePath;
+    TILE_DEBUG() << "TileWorker::loadTileFromFile called for tile:" << x << y << z << "filePath:" << filePath;
     // 将磁盘IO放入异步，避免阻塞工作线程
     QTimer::singleShot(0, this, [this, x, y, z, filePath]() {
         QFile file(filePath);
@@ -56,9 +57,23 @@ void TileWorker::loadTileFromFile(int x, int y, int z, const QString &filePath)
     });
 }
 
+void TileWorker::synthesizeTile(int x, int y, int z, const QString &ancestorPath, int dz, int tileSize)
+{
+    // 在工作线程解码与缩放（QImage 可跨线程），主线程只做 QPixmap 转换
+    QImage img(ancestorPath);
+    if (img.isNull() || dz <= 0) {
+        emit tileSynthesized(x, y, z, QImage());
+        return;
+    }
+    const int mask = (1 << dz) - 1;
+    const int part = qMax(1, img.width() >> dz);
+    const QImage crop = img.copy((x & mask) * part, (y & mask) * part, part, part);
+    emit tileSynthesized(x, y, z, crop.scaled(tileSize, tileSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation));
+}
+
 void TileWorker::downloadAndSaveTile(int x, int y, int z, const QString &url, const QString &filePath)
 {
-    qDebug() << "TileWorker::downloadAndSaveTile called for tile:" << x << y << z << "URL:" << url << "filePath:" << filePath;
+    TILE_DEBUG() << "TileWorker::downloadAndSaveTile called for tile:" << x << y << z << "URL:" << url << "filePath:" << filePath;
     
     // 使用Qt的异步机制，在单独的线程中执行下载任务
     QTimer::singleShot(0, this, [this, x, y, z, url, filePath]() {
@@ -68,13 +83,14 @@ void TileWorker::downloadAndSaveTile(int x, int y, int z, const QString &url, co
 
 void TileWorker::downloadAsync(int x, int y, int z, const QString &url, const QString &filePath)
 {
-    qDebug() << "TileWorker::downloadAsync called for tile:" << x << y << z << "URL:" << url << "filePath:" << filePath;
+    TILE_DEBUG() << "TileWorker::downloadAsync called for tile:" << x << y << z << "URL:" << url << "filePath:" << filePath;
     startAsyncRequest(x, y, z, url, filePath, 0);
 }
 
 void TileWorker::downloadAndSaveTileAsync(int x, int y, int z, const QString &url, const QString &filePath)
 {
-    qDebug() << "TileWorker::downloadAndSaveTileAsync started for tile:" << x << y << z;
+    TILE_DEBUG() << "TileWorker::downloadAndSaveTileAsync started for tile:" << x << y << z;
+    emit downloadStarted(x, y, z);
     
     // 添加重试机制
     int maxRetries = 3;
@@ -83,7 +99,7 @@ void TileWorker::downloadAndSaveTileAsync(int x, int y, int z, const QString &ur
     
     while (retryCount < maxRetries && !success) {
         if (retryCount > 0) {
-            qDebug() << "Retrying download for tile:" << x << y << z << "attempt:" << (retryCount + 1);
+            TILE_DEBUG() << "Retrying download for tile:" << x << y << z << "attempt:" << (retryCount + 1);
             // 等待一段时间再重试
             QThread::msleep(1000 * retryCount); // 递增等待时间
         }
@@ -93,8 +109,8 @@ void TileWorker::downloadAndSaveTileAsync(int x, int y, int z, const QString &ur
     }
     
     if (!success) {
-        qDebug() << "Failed to download tile after" << maxRetries << "attempts:" << x << y << z;
-        qDebug() << "Emitting tileDownloaded signal (failed) for tile:" << x << y << z;
+        qCWarning(lcTile) << "Failed to download tile after" << maxRetries << "attempts:" << x << y << z;
+        TILE_DEBUG() << "Emitting tileDownloaded signal (failed) for tile:" << x << y << z;
         emit tileDownloaded(x, y, z, QByteArray(), false, 
                            QString("Failed after %1 attempts").arg(maxRetries));
     }
@@ -115,7 +131,7 @@ bool TileWorker::performDownload(int x, int y, int z, const QString &url, const
     request.setTransferTimeout(30000); // 30秒超时
     request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
     
-    qDebug() << "Sending request for URL:" << url;
+    TILE_DEBUG() << "Sending request for URL:" << url;
     
     // 发送请求
     QNetworkReply *reply = manager->get(request);
@@ -130,34 +146,34 @@ bool TileWorker::performDownload(int x, int y, int z, const QString &url, const
     connect(&timeoutTimer, &QTimer::timeout, &loop, &QEventLoop::quit);
     timeoutTimer.start(30000); // 30秒超时
     
-    qDebug() << "Starting event loop for tile:" << x << y << z;
+    TILE_DEBUG() << "Starting event loop for tile:" << x << y << z;
     
     // 进入事件循环等待完成或超时
     loop.exec();
     
-    qDebug() << "Event loop finished for tile:" << x << y << z;
-    qDebug() << "Timeout timer active:" << timeoutTimer.isActive();
+    TILE_DEBUG() << "Event loop finished for tile:" << x << y << z;
+    TILE_DEBUG() << "Timeout timer active:" << timeoutTimer.isActive();
     
     // 检查是否超时
     if (timeoutTimer.isActive()) {
         timeoutTimer.stop();
-        qDebug() << "Request finished normally, checking for errors";
+        TILE_DEBUG() << "Request finished normally, checking for errors";
         
         if (reply->error() == QNetworkReply::NoError) {
-            qDebug() << "No error in reply, reading data";
+            TILE_DEBUG() << "No error in reply, reading data";
             QByteArray data = reply->readAll();
-            qDebug() << "Data size:" << data.size();
+            TILE_DEBUG() << "Data size:" << data.size();
             
             // 检查数据是否为空
             if (data.isEmpty()) {
-                qDebug() << "Downloaded empty data for tile:" << x << y << z;
+                TILE_DEBUG() << "Downloaded empty data for tile:" << x << y << z;
                 reply->deleteLater();
                 return false;
             }
             
             // 检查是否是有效的PNG数据
             if (!data.startsWith(QByteArray::fromHex("89504e47"))) { // PNG文件头
-                qDebug() << "Downloaded invalid data (not PNG) for tile:" << x << y << z;
+                TILE_DEBUG() << "Downloaded invalid data (not PNG) for tile:" << x << y << z;
                 reply->deleteLater();
                 return false;
             }
@@ -165,9 +181,9 @@ bool TileWorker::performDownload(int x, int y, int z, const QString &url, const
             // 创建目录
             QDir dir(QFileInfo(filePath).path());
             if (!dir.exists()) {
-                qDebug() << "Creating directory for tile:" << x << y << z;
+                TILE_DEBUG() << "Creating directory for tile:" << x << y << z;
                 if (!dir.mkpath(".")) {
-                    qDebug() << "Failed to create directory for tile:" << x << y << z;
+                    qCWarning(lcTile) << "Failed to create directory for tile:" << x << y << z;
                     reply->deleteLater();
                     return false;
                 }
@@ -178,21 +194,21 @@ bool TileWorker::performDownload(int x, int y, int z, const QString &url, const
             if (file.open(QIODevice::WriteOnly)) {
                 qint64 written = file.write(data);
                 file.close();
-                qDebug() << "Written" << written << "bytes to file:" << filePath;
+                TILE_DEBUG() << "Written" << written << "bytes to file:" << filePath;
                 
                 if (written != data.size()) {
-                    qDebug() << "Incomplete write to file for tile:" << x << y << z;
+                    qCWarning(lcTile) << "Incomplete write to file for tile:" << x << y << z;
                     reply->deleteLater();
                     return false;
                 } else {
-                    qDebug() << "Successfully downloaded tile:" << x << y << z;
-                    qDebug() << "Emitting tileDownloaded signal for tile:" << x << y << z;
+                    TILE_DEBUG() << "Successfully downloaded tile:" << x << y << z;
+                    TILE_DEBUG() << "Emitting tileDownloaded signal for tile:" << x << y << z;
                     emit tileDownloaded(x, y, z, data, true, QString());
                     reply->deleteLater();
                     return true;
                 }
             } else {
-                qDebug() << "Failed to save tile to file:" << filePath << "Error:" << file.errorString();
+                qCWarning(lcTile) << "Failed to save tile to file:" << filePath << "Error:" << file.errorString();
                 reply->deleteLater();
                 return false;
             }
@@ -201,7 +217,7 @@ bool TileWorker::performDownload(int x, int y, int z, const QString &url, const
             int errorCode = reply->error();
             int httpStatusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
             
-            qDebug() << "Network error for tile:" << x << y << z 
+            qCWarning(lcTile) << "Network error for tile:" << x << y << z 
                      << "Error code:" << errorCode 
                      << "HTTP status:" << httpStatusCode 
                      << "Error string:" << errorString;
@@ -209,8 +225,8 @@ bool TileWorker::performDownload(int x, int y, int z, const QString &url, const
             // 对于某些错误，我们不重试
             if (errorCode == QNetworkReply::ContentNotFoundError) {
                 // 404错误，瓦片不存在，不重试
-                qDebug() << "Tile not found (404) for tile:" << x << y << z;
-                qDebug() << "Emitting tileDownloaded signal (404 error) for tile:" << x << y << z;
+                TILE_DEBUG() << "Tile not found (404) for tile:" << x << y << z;
+                TILE_DEBUG() << "Emitting tileDownloaded signal (404 error) for tile:" << x << y << z;
                 emit tileDownloaded(x, y, z, QByteArray(), false, 
                                    QString("Tile not found (404)"));
                 reply->deleteLater();
@@ -222,7 +238,7 @@ bool TileWorker::performDownload(int x, int y, int z, const QString &url, const
         }
     } else {
         // 超时
-        qDebug() << "Request timeout for tile:" << x << y << z;
+        qCWarning(lcTile) << "Request timeout for tile:" << x << y << z;
         if (reply->isRunning()) {
             reply->abort();
         }
@@ -236,14 +252,14 @@ void TileWorker::onDownloadFinished()
 {
     // 这个函数在当前实现中不会被调用，因为我们使用事件循环而不是信号槽
     // 但为了满足链接器要求，我们需要提供实现
-    qDebug() << "onDownloadFinished called";
+    TILE_DEBUG() << "onDownloadFinished called";
 }
 
 void TileWorker::onDownloadTimeout()
 {
     // 这个函数在当前实现中不会被调用，因为我们使用事件循环而不是信号槽
     // 但为了满足链接器要求，我们需要提供实现
-    qDebug() << "onDownloadTimeout called";
+    TILE_DEBUG() << "onDownloadTimeout called";
 }
 
 // 为空实现：当前未使用，仅为满足 moc 生成的元对象调用
@@ -266,6 +282,7 @@ void TileWorker::configureNetworkRetries(int retryMax, int backoffInitialMs)
 
 void TileWorker::startAsyncRequest(int x, int y, int z, const QString &url, const QString &filePath, int attempt)
 {
+    if (attempt == 0) emit downloadStarted(x, y, z);
     QNetworkAccessManager *manager = networkManager();
 
     QNetworkRequest request{(QUrl(url))};
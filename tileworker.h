@@ -3,6 +3,7 @@
 
 #include <QObject>
 #include <QPixmap>
+#include <QImage>
 #include <QByteArray>
 #include <QString>
 
@@ -18,6 +19,8 @@ public:
 public slots:
     void downloadAndSaveTile(int x, int y, int z, const QString &url, const QString &filePath);
     void loadTileFromFile(int x, int y, int z, const QString &filePath);
+    // 超出缓存层级：裁剪 dz 层之上的祖先瓦片中对应的 1/2^dz 区域并放大为整张瓦片
+    void synthesizeTile(int x, int y, int z, const QString &ancestorPath, int dz, int tileSize);
     // 全异步网络模式（非阻塞，使用 QNetworkReply 信号）
     void downloadAsync(int x, int y, int z, const QString &url, const QString &filePath);
     void configureNetworkRetries(int retryMax, int backoffInitialMs);
@@ -45,10 +48,12 @@ private:
     int m_backoffInitialMs = 3000;
 
 signals:
+    void downloadStarted(int x, int y, int z); // 请求真正发出（不含在工作线程排队的时间）
     void tileDownloaded(int x, int y, int z, const QByteArray &data, bool success, const QString &errorString);
     void tileLoaded(int x, int y, int z, const QPixmap &pixmap, bool success, const QString &errorString);
     // 新增：跨线程安全的加载结果（传输原始字节，由主线程构建 QPixmap）
     void tileLoadedBytes(int x, int y, int z, const QByteArray &data, bool success, const QString &errorString);
+    void tileSynthesized(int x, int y, int z, const QImage &image); // 失败时 image 为空
 };
 
 #endif // TILEWORKER_H
\ No newline at end of file
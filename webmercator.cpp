@@ -0,0 +1,179 @@
+#include "webmercator.h"
+#include <QtMath>
+#include <QElapsedTimer>
+#include <cmath>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define WEBMERCATOR_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace WebMercator {
+
+double lonToX(double lon)
+{
+    return (lon + 180.0) / 360.0;
+}
+
+double latToY(double lat)
+{
+    const double rad = qDegreesToRadians(qBound(-kMaxLatitude, lat, kMaxLatitude));
+    return (1.0 - std::log(std::tan(rad) + 1.0 / std::cos(rad)) / M_PI) / 2.0;
+}
+
+double xToLon(double x)
+{
+    return x * 360.0 - 180.0;
+}
+
+double yToLat(double y)
+{
+    return qRadiansToDegrees(std::atan(std::sinh(M_PI * (1.0 - 2.0 * y))));
+}
+
+void lonLatToTile(double lon, double lat, int z, int &tileX, int &tileY)
+{
+    const double n = double(1 << z);
+    tileX = int(std::floor(lonToX(lon) * n));
+    tileY = int(std::floor(latToY(lat) * n));
+}
+
+static void projectScalar(const QPointF *lonLat, QPointF *out, int count, double scale)
+{
+    for (int i = 0; i < count; ++i) out[i] = project(lonLat[i], scale);
+}
+
+#ifdef WEBMERCATOR_AVX2
+// y = 0.5 - ln((1+sinφ)/(1-sinφ)) / 4π，与 ln(tanφ+secφ) 等价。
+// sin 在 |φ| ≤ 1.4845 上用 19 阶泰勒多项式；ln 拆成 m·2^e，m ∈ [√½, √2) 上用 atanh 级数，误差均在 1e-15 量级。
+__attribute__((target("avx2")))
+static __m256d sinPoly(__m256d x)
+{
+    const __m256d x2 = _mm256_mul_pd(x, x);
+    // (-1)^k / (2k+1)!，k = 9..0
+    static const double c[10] = {
+        -1.0 / 121645100408832000.0, 1.0 / 355687428096000.0, -1.0 / 1307674368000.0,
+        1.0 / 6227020800.0, -1.0 / 39916800.0, 1.0 / 362880.0, -1.0 / 5040.0,
+        1.0 / 120.0, -1.0 / 6.0, 1.0
+    };
+    __m256d p = _mm256_set1_pd(c[0]);
+    for (int k = 1; k < 10; ++k) p = _mm256_add_pd(_mm256_mul_pd(p, x2), _mm256_set1_pd(c[k]));
+    return _mm256_mul_pd(p, x);
+}
+
+__attribute__((target("avx2")))
+static __m256d logPoly(__m256d v)
+{
+    const __m256i bits = _mm256_castpd_si256(v);
+    // 指数：偏置指数拼进 2^52 的尾数后相减得到 double
+    const __m256i ebits = _mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_set1_epi64x(0x4330000000000000LL));
+    __m256d e = _mm256_sub_pd(_mm256_castsi256_pd(ebits), _mm256_set1_pd(4503599627370496.0 + 1023.0));
+    // 尾数 m ∈ [1,2)，大于 √2 时折半使 m ∈ [√½, √2)
+    const __m256i mbits = _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                                          _mm256_set1_epi64x(0x3FF0000000000000LL));
+    __m256d m = _mm256_castsi256_pd(mbits);
+    const __m256d big = _mm256_cmp_pd(m, _mm256_set1_pd(M_SQRT2), _CMP_GT_OQ);
+    m = _mm256_blendv_pd(m, _mm256_mul_pd(m, _mm256_set1_pd(0.5)), big);
+    e = _mm256_add_pd(e, _mm256_and_pd(big, _mm256_set1_pd(1.0)));
+
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d t = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+    const __m256d t2 = _mm256_mul_pd(t, t);
+    // ln m = 2t·Σ t^(2k)/(2k+1)，k = 10..0
+    __m256d p = _mm256_set1_pd(1.0 / 21.0);
+    for (int k = 9; k >= 0; --k) p = _mm256_add_pd(_mm256_mul_pd(p, t2), _mm256_set1_pd(1.0 / (2 * k + 1)));
+    const __m256d lnm = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(2.0), t), p);
+    return _mm256_add_pd(lnm, _mm256_mul_pd(e, _mm256_set1_pd(M_LN2)));
+}
+
+__attribute__((target("avx2")))
+static void projectAvx2(const QPointF *lonLat, QPointF *out, int count, double scale)
+{
+    const __m256d vScale = _mm256_set1_pd(scale);
+    const __m256d maxLat = _mm256_set1_pd(kMaxLatitude);
+    const __m256d minLat = _mm256_set1_pd(-kMaxLatitude);
+    const __m256d deg2rad = _mm256_set1_pd(M_PI / 180.0);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d inv4pi = _mm256_set1_pd(1.0 / (4.0 * M_PI));
+    const __m256d inv360 = _mm256_set1_pd(1.0 / 360.0);
+    const __m256d lon180 = _mm256_set1_pd(180.0);
+
+    int i = 0;
+    alignas(32) double lon[4], lat[4], x[4], y[4];
+    for (; i + 4 <= count; i += 4) {
+        for (int k = 0; k < 4; ++k) { lon[k] = lonLat[i + k].x(); lat[k] = lonLat[i + k].y(); }
+        const __m256d vx = _mm256_mul_pd(_mm256_mul_pd(_mm256_add_pd(_mm256_load_pd(lon), lon180), inv360), vScale);
+        __m256d phi = _mm256_min_pd(_mm256_max_pd(_mm256_load_pd(lat), minLat), maxLat);
+        phi = _mm256_mul_pd(phi, deg2rad);
+        const __m256d s = sinPoly(phi);
+        const __m256d ratio = _mm256_div_pd(_mm256_add_pd(one, s), _mm256_sub_pd(one, s));
+        const __m256d vy = _mm256_mul_pd(_mm256_sub_pd(half, _mm256_mul_pd(logPoly(ratio), inv4pi)), vScale);
+        _mm256_store_pd(x, vx);
+        _mm256_store_pd(y, vy);
+        for (int k = 0; k < 4; ++k) out[i + k] = QPointF(x[k], y[k]);
+    }
+    projectScalar(lonLat + i, out + i, count - i, scale);
+}
+#endif
+
+bool simdAvailable()
+{
+#ifdef WEBMERCATOR_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+#else
+    return false;
+#endif
+}
+
+void projectBatch(const QPointF *lonLat, QPointF *out, int count, double scale)
+{
+#ifdef WEBMERCATOR_AVX2
+    if (simdAvailable()) {
+        projectAvx2(lonLat, out, count, scale);
+        return;
+    }
+#endif
+    projectScalar(lonLat, out, count, scale);
+}
+
+QVector<QPointF> projectBatch(const QVector<QPointF> &lonLat, double scale)
+{
+    QVector<QPointF> out(lonLat.size());
+    projectBatch(lonLat.constData(), out.data(), int(lonLat.size()), scale);
+    return out;
+}
+
+void unprojectBatch(const QPointF *pts, QPointF *lonLat, int count, double scale)
+{
+    for (int i = 0; i < count; ++i) lonLat[i] = unproject(pts[i].x(), pts[i].y(), scale);
+}
+
+BenchResult benchmark(int points)
+{
+    BenchResult r;
+    r.points = points;
+    r.simd = simdAvailable();
+    // 覆盖全球的确定性样本（含两极裁剪区）
+    QVector<QPointF> in(points), ref(points), out(points);
+    quint32 seed = 12345;
+    auto rnd = [&seed]() { seed = seed * 1664525u + 1013904223u; return double(seed) / 4294967296.0; };
+    for (int i = 0; i < points; ++i) in[i] = QPointF(rnd() * 360.0 - 180.0, rnd() * 180.0 - 90.0);
+
+    QElapsedTimer t;
+    t.start();
+    projectScalar(in.constData(), ref.data(), points, 1.0);
+    r.scalarNsPerPoint = double(t.nsecsElapsed()) / qMax(1, points);
+    t.restart();
+    projectBatch(in.constData(), out.data(), points, 1.0);
+    r.batchNsPerPoint = double(t.nsecsElapsed()) / qMax(1, points);
+
+    for (int i = 0; i < points; ++i) {
+        r.maxError = qMax(r.maxError, qAbs(out[i].x() - ref[i].x()));
+        r.maxError = qMax(r.maxError, qAbs(out[i].y() - ref[i].y()));
+    }
+    return r;
+}
+
+} // namespace WebMercator
@@ -0,0 +1,46 @@
+#ifndef WEBMERCATOR_H
+#define WEBMERCATOR_H
+
+#include <QPointF>
+#include <QVector>
+
+// Web 墨卡托投影（EPSG:3857，球面）。
+// 归一化世界坐标：x ∈ [0,1] 自西向东，y ∈ [0,1] 自北向南；乘以 2^z 得瓦片坐标，再乘瓦片像素得场景坐标。
+// 标量接口用于单点换算；批量接口在 CPU 支持 AVX2 时每次处理 4 点，否则退回标量实现。
+namespace WebMercator {
+    constexpr double kMaxLatitude = 85.0511287798066;
+
+    double lonToX(double lon);
+    double latToY(double lat); // 纬度裁剪到 ±kMaxLatitude
+    double xToLon(double x);
+    double yToLat(double y);
+
+    // scale：归一化坐标的放大倍数（2^z 为瓦片坐标，2^z*tileSize 为场景像素）
+    inline QPointF project(double lon, double lat, double scale) { return QPointF(lonToX(lon) * scale, latToY(lat) * scale); }
+    inline QPointF project(const QPointF &lonLat, double scale) { return project(lonLat.x(), lonLat.y(), scale); }
+    // 返回 QPointF(lon, lat)
+    inline QPointF unproject(double x, double y, double scale) { return QPointF(xToLon(x / scale), yToLat(y / scale)); }
+
+    // 整数瓦片号（未裁剪）
+    void lonLatToTile(double lon, double lat, int z, int &tileX, int &tileY);
+
+    // 批量正投影：lonLat[i]（x=经度, y=纬度）-> out[i]，可原地
+    void projectBatch(const QPointF *lonLat, QPointF *out, int count, double scale);
+    QVector<QPointF> projectBatch(const QVector<QPointF> &lonLat, double scale);
+    // 批量反投影（标量逐点）
+    void unprojectBatch(const QPointF *pts, QPointF *lonLat, int count, double scale);
+
+    bool simdAvailable();
+
+    // 批量路径与标量参考的对比：最大误差（归一化坐标）与每点耗时
+    struct BenchResult {
+        int points = 0;
+        bool simd = false;
+        double maxError = 0.0;
+        double scalarNsPerPoint = 0.0;
+        double batchNsPerPoint = 0.0;
+    };
+    BenchResult benchmark(int points = 1 << 16);
+}
+
+#endif // WEBMERCATOR_H